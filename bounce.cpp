@@ -1,9 +1,10 @@
 //---------------------------------------------------------------------
 // 
-// bounce.cpp -- Bounce class member functions 
+// bounce.cpp -- Bounce and BounceBatch class member functions
 //
 //---------------------------------------------------------------------
 
+#include <algorithm>
 #include "demo.h" 
 
 // Constructor
@@ -25,24 +26,57 @@ Bounce::Bounce(int width, int height) :
     pt[2].y = ymax - 5;
     pt[3].x = xmin + 5;
     pt[3].y = ymax - 5;
+    for (int i = 0; i < 4; ++i)
+        prev[i] = pt[i];
+}
+
+// Makes the x and y offsets between K = xy[2] and the two vertexes
+// P = xy[1] and Q = xy[3] even by moving P and Q away from K
+static void MakeEvenOffsets(XYVAL xy[])
+{
+    for (int i = 1; i < 4; i += 2)
+    {
+        int diff = xy[i].x - xy[2].x;
+
+        if (diff & 1)
+        {
+            xy[i].x += (diff > 0) ? 1 : -1;
+        }
+        diff = xy[i].y - xy[2].y;
+        if (diff & 1)
+        {
+            xy[i].y += (diff > 0) ? 1 : -1;
+        }
+    }
 }
 
-//---------------------------------------------------------------------
 // Update function -- Copies the x-y coordinates for the four vertexes
-// of the current parallelogram to output array xy. Then moves the
-// vertexes to their updated positions in preparation for the next
-// Update call. Points J = pt[0] and K = pt[2] are opposing vertexes
-// of the parallelogram, as are P = pt[1] and Q = pt[3]. A parallelo-
-// gram is uniquely defined by three vertexes, P, K, and Q; the fourth
-// vertex, J, is determined by symmetry. Note: vpt[0] is unused.
-//---------------------------------------------------------------------
+// of the current parallelogram to output array xy. Then calls Step to
+// move the vertexes in preparation for the next Update call.
 void Bounce::Update(XYVAL xy[])
 {
-    int i, diff;
+    for (int i = 0; i < 4; ++i)
+    {
+        xy[i] = pt[i];
+    }
+    Step();
+}
+
+//---------------------------------------------------------------------
+// Step function -- Moves the vertexes of the parallelogram to their
+// updated positions, and saves their previous positions in the prev
+// array. Points J = pt[0] and K = pt[2] are opposing vertexes of the
+// parallelogram, as are P = pt[1] and Q = pt[3]. A parallelogram is
+// uniquely defined by three vertexes, P, K, and Q; the fourth vertex,
+// J, is determined by symmetry. Note: vpt[0] is unused.
+//---------------------------------------------------------------------
+void Bounce::Step()
+{
+    int i;
 
     for (i = 0; i < 4; ++i)
     {
-        xy[i] = pt[i];
+        prev[i] = pt[i];
     }
 
     // Update P, K, and Q
@@ -56,19 +90,7 @@ void Bounce::Update(XYVAL xy[])
     // two vertexes P and Q are even so that the integer
     // coordinates of the conjugate diameters will exactly
     // divide the sides of the parallelogram
-    for (i = 1; i < 4; i += 2)
-    {
-        diff = pt[i].x - pt[2].x;
-        if (diff & 1)
-        {
-            pt[i].x += (diff > 0) ? 1 : -1;
-        }
-        diff = pt[i].y - pt[2].y;
-        if (diff & 1)
-        {
-            pt[i].y += (diff > 0) ? 1 : -1;
-        }
-    }
+    MakeEvenOffsets(pt);
 
     // Check for collisions with the boundaries of
     // the rectangular drawing window
@@ -134,3 +156,213 @@ void Bounce::Update(XYVAL xy[])
     }
 }
 
+//---------------------------------------------------------------------
+// Interpolate function -- Writes to output array xy the vertexes of a
+// parallelogram part of the way between the positions before and
+// after the most recent Step call. Fixed-point value alpha is the
+// fraction of the way, from 0 (the prev array) to FIX_ONE (the pt
+// array). P, K, and Q are interpolated and rounded to the nearest
+// pixel, the offsets of P and Q from K are made even, as in Step, and
+// J is determined by symmetry.
+//---------------------------------------------------------------------
+void Bounce::Interpolate(int alpha, XYVAL xy[])
+{
+    for (int i = 1; i < 4; ++i)
+    {
+        xy[i].x = prev[i].x +
+                  (((pt[i].x - prev[i].x)*alpha + FIX_ONE/2) >> FIX_SHIFT);
+        xy[i].y = prev[i].y +
+                  (((pt[i].y - prev[i].y)*alpha + FIX_ONE/2) >> FIX_SHIFT);
+    }
+    MakeEvenOffsets(xy);
+    xy[0].x = xy[1].x + xy[3].x - xy[2].x;
+    xy[0].y = xy[1].y + xy[3].y - xy[2].y;
+}
+
+//---------------------------------------------------------------------
+//
+// BounceBatch class member functions
+//
+//---------------------------------------------------------------------
+
+// Returns true if the four vertexes in pt are inside the boundary
+static bool InBounds(const XYVAL pt[4], int xmin, int ymin,
+                     int xmax, int ymax)
+{
+    for (int k = 0; k < 4; ++k)
+    {
+        if (pt[k].x < xmin || xmax <= pt[k].x ||
+            pt[k].y < ymin || ymax <= pt[k].y)
+        {
+            return false;
+        }
+    }
+    return true;
+}
+
+// Constructor. All count parallelograms start as copies of the square
+// that the Bounce constructor creates.
+BounceBatch::BounceBatch(int width, int height, int count) :
+            count(count), xmin(EDGE_OFFSET), ymin(EDGE_OFFSET),
+            xmax(width-EDGE_OFFSET), ymax(height-EDGE_OFFSET)
+{
+    Bounce bounce(width, height);
+
+    for (int k = 0; k < 4; ++k)
+    {
+        x[k].resize(count);
+        y[k].resize(count);
+        vx[k].resize(count);
+        vy[k].resize(count);
+    }
+    for (int i = 0; i < count; ++i)
+        Set(i, bounce.pt, bounce.vpt);
+}
+
+// Sets the vertexes of parallelogram i to pt[0] through pt[3], and its
+// velocities to vpt[0] through vpt[3], as in the Bounce class
+void BounceBatch::Set(int i, const XYVAL pt[4], const XYVAL vpt[4])
+{
+    for (int k = 0; k < 4; ++k)
+    {
+        x[k][i] = pt[k].x;
+        y[k][i] = pt[k].y;
+        vx[k][i] = vpt[k].x;
+        vy[k][i] = vpt[k].y;
+    }
+}
+
+//---------------------------------------------------------------------
+// Randomize function -- Gives each parallelogram a random position,
+// shape, and velocity. The parallelograms are small enough for
+// thousands of them to fit in the boundary. The same seed always
+// produces the same parallelograms.
+//---------------------------------------------------------------------
+void BounceBatch::Randomize(unsigned seed)
+{
+    int size = (std::min(xmax - xmin, ymax - ymin))/16;
+
+    if (size < 2)
+        size = 2;
+    for (int i = 0; i < count; ++i)
+    {
+        XYVAL pt[4], vpt[4];
+        int r[9];
+
+        do
+        {
+            for (int j = 0; j < 9; ++j)
+            {
+                seed = 1664525*seed + 1013904223;
+                r[j] = seed >> 8;
+            }
+            pt[2].x = xmin + r[0] % (xmax - xmin);
+            pt[2].y = ymin + r[1] % (ymax - ymin);
+            pt[1].x = pt[2].x + 2*(r[2] % (size + 1) - size/2);
+            pt[1].y = pt[2].y + 2*(r[3] % (size + 1) - size/2);
+            pt[3].x = pt[2].x + 2*(r[4] % (size + 1) - size/2);
+            pt[3].y = pt[2].y + 2*(r[5] % (size + 1) - size/2);
+            pt[0].x = pt[1].x + pt[3].x - pt[2].x;
+            pt[0].y = pt[1].y + pt[3].y - pt[2].y;
+        } while (!InBounds(pt, xmin, ymin, xmax, ymax));
+        vpt[0].x = vpt[0].y = 0;
+        for (int k = 1; k < 4; ++k)
+        {
+            vpt[k].x = r[5 + k] % 9 - 4;
+            vpt[k].y = (r[5 + k] >> 4) % 9 - 4;
+        }
+        Set(i, pt, vpt);
+    }
+}
+
+// Reflects coordinate c off the boundary at lo or hi, if c is outside
+// the range lo <= c < hi
+static inline int Reflect(int c, int lo, int hi)
+{
+    return (c < lo) ? 2*lo - c : (hi <= c) ? 2*hi - c - 1 : c;
+}
+
+//---------------------------------------------------------------------
+// StepAxis function -- Updates one coordinate (x or y) of count
+// parallelograms. Arrays j, p, k, and q contain that coordinate of
+// vertexes J, P, K, and Q, and arrays vp, vk, and vq contain the
+// velocities of P, K, and Q. The boundary is lo <= c < hi. This is
+// the same calculation as Bounce::Step, which handles the x and y
+// coordinates independently of each other, but the if statements
+// are replaced by conditional expressions so that the loop has no
+// branches and can be vectorized. The arrays must not overlap, as
+// promised to the compiler by __restrict (supported by GCC, Clang,
+// and Microsoft C++).
+//---------------------------------------------------------------------
+static void StepAxis(int count, int *__restrict j, int *__restrict p,
+                     int *__restrict k, int *__restrict q,
+                     int *__restrict vp, int *__restrict vk,
+                     int *__restrict vq, int lo, int hi)
+{
+    for (int i = 0; i < count; ++i)
+    {
+        int cp = p[i] + vp[i];
+        int ck = k[i] + vk[i];
+        int cq = q[i] + vq[i];
+        int dp = cp - ck;
+        int dq = cq - ck;
+        int cj;
+
+        // Make the offsets of P and Q from K even
+        cp += (dp & 1)*(2*(dp > 0) - 1);
+        cq += (dq & 1)*(2*(dq > 0) - 1);
+
+        // Bounce P, K, and Q off the boundary
+        vp[i] = (cp < lo || hi <= cp) ? -vp[i] : vp[i];
+        vk[i] = (ck < lo || hi <= ck) ? -vk[i] : vk[i];
+        vq[i] = (cq < lo || hi <= cq) ? -vq[i] : vq[i];
+        cp = Reflect(cp, lo, hi);
+        ck = Reflect(ck, lo, hi);
+        cq = Reflect(cq, lo, hi);
+
+        // Get J by symmetry. If J is out of bounds, bounce it, and
+        // then get K by symmetry.
+        cj = cp + cq - ck;
+        vk[i] = (cj < lo || hi <= cj) ? -vk[i] : vk[i];
+        cj = Reflect(cj, lo, hi);
+        j[i] = cj;
+        p[i] = cp;
+        k[i] = cp + cq - cj;
+        q[i] = cq;
+    }
+}
+
+// Step function -- Moves the vertexes of all of the parallelograms to
+// their updated positions, as Bounce::Step does for one parallelogram
+void BounceBatch::Step()
+{
+    if (count == 0)
+        return;
+    StepAxis(count, &x[0][0], &x[1][0], &x[2][0], &x[3][0],
+             &vx[1][0], &vx[2][0], &vx[3][0], xmin, xmax);
+    StepAxis(count, &y[0][0], &y[1][0], &y[2][0], &y[3][0],
+             &vy[1][0], &vy[2][0], &vy[3][0], ymin, ymax);
+}
+
+//---------------------------------------------------------------------
+// GetEllipses function -- Writes the ellipses inscribed in the
+// parallelograms to output arrays x0, y0, x1, y1, x2, and y2, which
+// must each have room for count values. For parallelogram i, P0 =
+// (x0[i],y0[i]) is the center point of the ellipse, and P1 =
+// (x1[i],y1[i]) and P2 = (x2[i],y2[i]) are the end points of two
+// conjugate diameters, as for the Ellipse function. Because the
+// offsets of P and Q from K are even, the points are exact.
+//---------------------------------------------------------------------
+void BounceBatch::GetEllipses(int x0[], int y0[], int x1[], int y1[],
+                              int x2[], int y2[]) const
+{
+    for (int i = 0; i < count; ++i)
+    {
+        x0[i] = (x[1][i] + x[3][i])/2;  // center of ellipse
+        y0[i] = (y[1][i] + y[3][i])/2;
+        x1[i] = (x[1][i] + x[2][i])/2;  // midpoint of side PK
+        y1[i] = (y[1][i] + y[2][i])/2;
+        x2[i] = (x[2][i] + x[3][i])/2;  // midpoint of side KQ
+        y2[i] = (y[2][i] + y[3][i])/2;
+    }
+}
@@ -12,65 +12,194 @@
 //-----------------------------------------------------------
 
 #include <math.h>
+#include <stdlib.h>
+#include <limits.h>
+#include <vector>
+#include <algorithm>
 #include "conic.h"
 
-// Bresenham's line-drawing algorithm. Draws a straight
-// line from starting point (xs,ys) to end point (xe,ye).
+// Pixel and span output functions used by the drawing functions
+// in this module (see SetPixelProc and SetSpanProc)
+static PIXELPROC g_pixelProc = DrawPixel;
+static SPANPROC g_spanProc = 0;
+
+// Segment function, or 0 if segments are drawn (see SetSegmentProc)
+static SEGMENTPROC g_segmentProc = 0;
+
+// Current clip rectangle (see SetClipRect)
+static int g_clip[4] = { 0, 0, 32767, 32767 };
+
+// Redirects the pixels drawn by Line, Conic, and the functions built
+// on them to function proc. If proc is 0, pixels are again sent to the
+// DrawPixel function implemented by the demo program. The return value
+// is the previous pixel function, so that the caller can restore it.
 //
-void Line(int xs, int ys, int xe, int ye)
+PIXELPROC SetPixelProc(PIXELPROC proc)
+{
+    PIXELPROC prev = g_pixelProc;
+
+    g_pixelProc = (proc) ? proc : DrawPixel;
+    return prev;
+}
+
+// Specifies the function that DrawSpan uses to fill a horizontal span
+// of pixels. If proc is 0, DrawSpan draws a span one pixel at a time
+// by calling the current pixel function. Returns the previous span
+// function.
+//
+SPANPROC SetSpanProc(SPANPROC proc)
+{
+    SPANPROC prev = g_spanProc;
+
+    g_spanProc = proc;
+    return prev;
+}
+
+// Specifies a function that receives the segments of a curve instead
+// of its pixels. While proc is not 0, Line and Conic (and so the
+// Ellipse and spline functions, and the clipped curves) do not draw
+// anything; each straight line or arc that they would draw is passed
+// to proc as a SEGMENT, which a ConicIter can then draw later, a few
+// pixels at a time. Wide strokes, filled ellipses, and stamps, which
+// fill spans of their own, pass each span to proc as a horizontal
+// line. Returns the previous segment function.
+//
+SEGMENTPROC SetSegmentProc(SEGMENTPROC proc)
+{
+    SEGMENTPROC prev = g_segmentProc;
+
+    g_segmentProc = proc;
+    return prev;
+}
+
+// Fills the horizontal span of pixels from (xl,y) to (xr,y), inclusive
+//
+void DrawSpan(int xl, int xr, int y)
+{
+    if (g_spanProc)
+    {
+        g_spanProc(xl, xr, y);
+        return;
+    }
+    for (int x = xl; x <= xr; x++)
+        g_pixelProc(x, y);
+}
+
+// Fills the span from (xl,y) to (xr,y) with DrawSpan, or, if a segment
+// function is in effect, passes the span to it as a horizontal line.
+// This is how the functions that fill spans of their own, instead of
+// drawing with Line and Conic, take part in segment capture.
+//
+static void EmitSpan(int xl, int xr, int y)
+{
+    if (g_segmentProc)
+        Line(xl, y, xr, y);
+    else
+        DrawSpan(xl, xr, y);
+}
+
+// State of the Bresenham and Pitteway algorithms as they step from
+// pixel to pixel. The Walk and Line functions below operate on any
+// object w with these members: Line and ConicWalk keep a WALK in
+// local variables, and class ConicIter keeps the same members so
+// that a walk can be suspended and resumed between calls.
+//
+template <class T>
+struct WALK
+{
+    int x, y, xe, ye;
+    int octant, octantCount, pixelCount;
+    int dxsquare, dysquare, dxdiag, dydiag;
+    T d, u, v, k1, k2, k3;
+    int stepsLeft;
+};
+
+// Initializes walk w (see WALK) to draw a straight line from
+// (xs,ys) to (xe,ye) with Bresenham's algorithm. For a line, members
+// u and v hold the increments to decision variable d for square and
+// diagonal steps, and pixelCount is the number of pixels to draw.
+//
+template <class S>
+static inline void LineStart(S& w, int xs, int ys, int xe, int ye)
 {
-    int x, y, d, a, b, diagInc, squareInc;
-    int dxDiag, dyDiag, dxSquare, dySquare;
+    int a, b;
 
-    x = xs;
-    y = ys;
+    w.x = xs;
+    w.y = ys;
+    w.xe = xe;
+    w.ye = ye;
     a = xe - xs;
     b = ye - ys;
     if (a < 0)
     {
         a = -a;
-        dxDiag = -1;
+        w.dxdiag = -1;
     }
     else
-        dxDiag = 1;
+        w.dxdiag = 1;
 
     if (b < 0)
     {
         b = -b;
-        dyDiag = -1;
+        w.dydiag = -1;
     }
     else
-        dyDiag = 1;
+        w.dydiag = 1;
 
     if (a < b)
     {
         int swap = a; a = b; b = swap;
-        dxSquare = 0;
-        dySquare = dyDiag;
+        w.dxsquare = 0;
+        w.dysquare = w.dydiag;
     }
     else
     {
-        dxSquare = dxDiag;
-        dySquare = 0;
+        w.dxsquare = w.dxdiag;
+        w.dysquare = 0;
+    }
+    w.d = 2*b - a;
+    w.u = 2*b;
+    w.v = 2*(b - a);
+    w.pixelCount = a + 1;
+}
+
+// Takes one square or diagonal step along a line
+template <class S>
+static inline void LineStep(S& w)
+{
+    if (w.d < 0)
+    {
+        w.x += w.dxsquare;
+        w.y += w.dysquare;
+        w.d += w.u;
     }
-    d = 2*b - a;
-    squareInc = 2*b;
-    diagInc = 2*(b - a);
-    for (int i = 0; i <= a; i++)
+    else
     {
-        DrawPixel(x, y);
-        if (d < 0)
-        {
-            x += dxSquare;
-            y += dySquare;
-            d += squareInc;
-        }
-        else
-        {
-            x += dxDiag;
-            y += dyDiag;
-            d += diagInc;
-        }
+        w.x += w.dxdiag;
+        w.y += w.dydiag;
+        w.d += w.v;
+    }
+}
+
+// Bresenham's line-drawing algorithm. Draws a straight
+// line from starting point (xs,ys) to end point (xe,ye).
+//
+void Line(int xs, int ys, int xe, int ye)
+{
+    WALK<int> w;
+
+    if (g_segmentProc)
+    {
+        SEGMENT seg = { true, xs, ys, xe, ye, 0, 0, 0, 0, 0, 0, false, {} };
+
+        g_segmentProc(&seg);
+        return;
+    }
+    LineStart(w, xs, ys, xe, ye);
+    for (int i = 0; i < w.pixelCount; i++)
+    {
+        g_pixelProc(w.x, w.y);
+        LineStep(w);
     }
 }
 
@@ -79,7 +208,8 @@ void Line(int xs, int ys, int xe, int ye)
 // gradient at this point. The return value is an octant number in
 // the range 1 to 8.
 //
-int GetOctant(int dfdx, int dfdy)
+template <class T>
+static int Octant(T dfdx, T dfdy)
 {
     int oct = 0;
 
@@ -100,157 +230,390 @@ int GetOctant(int dfdx, int dfdy)
     return ++oct;
 }
 
-// Pitteway's algorithm for drawing a conic curve. This function
-// draws an arc of a conic curve given the arc's starting coordinates
-// (xs,ys), ending coordinates (xe,ye), and coefficients A-F of the
-// implicit conic equation
-//          f(x,y) = Ax^2 + Bxy + Cy^2 + Dx + Ey + F = 0
-// The algorithm assumes that the caller translates the origin to
-// the starting coordinates to calculate the coefficient values A-F
-// that are passed to this function. To draw a full ellipse instead
-// of an arc, set xe = xs and ye = ys.
+int GetOctant(int dfdx, int dfdy)
+{
+    return Octant(dfdx, dfdy);
+}
+
+// If w is in the final octant, counts the number of pixels to the
+// end of the arc
 //
-void Conic(int xs, int ys, int xe, int ye,
-           int A, int B, int C, int D, int E, int F)
+template <class S>
+static inline void WalkCount(S& w)
 {
-    int x, y, swap, octant, octantCount, pixelCount;
-    int dxsquare, dysquare, dxdiag, dydiag;
-    int d, u, v, k1, k2, k3, dSdx, dSdy;
+    if (w.octantCount)
+        return;
+    if (w.octant & 2)  // terminate in octant 2, 3, 6 or 7
+        w.pixelCount = 1 + abs(w.ye - w.y);
+    else               // terminate in octant 1, 4, 5 or 8
+        w.pixelCount = 1 + abs(w.xe - w.x);
+}
 
-    // Determine whether to draw all 8 octants or just an arc
-    octant = GetOctant(D, E);    // starting octant number
-    if (xs != xe || ys != ye)
-    {
-        // Draw just an arc
-        x = xe - xs;             // origin at (xs,ys)
-        y = ye - ys;
-        dSdx = 2*A*x + B*y + D;  // gradient at end point
-        dSdy = B*x + 2*C*y + E;
-        octantCount = GetOctant(dSdx,dSdy) - octant;
-        if (octantCount < 0)
-            octantCount += 8;
-    }
-    else
-        octantCount = 8;  // draw full ellipse (8 octants)
+// Sets the drawing control parameters of walk w for pixel (x,y) in
+// drawing octant w.octant, given the coefficients A-F of the curve
+// with the origin at (x,y). The parameters depend only on the pixel
+// and the octant, and not on how the walk got there, so this function
+// can also move a walk to a pixel farther along its curve.
+//
+template <class S, class T>
+static inline void WalkOctant(S& w, int x, int y, T A, T B, T C, T D, T E,
+                              T F)
+{
+    T tmp;
 
-    // Adjust parameters for starting octant
-    dxdiag = dydiag = 1;
-    dxsquare = dysquare = 0;
-    if ((octant + 1) & 4)
+    // Adjust parameters for drawing octant
+    w.dxdiag = w.dydiag = 1;
+    w.dxsquare = w.dysquare = 0;
+    if ((w.octant + 1) & 4)
     {
         D = -D;  // octants 3, 4, 5 and 6
-        dxdiag = -1;
+        w.dxdiag = -1;
     }
-    if ((octant - 1) & 4)
+    if ((w.octant - 1) & 4)
     {
         E = -E;  // octants 5, 6, 7 and 8
-        dydiag = -1;
+        w.dydiag = -1;
     }
-    if ((octant - 1) & 2)   // octants 3, 4, 7 and 8
+    if ((w.octant - 1) & 2)   // octants 3, 4, 7 and 8
         B = -B;
 
-    if (octant & 2)
+    if (w.octant & 2)
     {
-        dysquare = dydiag;  // octants 2, 3, 6 and 7
-        swap = A;   A = C;   C = swap;
-        swap = D;   D = E;   E = swap;
+        w.dysquare = w.dydiag;  // octants 2, 3, 6 and 7
+        tmp = A;   A = C;   C = tmp;
+        tmp = D;   D = E;   E = tmp;
     }
     else
-        dxsquare = dxdiag;
+        w.dxsquare = w.dxdiag;
 
     // Convert to fixed-point values with 2 bits of fraction
     A *= 4;   B *= 4;   C *= 4;
     D *= 4;   E *= 4;   F *= 4;
 
     // Initialize drawing control parameters
-    d  =  A + B/2 + C/4 + D + E/2 + F;
-    u  =  A + B/2 + D;
-    v  =  A + B/2 + D + E;
-    k1 =  2*A;
-    k2 =  2*A + B;
-    k3 =  2*A + 2*B + 2*C;
-    if (!(octant & 1))
+    w.d  =  A + B/2 + C/4 + D + E/2 + F;
+    w.u  =  A + B/2 + D;
+    w.v  =  A + B/2 + D + E;
+    w.k1 =  2*A;
+    w.k2 =  2*A + B;
+    w.k3 =  2*A + 2*B + 2*C;
+    if (!(w.octant & 1))
     {
         // Octant is even, so reverse signs
-        d  = -d;   k1 = -k1;
-        u  = -u;   k2 = -k2;
-        v  = -v;   k3 = -k3;
+        w.d  = -w.d;   w.k1 = -w.k1;
+        w.u  = -w.u;   w.k2 = -w.k2;
+        w.v  = -w.v;   w.k3 = -w.k3;
+    }
+    w.x = x;
+    w.y = y;
+}
+
+// Initializes walk w to draw the arc from (xs,ys) to (xe,ye). The
+// arguments are the same as for ConicWalk.
+//
+template <class S, class T>
+static inline void WalkStart(S& w, int xs, int ys, int xe, int ye,
+                      T A, T B, T C, T D, T E, T F)
+{
+    T dSdx, dSdy;
+
+    // Determine whether to draw all 8 octants or just an arc
+    w.octant = Octant(D, E);     // starting octant number
+    if (xs != xe || ys != ye)
+    {
+        // Draw just an arc
+        int x = xe - xs;         // origin at (xs,ys)
+        int y = ye - ys;
+
+        dSdx = 2*A*x + B*y + D;  // gradient at end point
+        dSdy = B*x + 2*C*y + E;
+        w.octantCount = Octant(dSdx,dSdy) - w.octant;
+        if (w.octantCount < 0)
+            w.octantCount += 8;
+    }
+    else
+        w.octantCount = 8;  // draw full ellipse (8 octants)
+
+    WalkOctant(w, xs, ys, A, B, C, D, E, F);
+    w.xe = xe;
+    w.ye = ye;
+    w.pixelCount = -1;
+    WalkCount(w);
+}
+
+// Returns true if walk w is still inside its current drawing octant
+template <class S>
+static inline bool WalkInOctant(const S& w)
+{
+    return (w.u > 0 || w.octant & 1) && (w.v < 0 || ~w.octant & 1);
+}
+
+// Takes one square or diagonal step along the curve
+template <class S>
+static inline void WalkStep(S& w)
+{
+    if (w.d < 0)
+    {
+        w.x += w.dxsquare;  // square step
+        w.y += w.dysquare;
+        w.u += w.k1;
+        w.v += w.k2;
+        w.d += w.u;
+    }
+    else
+    {
+        w.x += w.dxdiag;  // diagonal step
+        w.y += w.dydiag;
+        w.u += w.k2;
+        w.v += w.k3;
+        w.d += w.v;
+    }
+}
+
+// Adjusts the drawing parameters of walk w as it crosses the
+// boundary into the next drawing octant
+//
+template <class S>
+static inline void WalkTurn(S& w)
+{
+    int swap;
+
+    if (++w.octant & 1)
+    {
+        // Cross square octant boundary
+        w.d  = -w.d - w.u + w.v - w.k1 + w.k2;
+        w.v  = -2*w.u + w.v - w.k1 + w.k2;
+        w.u  = -w.u - w.k1 + w.k2;
+        w.k3 = -4*w.k1 + 4*w.k2 - w.k3;
+        w.k2 = -2*w.k1 + w.k2;
+        w.k1 = -w.k1;
+        swap = w.dxdiag;  w.dxdiag = -w.dydiag;  w.dydiag = swap;
+    }
+    else
+    {
+        // Cross diagonal octant boundary
+        w.d  = -w.d + w.u - w.v/2 + w.k2/2 - 3*w.k3/8;
+        w.u  =  w.u - w.v + w.k2/2 - w.k3/2;
+        w.v  = -w.v + w.k2 - w.k3/2;
+        w.k1 = -w.k1 + 2*w.k2 - w.k3;
+        w.k2 =  w.k2 - w.k3;
+        w.k3 = -w.k3;
+        swap = w.dxsquare;  w.dxsquare = -w.dysquare;  w.dysquare = swap;
+    }
+    WalkCount(w);
+}
+
+// Pixel limit for a walk whose arc has no known bounds (see WalkLimit)
+const int MAX_WALK_PIXELS = 1 << 22;
+
+// Walks stopped early by ConicWalk and ConicIter
+static WALKSTATS s_walkStats;
+
+// Fills in seg with the arguments of ConicWalk
+//
+template <class T>
+static void ConicSegment(SEGMENT *seg, int xs, int ys, int xe, int ye,
+                         T A, T B, T C, T D, T E, T F, const int *box)
+{
+    SEGMENT tmp = { false, xs, ys, xe, ye, A, B, C, D, E, F, box != 0, {} };
+
+    if (box)
+        std::copy(box, box + 4, tmp.box);
+    *seg = tmp;
+}
+
+// Records a walk that was stopped early at pixel (x,y). The walk has
+// the arguments in seg. If overrun is true, the walk was stopped by
+// its pixel limit; otherwise, it missed a turn. A walk that runs out
+// of octants on its end point has nothing left to draw but that
+// pixel, which is common for small curves, and is not recorded.
+//
+static void WalkStopped(const SEGMENT& seg, int x, int y, bool overrun)
+{
+    if (!overrun && x == seg.xe && y == seg.ye)
+        return;
+    if (overrun)
+        s_walkStats.overruns++;
+    else
+        s_walkStats.missedTurns++;
+    s_walkStats.last = seg;
+    s_walkStats.x = x;
+    s_walkStats.y = y;
+}
+
+// Gets the bounding box of the conic with coefficients A-F, with the
+// origin at (xs,ys), if the conic is an ellipse. Returns false if the
+// conic is not an ellipse, or is too large for its bounds to fit in
+// an int. This function is called once per arc, to set the pixel
+// limit, and so uses floating point, which has the range needed for
+// the products of 64-bit coefficients.
+//
+template <class T>
+static bool ConicExtent(int xs, int ys, T A, T B, T C, T D, T E, T F,
+                        int box[4])
+{
+    double a = (double)A, b = (double)B, c = (double)C;
+    double d = (double)D, e = (double)E;
+    double det = 4*a*c - b*b;
+    double xc, yc, g, xr, yr;
+
+    if (det <= 0)
+        return false;  // parabola or hyperbola
+
+    // Center (xc,yc) is where the gradient is zero, and g is minus
+    // the value of f(x,y) there
+    xc = (b*e - 2*c*d)/det;
+    yc = (b*d - 2*a*e)/det;
+    g = -(F + (d*xc + e*yc)/2);
+    xr = (c*g > 0) ? sqrt(4*c*g/det) : 0;
+    yr = (a*g > 0) ? sqrt(4*a*g/det) : 0;
+    if (fabs(xc) + xr + fabs((double)xs) > INT_MAX/2 ||
+        fabs(yc) + yr + fabs((double)ys) > INT_MAX/2)
+        return false;
+    box[0] = xs + (int)floor(xc - xr);
+    box[1] = ys + (int)floor(yc - yr);
+    box[2] = xs + (int)ceil(xc + xr);
+    box[3] = ys + (int)ceil(yc + yr);
+    return true;
+}
+
+// Sets w.stepsLeft, the number of pixels after which walk w is
+// stopped as a runaway. The walk has the arguments of ConicWalk,
+// and octantCount set by WalkStart. Within a drawing octant, every
+// step moves one pixel along the octant's major axis, and always in
+// the same direction, so an arc that stays inside a box takes no more
+// steps per octant than the box is wide or high. The box is the one
+// passed in, if any, or else the bounding box of the conic if it is
+// an ellipse. The arc of a parabola or hyperbola has no bounds that
+// can be found from the coefficients alone, so it is allowed up to
+// MAX_WALK_PIXELS pixels.
+//
+template <class S, class T>
+static inline void WalkLimit(S& w, int xs, int ys, T A, T B, T C, T D,
+                             T E, T F, const int *box)
+{
+    long long n = MAX_WALK_PIXELS;
+    int ext[4];
+
+    if (box == 0 && ConicExtent(xs, ys, A, B, C, D, E, F, ext))
+        box = ext;
+    if (box)
+    {
+        // Allow for pixels a little outside the box
+        n = std::max((long long)box[2] - box[0],
+                     (long long)box[3] - box[1]) + 3;
+        n *= w.octantCount + 1;
+    }
+    w.stepsLeft = (int)std::min(n, (long long)INT_MAX);
+}
+
+// Pitteway's algorithm for drawing a conic curve, implemented for
+// integer type T. Conic uses type int, and Conic64 uses long long.
+// If box is not 0, it points to the bounds xmin, ymin, xmax, ymax
+// of a rectangle known to contain the arc. A pixel that falls outside
+// this rectangle means that the algorithm has missed a sharp turn,
+// and so the arc is completed with a straight line to the end point.
+// This precaution is needed for hyperbolic arcs, which otherwise
+// might never turn back toward the end point. As a last resort, a
+// walk that draws more pixels than its arc can have (see WalkLimit)
+// is stopped and completed in the same way, so that no input, however
+// badly conditioned, can make the walk run on without end. Walks that
+// are stopped early are counted, and the most recent one is kept, for
+// GetWalkStats.
+//
+template <class T>
+static void ConicWalk(int xs, int ys, int xe, int ye,
+                      T A, T B, T C, T D, T E, T F, const int *box)
+{
+    WALK<T> w;
+    SEGMENT seg;
+
+    if (g_segmentProc)
+    {
+        ConicSegment(&seg, xs, ys, xe, ye, A, B, C, D, E, F, box);
+        g_segmentProc(&seg);
+        return;
     }
+    WalkStart(w, xs, ys, xe, ye, A, B, C, D, E, F);
+    WalkLimit(w, xs, ys, A, B, C, D, E, F, box);
 
     // Each iteration of for-loop draws one octant of conic curve
-    x = xs;
-    y = ys;
-    pixelCount = -1;
     for (;;)
     {
-        // If final octant, count number of pixels to end of arc
-        if (!octantCount)
-        {
-            if (octant & 2)  // terminate in octant 2, 3, 6 or 7
-                pixelCount = 1 + abs(ye - y);
-            else             // terminate in octant 1, 4, 5 or 8
-                pixelCount = 1 + abs(xe - x);
-        }
-
         // Track curve through current drawing octant
-        while ((u > 0 || octant & 1) && (v < 0 || ~octant & 1))
+        while (WalkInOctant(w))
         {
-            DrawPixel(x, y);
-            if (--pixelCount == 0)
-                return;  // we drew all pixels in final octant
+            bool outside = box && (w.x < box[0] || w.y < box[1] ||
+                                   w.x > box[2] || w.y > box[3]);
 
-            if (d < 0)
-            {
-                x += dxsquare;  // square step
-                y += dysquare;
-                u += k1;
-                v += k2;
-                d += u;
-            }
-            else
+            if (outside || --w.stepsLeft < 0)
             {
-                x += dxdiag;  // diagonal step
-                y += dydiag;
-                u += k2;
-                v += k3;
-                d += v;
+                // Missed a turn, or ran away
+                ConicSegment(&seg, xs, ys, xe, ye, A, B, C, D, E, F, box);
+                WalkStopped(seg, w.x, w.y, !outside);
+                Line(w.x, w.y, xe, ye);
+                return;
             }
+            g_pixelProc(w.x, w.y);
+            if (--w.pixelCount == 0)
+                return;  // we drew all pixels in final octant
+
+            WalkStep(w);
         }
 
         // Cross boundary into next drawing octant
-        if (--octantCount < 0)
+        if (--w.octantCount < 0)
         {
             // Oops -- failed to draw all pixels in final octant
-            Line(x, y, xe, ye);  // draw line to end point
+            ConicSegment(&seg, xs, ys, xe, ye, A, B, C, D, E, F, box);
+            WalkStopped(seg, w.x, w.y, false);
+            Line(w.x, w.y, xe, ye);  // draw line to end point
             return;
         }
-
-        // Adjust drawing parameters for new octant
-        if (++octant & 1)
-        {
-            // Cross square octant boundary
-            d  = -d - u + v - k1 + k2;
-            v  = -2*u + v - k1 + k2;
-            u  = -u - k1 + k2;
-            k3 = -4*k1 + 4*k2 - k3;
-            k2 = -2*k1 + k2;
-            k1 = -k1;
-            swap = dxdiag;  dxdiag = -dydiag;  dydiag = swap;
-        }
-        else
-        {
-            // Cross diagonal octant boundary
-            d  = -d + u - v/2 + k2/2 - 3*k3/8;
-            u  =  u - v + k2/2 - k3/2;
-            v  = -v + k2 - k3/2;
-            k1 = -k1 + 2*k2 - k3;
-            k2 =  k2 - k3;
-            k3 = -k3;
-            swap = dxsquare;  dxsquare = -dysquare;  dysquare = swap;
-        }
+        WalkTurn(w);
     }
 }
 
+// Pitteway's algorithm for drawing a conic curve. This function
+// draws an arc of a conic curve given the arc's starting coordinates
+// (xs,ys), ending coordinates (xe,ye), and coefficients A-F of the
+// implicit conic equation
+//          f(x,y) = Ax^2 + Bxy + Cy^2 + Dx + Ey + F = 0
+// The algorithm assumes that the caller translates the origin to
+// the starting coordinates to calculate the coefficient values A-F
+// that are passed to this function. To draw a full ellipse instead
+// of an arc, set xe = xs and ye = ys.
+//
+void Conic(int xs, int ys, int xe, int ye,
+           int A, int B, int C, int D, int E, int F)
+{
+    ConicWalk(xs, ys, xe, ye, A, B, C, D, E, F, (int*)0);
+}
+
+// Version of Conic with 64-bit coefficients. This function is used in
+// place of Conic when the coefficient values are too large to fit in
+// an int -- for example, when the coefficients are calculated from
+// fixed-point coordinates.
+//
+void Conic64(int xs, int ys, int xe, int ye, long long A, long long B,
+             long long C, long long D, long long E, long long F)
+{
+    ConicWalk(xs, ys, xe, ye, A, B, C, D, E, F, (int*)0);
+}
+
+// Gets the straight line to draw for a degenerate ellipse, whose
+// conjugate diameters (xp,yp) and (xq,yq) are parallel. The line runs
+// from P0 + (*x,*y) to P0 - (*x,*y).
+//
+static void DegenerateEllipse(long long xp, long long yp, long long xq,
+                              long long yq, int *x, int *y)
+{
+    *x = ISqrt(xp*xp + xq*xq);
+    *y = ISqrt(yp*yp + yq*yq);
+    if ((((xp-xq)^(yp-yq)) | ((xp+xq)^(yp+yq))) < 0)
+        *y = -*y;  // x and y have opposite signs
+}
+
 // Draws a full ellipse. The ellipse can be arbitrarily oriented. It
 // is specified in terms of its center point P0, and the end points 
 // P1 and P2 of a pair of conjugate diameters of the ellipse. These
@@ -263,7 +626,7 @@ void Conic(int xs, int ys, int xe, int ye,
 //
 void Ellipse(int x0, int y0, int x1, int y1, int x2, int y2)
 {
-    int xp, yp, xq, yq, xprod, xe, ye;
+    int xp, yp, xq, yq, xprod;
     int A, B, C, D, E, F;
 
     xp = x1 - x0;
@@ -277,12 +640,9 @@ void Ellipse(int x0, int y0, int x1, int y1, int x2, int y2)
     if (xprod == 0)
     {
         // Draw degenerate ellipse as a straight line
-        int x = sqrt(float(C)) + 0.5;
-        int y = sqrt(float(A)) + 0.5;
-
-        if (((xp-xq)^(yp-yq) | (xp+xq)^(yp+yq)) < 0)
-            y = -y;  // x and y have opposite signs
+        int x, y;
 
+        DegenerateEllipse(xp, yp, xq, yq, &x, &y);
         Line(x0+x, y0+y, x0-x, y0-y);
         return;
     }
@@ -300,6 +660,23 @@ void Ellipse(int x0, int y0, int x1, int y1, int x2, int y2)
     Conic(x1, y1, x1, y1, A, B, C, D, E, F);
 }
 
+// Gets the bounding box of the triangle formed by the start point,
+// control point, and end point of a spline, which contains the
+// spline, widened by a pixel on each side. The box is passed to
+// ConicWalk, which finishes a walk that strays outside it with a
+// straight line to the end point, instead of letting it run on.
+// The extra pixel allows for the pixels of an arc that runs along an
+// edge of the box, which can lie just outside it.
+//
+static void SplineBox(int xs, int ys, int xc, int yc, int xe, int ye,
+                      int box[4])
+{
+    box[0] = std::min(xs, std::min(xc, xe)) - 1;
+    box[1] = std::min(ys, std::min(yc, ye)) - 1;
+    box[2] = std::max(xs, std::max(xc, xe)) + 1;
+    box[3] = std::max(ys, std::max(yc, ye)) + 1;
+}
+
 // Draws a spline curve consisting of a PI/2-radian arc of ellipse
 // (a quarter of an ellipse). The spline is specified in terms of
 // its start point Ps = (xs,ys), end point Pe = (xe,ye), and control
@@ -311,6 +688,7 @@ void EllipticSpline(int xs, int ys, int xc, int yc, int xe, int ye)
 {
     int xp, yp, xq, yq, xprod;
     int A, B, C, D, E, F;
+    int box[4];
 
     xp = xc - xe;
     yp = yc - ye;
@@ -323,8 +701,8 @@ void EllipticSpline(int xs, int ys, int xc, int yc, int xe, int ye)
     if (xprod == 0)
     {
         // Draw degenerate conic arc as two straight lines
-        int dx = sqrt(float(C)) + 0.5;
-        int dy = sqrt(float(A)) + 0.5;
+        int dx = ISqrt(C);
+        int dy = ISqrt(A);
         int x = xs + xe - xc;
         int y = ys + ye - yc;
 
@@ -345,7 +723,8 @@ void EllipticSpline(int xs, int ys, int xc, int yc, int xe, int ye)
     D =  2*yq*xprod;
     E = -2*xq*xprod;
     F =  0;
-    Conic(xs, ys, xe, ye, A, B, C, D, E, F);
+    SplineBox(xs, ys, xc, yc, xe, ye, box);
+    ConicWalk(xs, ys, xe, ye, A, B, C, D, E, F, box);
 }
 
 // Draws a parabolic spline (aka quadratic Bezier curve). The spline 
@@ -358,6 +737,7 @@ void ParabolicSpline(int xs, int ys, int xc, int yc, int xe, int ye)
 {
     int xq, yq, xr, yr, xprod;
     int A, B, C, D, E, F;
+    int box[4];
 
     xq = xe - xs;
     yq = ye - ys;
@@ -389,6 +769,2804 @@ void ParabolicSpline(int xs, int ys, int xc, int yc, int xe, int ye)
     D =  4*yr*xprod;
     E = -4*xr*xprod;
     F =  0;
-    Conic(xs, ys, xe, ye, A, B, C, D, E, F);
+    SplineBox(xs, ys, xc, yc, xe, ye, box);
+    ConicWalk(xs, ys, xe, ye, A, B, C, D, E, F, box);
+}
+
+
+// Draws a rational quadratic Bezier curve. The curve is specified in
+// terms of its start point Ps = (xs,ys), end point Pe = (xe,ye), and
+// control point Pc = (xc,yc), and weight w of the control point. The
+// weight is a fixed-point value with FIX_SHIFT bits of fraction. The
+// curve is an elliptic arc if w < 1, a parabolic arc if w = 1, and
+// a hyperbolic arc if w > 1. For example, a weight of FIX_ONE draws
+// the same parabolic spline as ParabolicSpline, and a weight of
+// 181 (approximately FIX_ONE/sqrt(2)) draws the same quarter ellipse
+// as EllipticSpline. Like the other splines, the curve is contained
+// within the triangle formed by points Ps, Pc, and Pe, and is tangent
+// to sides Ps.Pc and Pe.Pc at Ps and Pe. Weights larger than 16
+// (16*FIX_ONE) are treated as 16, and weights less than or equal to
+// zero draw a straight line from Ps to Pe.
+//
+// In terms of the barycentric coordinates (t0,t1,t2) of a point
+// relative to the triangle Ps.Pc.Pe, the implicit equation of the
+// curve is t1^2 = 4*w^2*t0*t2.
+//
+void RationalQuadSpline(int xs, int ys, int xc, int yc, int xe, int ye,
+                        int w)
+{
+    long long xq, yq, xr, yr, xprod, num, den;
+    long long A, B, C, D, E, F;
+
+    if (w <= 0)
+    {
+        Line(xs, ys, xe, ye);
+        return;
+    }
+    if (w > 16*FIX_ONE)
+        w = 16*FIX_ONE;
+
+    xq = xe - xs;
+    yq = ye - ys;
+    xr = xc - xs;
+    yr = yc - ys;
+    xprod = xr*yq - xq*yr;
+    if (xprod == 0)
+    {
+        // Draw degenerate conic arc as two lines through the point
+        // at which the curve parameter t = 1/2
+        long long wx = (long long)w*xc;
+        long long wy = (long long)w*yc;
+        long long den2 = 2*(FIX_ONE + w);
+        int x = (FIX_ONE*(xs + xe) + 2*wx + den2/2)/den2;
+        int y = (FIX_ONE*(ys + ye) + 2*wy + den2/2)/den2;
+        Line(xs, ys, x, y);
+        Line(x, y, xe, ye);
+        return;
+    }
+    if (xprod < 0)
+    {
+        int swap = xs; xs = xe; xe = swap;
+        swap = ys; ys = ye; ye = swap;
+        xq = -xq;
+        yq = -yq;
+        xr += xq;
+        yr += yq;
+        xprod = -xprod;
+    }
+
+    // The curve equation is den*L1^2 - num*L2*(K - L1 - L2) = 0, where
+    // num/den = 4*w^2 reduced to lowest terms, K = xprod, L1 = K*t1,
+    // and L2 = K*t2
+    num = 4LL*w*w;
+    den = FIX_ONE*FIX_ONE;
+    while (!(num & 1) && !(den & 1))
+    {
+        num >>= 1;
+        den >>= 1;
+    }
+    A =  den*yq*yq + num*(yr - yq)*yr;
+    B = -2*den*xq*yq + num*((xq - 2*xr)*yr + xr*yq);
+    C =  den*xq*xq + num*(xr - xq)*xr;
+    D =  num*yr*xprod;
+    E = -num*xr*xprod;
+    F =  0;
+
+    // The arc is contained in the bounding box of the triangle
+    int box[4];
+    box[0] = std::min(xs, std::min(xc, xe));
+    box[1] = std::min(ys, std::min(yc, ye));
+    box[2] = std::max(xs, std::max(xc, xe));
+    box[3] = std::max(ys, std::max(yc, ye));
+    ConicWalk(xs, ys, xe, ye, A, B, C, D, E, F, box);
+}
+
+//-----------------------------------------------------------
+//
+// Fixed-point splines
+//
+// The ...Fx versions of the spline functions accept coordinates
+// in fixed-point format, with FIX_SHIFT bits of fraction, so that a
+// curve can be positioned with subpixel precision. The coefficients
+// A-F are calculated from the exact fixed-point coordinates, and are
+// then translated to an origin at the center of the pixel nearest
+// the start point. The resulting coefficient values are too large
+// for Conic, and so are passed to Conic64 instead. The coordinates
+// of the three points that define a spline should lie within 2048
+// pixels of each other to avoid overflowing the 64-bit coefficients.
+//
+//-----------------------------------------------------------
+
+// Converts fixed-point value v to an integer, rounding to nearest
+//
+static inline int FixToInt(int v)
+{
+    return (v + FIX_ONE/2) >> FIX_SHIFT;
+}
+
+// Divides v by 2^shift, rounding to nearest
+//
+static inline long long RoundShift(long long v, int shift)
+{
+    return (v + (1LL << (shift - 1))) >> shift;
 }
 
+// Draws a conic arc from fixed-point start point (xs,ys) to fixed-point
+// end point (xe,ye). Coefficients A-E are calculated from fixed-point
+// coordinates with the origin at the exact start point, so that F = 0.
+// This function moves the origin to the center of the nearest pixel,
+// scales the equation so that x and y are in pixel units, and draws
+// the arc. Fixed-point control point (xc,yc) is used only to bound
+// the arc (see SplineBox).
+//
+static void ConicFx(int xs, int ys, int xc, int yc, int xe, int ye,
+                    long long A, long long B, long long C, long long D,
+                    long long E)
+{
+    int box[4];
+    int xpix = FixToInt(xs);
+    int ypix = FixToInt(ys);
+    long long dx = xpix*FIX_ONE - xs;  // start point to pixel center
+    long long dy = ypix*FIX_ONE - ys;
+    long long F;
+
+    // After translation, the gradient at the origin is (D,E), and F
+    // is the value of the original equation at the pixel center.
+    // Dividing the equation by FIX_ONE^2 changes the units of x and y
+    // from fixed-point units to pixels.
+    F = RoundShift(A*dx*dx + B*dx*dy + C*dy*dy, 2*FIX_SHIFT)
+      + RoundShift(RoundShift(D, FIX_SHIFT)*dx
+                   + RoundShift(E, FIX_SHIFT)*dy, FIX_SHIFT);
+    D = RoundShift(2*A*dx + B*dy + D, FIX_SHIFT);
+    E = RoundShift(B*dx + 2*C*dy + E, FIX_SHIFT);
+    SplineBox(xs >> FIX_SHIFT, ys >> FIX_SHIFT, xc >> FIX_SHIFT,
+              yc >> FIX_SHIFT, xe >> FIX_SHIFT, ye >> FIX_SHIFT, box);
+    box[2]++;  // allow for rounding up
+    box[3]++;
+    ConicWalk(xpix, ypix, FixToInt(xe), FixToInt(ye), A, B, C, D, E, F,
+              box);
+}
+
+// Fixed-point version of EllipticSpline. Coordinates xs through ye
+// are fixed-point values with FIX_SHIFT bits of fraction.
+//
+void EllipticSplineFx(int xs, int ys, int xc, int yc, int xe, int ye)
+{
+    long long xp, yp, xq, yq, xprod;
+    long long A, B, C, D, E;
+
+    xp = xc - xe;
+    yp = yc - ye;
+    xq = xc - xs;
+    yq = yc - ys;
+    A =  yp*yp + yq*yq;
+    B = -2*(xp*yp + xq*yq);
+    C =  xp*xp + xq*xq;
+    xprod = xp*yq - xq*yp;
+    if (xprod == 0 || (FixToInt(xs) == FixToInt(xe) &&
+                       FixToInt(ys) == FixToInt(ye)))
+    {
+        // Draw degenerate conic arc as two straight lines
+        int dx = ISqrt(C);
+        int dy = ISqrt(A);
+        int x = xs + xe - xc;
+        int y = ys + ye - yc;
+
+        x += (xc < x) ? -dx : dx;
+        y += (yc < y) ? -dy : dy;
+        Line(FixToInt(xs), FixToInt(ys), FixToInt(x), FixToInt(y));
+        Line(FixToInt(x), FixToInt(y), FixToInt(xe), FixToInt(ye));
+        return;
+    }
+    if (xprod < 0)
+    {
+        int swap = xs; xs = xe; xe = swap;
+        swap = ys; ys = ye; ye = swap;
+        long long tmp = xp; xp = xq; xq = tmp;
+        tmp = yp; yp = yq; yq = tmp;
+        xprod = -xprod;
+    }
+    D =  2*yq*xprod;
+    E = -2*xq*xprod;
+    ConicFx(xs, ys, xc, yc, xe, ye, A, B, C, D, E);
+}
+
+// Fixed-point version of ParabolicSpline. Coordinates xs through ye
+// are fixed-point values with FIX_SHIFT bits of fraction.
+//
+void ParabolicSplineFx(int xs, int ys, int xc, int yc, int xe, int ye)
+{
+    long long xq, yq, xr, yr, xprod;
+    long long A, B, C, D, E;
+
+    xq = xe - xs;
+    yq = ye - ys;
+    xr = xc - xs;
+    yr = yc - ys;
+    xprod = xr*yq - xq*yr;
+    if (xprod == 0 || (FixToInt(xs) == FixToInt(xe) &&
+                       FixToInt(ys) == FixToInt(ye)))
+    {
+        // Draw degenerate conic arc as two lines
+        int x = FixToInt((xs + 2*xc + xe)/4);
+        int y = FixToInt((ys + 2*yc + ye)/4);
+        Line(FixToInt(xs), FixToInt(ys), x, y);
+        Line(x, y, FixToInt(xe), FixToInt(ye));
+        return;
+    }
+    if (xprod < 0)
+    {
+        int swap = xs; xs = xe; xe = swap;
+        swap = ys; ys = ye; ye = swap;
+        xq = -xq;
+        yq = -yq;
+        xr += xq;
+        yr += yq;
+        xprod = -xprod;
+    }
+    A =  4*(yr - yq)*yr + yq*yq;
+    B =  4*((xq - xr)*yr - (yr - yq)*xr) - 2*xq*yq;
+    C =  4*(xr - xq)*xr + xq*xq;
+    D =  4*yr*xprod;
+    E = -4*xr*xprod;
+    ConicFx(xs, ys, xc, yc, xe, ye, A, B, C, D, E);
+}
+
+//-----------------------------------------------------------
+//
+// Cubic splines
+//
+// A cubic Bezier curve is drawn by dividing it into n pieces
+// of equal parameter length, and approximating each piece with a
+// parabolic spline, which is then drawn by Pitteway's algorithm.
+// The control point of the parabolic spline for the piece with
+// cubic control points Q0, Q1, Q2, Q3 is (3*(Q1 + Q2) - Q0 - Q3)/4.
+// The distance between the piece and this parabola is at most
+//          sqrt(3)/36 * |P3 - 3*P2 + 3*P1 - P0| / n^3
+// where P0-P3 are the control points of the original cubic curve.
+// The smallest n for which this bound does not exceed the error
+// tolerance is used. For comparison, flattening the cubic curve into
+// n straight lines produces an error of at most
+//          3/4 * max(|P2 - 2*P1 + P0|, |P3 - 2*P2 + P1|) / n^2
+//
+//-----------------------------------------------------------
+
+// Maximum number of pieces into which a cubic spline is divided
+const int CUBIC_MAXPIECES = 256;
+
+// Divides n by d, where d > 0, and rounds to the nearest integer
+//
+static inline long long RoundDiv(long long n, long long d)
+{
+    return (n >= 0) ? (n + d/2)/d : -((d/2 - n)/d);
+}
+
+// Returns the number of parabolic splines needed to approximate the
+// cubic curve with control points (x0,y0) through (x3,y3), given
+// the error tolerance tol. All values are fixed-point.
+//
+static int CubicPieces(int x0, int y0, int x1, int y1,
+                       int x2, int y2, int x3, int y3, int tol)
+{
+    long long dx = x3 - 3LL*x2 + 3LL*x1 - x0;
+    long long dy = y3 - 3LL*y2 + 3LL*y1 - y0;
+    long long dd = 3*(dx*dx + dy*dy);
+    int n;
+
+    // Find smallest n for which (36*tol*n^3)^2 >= 3*(dx^2 + dy^2)
+    for (n = 1; n < CUBIC_MAXPIECES; n++)
+    {
+        long long bound = 36LL*tol*n*n*n;
+        if (bound >= (1LL << 31) || bound*bound >= dd)
+            break;
+    }
+    return n;
+}
+
+// Draws a cubic Bezier curve with start point Ps = (xs,ys), control
+// points P1 = (x1,y1) and P2 = (x2,y2), and end point Pe = (xe,ye).
+// The curve starts at Ps, ends at Pe, and is tangent to side Ps.P1
+// at Ps and to side P2.Pe at Pe. The curve is drawn as a series
+// of parabolic splines, each of which is within distance tol of the
+// cubic curve. Coordinates and tol are fixed-point values with
+// FIX_SHIFT bits of fraction. The return value is the number of
+// parabolic splines drawn.
+//
+int CubicSplineFx(int xs, int ys, int x1, int y1, int x2, int y2,
+                  int xe, int ye, int tol)
+{
+    long long ax, ay, bx, by, cx, cy, n, n2, n3;
+    int xa, ya, xb, yb, xc, yc;
+    long long dxa, dya, dxb, dyb;
+
+    if (tol < 1)
+        tol = 1;
+    n = CubicPieces(xs, ys, x1, y1, x2, y2, xe, ye, tol);
+    n2 = n*n;
+    n3 = n2*n;
+
+    // Express the curve as the polynomial P(t) = Ps + a*t + b*t^2 +
+    // c*t^3, which has derivative P'(t) = a + 2*b*t + 3*c*t^2
+    ax = 3LL*(x1 - xs);
+    ay = 3LL*(y1 - ys);
+    bx = 3LL*(x2 - 2LL*x1 + xs);
+    by = 3LL*(y2 - 2LL*y1 + ys);
+    cx = xe - 3LL*x2 + 3LL*x1 - xs;
+    cy = ye - 3LL*y2 + 3LL*y1 - ys;
+
+    // Start point and derivative (times n^2) of first piece
+    xa = xs;
+    ya = ys;
+    dxa = ax*n2;
+    dya = ay*n2;
+    for (long long i = 1; i <= n; i++)
+    {
+        // End point and derivative (times n^2) at t = i/n
+        if (i == n)
+        {
+            xb = xe;
+            yb = ye;
+        }
+        else
+        {
+            xb = xs + RoundDiv(((ax*n + bx*i)*n + cx*i*i)*i, n3);
+            yb = ys + RoundDiv(((ay*n + by*i)*n + cy*i*i)*i, n3);
+        }
+        dxb = (ax*n + 2*bx*i)*n + 3*cx*i*i;
+        dyb = (ay*n + 2*by*i)*n + 3*cy*i*i;
+
+        // Control point of the parabola that approximates the piece
+        // is (Pa + Pb)/2 + (P'a - P'b)/(4*n)
+        xc = RoundDiv(2*n3*(xa + xb) + dxa - dxb, 4*n3);
+        yc = RoundDiv(2*n3*(ya + yb) + dya - dyb, 4*n3);
+        ParabolicSplineFx(xa, ya, xc, yc, xb, yb);
+
+        xa = xb;
+        ya = yb;
+        dxa = dxb;
+        dya = dyb;
+    }
+    return n;
+}
+
+// Integer version of CubicSplineFx. Coordinates xs through ye are
+// integers, but tolerance tol is a fixed-point value (for example,
+// FIX_ONE/2 for an error tolerance of half a pixel). Returns the
+// number of parabolic splines drawn.
+//
+int CubicSpline(int xs, int ys, int x1, int y1, int x2, int y2,
+                int xe, int ye, int tol)
+{
+    return CubicSplineFx(xs*FIX_ONE, ys*FIX_ONE, x1*FIX_ONE, y1*FIX_ONE,
+                         x2*FIX_ONE, y2*FIX_ONE, xe*FIX_ONE, ye*FIX_ONE,
+                         tol);
+}
+
+// Returns the number of straight lines that would be needed to draw
+// the same cubic curve as CubicSplineFx by flattening the curve into
+// lines of equal parameter length, with the same error tolerance
+// tol. The arguments are the same as for CubicSplineFx.
+//
+int CubicLineCount(int xs, int ys, int x1, int y1, int x2, int y2,
+                   int xe, int ye, int tol)
+{
+    long long dx1 = x2 - 2LL*x1 + xs;
+    long long dy1 = y2 - 2LL*y1 + ys;
+    long long dx2 = xe - 2LL*x2 + x1;
+    long long dy2 = ye - 2LL*y2 + y1;
+    long long dd = std::max(dx1*dx1 + dy1*dy1, dx2*dx2 + dy2*dy2);
+    long long n;
+
+    if (tol < 1)
+        tol = 1;
+
+    // Find smallest n for which (4*tol*n^2)^2 >= 9*dd
+    for (n = 1; ; n++)
+    {
+        long long bound = 4LL*tol*n*n;
+        if (bound >= (1LL << 31) || bound*bound >= 9*dd)
+            break;
+    }
+    return n;
+}
+
+//-----------------------------------------------------------
+//
+// Wide strokes
+//
+// A wide stroke is the area swept by a round pen of diameter
+// 'width' as the pen's center follows the one-pixel-wide curve
+// drawn by Pitteway's algorithm. The outer and inner boundaries
+// of this area are not tracked as separate curves (the offset
+// curves of an ellipse or parabola are not conics). Instead, the
+// row-by-row extents of the pen are accumulated as spans while the
+// center curve is drawn. After the curve is complete, the spans in
+// each row are merged, so that the boundaries of the stroke are the
+// end points of the merged spans, and each pixel inside the stroke
+// is filled exactly once. If a segment function is in effect (see
+// SetSegmentProc), the center curve is still drawn a pixel at a time,
+// and the merged spans are passed to the segment function as
+// horizontal lines.
+//
+//-----------------------------------------------------------
+
+// Horizontal span of pixels from xl to xr, inclusive
+struct SPAN
+{
+    int xl; int xr;
+};
+
+// State information for the stroke currently being accumulated
+static struct
+{
+    int ytop, nrows;          // y coordinate and number of span rows
+    int pentop, penrows;      // offset to top row and height of pen
+    std::vector<int> penlo;   // left x offset for each row of pen
+    std::vector<int> penhi;   // right x offset for each row of pen
+    std::vector< std::vector<SPAN> > rows;  // spans for each row
+    SEGMENTPROC segmentProc;  // segment function to restore at the end
+} s_stroke;
+
+// Adds rows to the stroke so that it covers rows top to bottom, which
+// are numbered from the current top row and can lie outside it
+//
+static void GrowStroke(int top, int bottom)
+{
+    int above = std::max(-top, 0);
+    int nrows = std::max(bottom + 1, s_stroke.nrows) + above;
+
+    s_stroke.rows.insert(s_stroke.rows.begin(), above,
+                         std::vector<SPAN>());
+    if ((int)s_stroke.rows.size() < nrows)
+        s_stroke.rows.resize(nrows);
+    for (int row = s_stroke.nrows + above; row < nrows; row++)
+        s_stroke.rows[row].clear();
+    s_stroke.ytop -= above;
+    s_stroke.nrows = nrows;
+}
+
+// Pixel function that stamps the pen into the span rows of the
+// stroke, centered at pixel (x,y). Consecutive pixels of a curve
+// produce overlapping spans, which are merged as they are added. A
+// pixel of a walk that misses a turn can stray outside the rows set
+// up by BeginStroke, and rows are added for it.
+//
+static void StrokePixel(int x, int y)
+{
+    int row = y + s_stroke.pentop - s_stroke.ytop;
+
+    if (row < 0 || row + s_stroke.penrows > s_stroke.nrows)
+    {
+        GrowStroke(row, row + s_stroke.penrows - 1);
+        row = y + s_stroke.pentop - s_stroke.ytop;
+    }
+    for (int j = 0; j < s_stroke.penrows; j++, row++)
+    {
+        std::vector<SPAN>& spans = s_stroke.rows[row];
+        int xl = x + s_stroke.penlo[j];
+        int xr = x + s_stroke.penhi[j];
+
+        if (spans.size() && xl <= spans.back().xr + 1
+                         && xr >= spans.back().xl - 1)
+        {
+            SPAN& last = spans.back();
+            last.xl = std::min(last.xl, xl);
+            last.xr = std::max(last.xr, xr);
+        }
+        else
+        {
+            SPAN span = { xl, xr };
+            spans.push_back(span);
+        }
+    }
+}
+
+// Prepares to accumulate a stroke of the specified width for a curve
+// whose center pixels should lie in rows ymin to ymax. The pen is a disk
+// of diameter 'width'. For an odd width, the disk is centered on the
+// pixel; for an even width, it is centered on the pixel's top-left
+// corner. A pixel is in the pen if its center lies inside the disk.
+// Segment capture is suspended until EndStroke, so that the center
+// curve is drawn a pixel at a time.
+//
+static void BeginStroke(int ymin, int ymax, int width)
+{
+    int e = 1 - (width & 1);  // 1 if even width, else 0
+    int half = width/2;
+
+    s_stroke.pentop = -half;
+    s_stroke.penrows = width;
+    s_stroke.penlo.resize(width);
+    s_stroke.penhi.resize(width);
+    for (int j = 0; j < width; j++)
+    {
+        int dy = 2*(j - half) + e;
+        int i = 0;
+
+        // Find the largest i for which (2i+e)^2 + dy^2 <= width^2
+        while ((2*i + 2 + e)*(2*i + 2 + e) + dy*dy <= width*width)
+            i++;
+        s_stroke.penlo[j] = -i - e;
+        s_stroke.penhi[j] = i;
+    }
+    s_stroke.ytop = ymin - half;
+    s_stroke.nrows = ymax - ymin + width;
+    if ((int)s_stroke.rows.size() < s_stroke.nrows)
+        s_stroke.rows.resize(s_stroke.nrows);
+    for (int row = 0; row < s_stroke.nrows; row++)
+        s_stroke.rows[row].clear();
+    s_stroke.segmentProc = g_segmentProc;
+    g_segmentProc = 0;
+}
+
+// Sorts and merges the spans accumulated in each row of the stroke,
+// and then fills the merged spans (see EmitSpan)
+//
+static bool CompareSpans(const SPAN& a, const SPAN& b)
+{
+    return a.xl < b.xl;
+}
+
+static void EndStroke()
+{
+    g_segmentProc = s_stroke.segmentProc;
+    for (int row = 0; row < s_stroke.nrows; row++)
+    {
+        std::vector<SPAN>& spans = s_stroke.rows[row];
+        int y = s_stroke.ytop + row;
+        int n = spans.size();
+
+        if (n == 0)
+            continue;
+        if (n > 1)
+            std::sort(spans.begin(), spans.end(), CompareSpans);
+
+        SPAN span = spans[0];
+        for (int i = 1; i < n; i++)
+        {
+            if (spans[i].xl <= span.xr + 1)
+            {
+                span.xr = std::max(span.xr, spans[i].xr);
+                continue;
+            }
+            EmitSpan(span.xl, span.xr, y);
+            span = spans[i];
+        }
+        EmitSpan(span.xl, span.xr, y);
+    }
+}
+
+// Draws the outline of an ellipse as a stroke of the specified width,
+// in pixels. The ellipse is specified by the same parameters as for
+// the Ellipse function. If width <= 1, this function simply calls
+// Ellipse.
+//
+void WideEllipse(int x0, int y0, int x1, int y1, int x2, int y2, int width)
+{
+    if (width <= 1)
+    {
+        Ellipse(x0, y0, x1, y1, x2, y2);
+        return;
+    }
+
+    // The parallelogram that encloses the ellipse bounds its rows
+    int ybox = abs(y1 - y0) + abs(y2 - y0) + 1;
+    PIXELPROC prev;
+
+    BeginStroke(y0 - ybox, y0 + ybox, width);
+    prev = SetPixelProc(StrokePixel);
+    Ellipse(x0, y0, x1, y1, x2, y2);
+    SetPixelProc(prev);
+    EndStroke();
+}
+
+// Draws an elliptic spline as a stroke of the specified width. The
+// spline is specified by the same parameters as for EllipticSpline.
+//
+void WideEllipticSpline(int xs, int ys, int xc, int yc, int xe, int ye,
+                        int width)
+{
+    if (width <= 1)
+    {
+        EllipticSpline(xs, ys, xc, yc, xe, ye);
+        return;
+    }
+
+    // The spline is contained in the triangle Ps.Pc.Pe
+    int ymin = std::min(ys, std::min(yc, ye));
+    int ymax = std::max(ys, std::max(yc, ye));
+    PIXELPROC prev;
+
+    BeginStroke(ymin - 1, ymax + 1, width);
+    prev = SetPixelProc(StrokePixel);
+    EllipticSpline(xs, ys, xc, yc, xe, ye);
+    SetPixelProc(prev);
+    EndStroke();
+}
+
+// Draws a parabolic spline as a stroke of the specified width. The
+// spline is specified by the same parameters as for ParabolicSpline.
+//
+void WideParabolicSpline(int xs, int ys, int xc, int yc, int xe, int ye,
+                         int width)
+{
+    if (width <= 1)
+    {
+        ParabolicSpline(xs, ys, xc, yc, xe, ye);
+        return;
+    }
+
+    int ymin = std::min(ys, std::min(yc, ye));
+    int ymax = std::max(ys, std::max(yc, ye));
+    PIXELPROC prev;
+
+    BeginStroke(ymin - 1, ymax + 1, width);
+    prev = SetPixelProc(StrokePixel);
+    ParabolicSpline(xs, ys, xc, yc, xe, ye);
+    SetPixelProc(prev);
+    EndStroke();
+}
+
+//-----------------------------------------------------------
+//
+// Filled ellipses
+//
+// An ellipse is convex, so each row of a filled ellipse is a
+// single span. The outline is drawn by Pitteway's algorithm into a
+// table of row extents, and each row is then filled from the
+// leftmost to the rightmost pixel of the outline in that row. The
+// filled area therefore covers exactly the pixels of the outline
+// and everything between them, and is sent to the span function
+// one row at a time, so that a span function that writes whole
+// words or cache lines at a time can fill it efficiently.
+//
+//-----------------------------------------------------------
+
+// Extents of each row of the ellipse currently being filled
+static struct
+{
+    int ytop, nrows;          // y coordinate and number of rows
+    std::vector<SPAN> rows;   // leftmost and rightmost pixel of each row
+} s_fill;
+
+// Pixel function that widens the extent of row y to include pixel x
+//
+static void FillPixel(int x, int y)
+{
+    int row = y - s_fill.ytop;
+
+    if (row < 0 || row >= s_fill.nrows)
+        return;  // row is clipped, or pixel strays outside the curve's bounds
+
+    SPAN& span = s_fill.rows[row];
+    span.xl = std::min(span.xl, x);
+    span.xr = std::max(span.xr, x);
+}
+
+// Fills an ellipse, including its outline, clipped to the clip
+// rectangle set by SetClipRect. The ellipse is specified by the same
+// parameters as for the Ellipse function. Each row is filled with a
+// single call to DrawSpan, or, if a segment function is in effect
+// (see SetSegmentProc), is passed to it as a horizontal line.
+//
+void FillEllipse(int x0, int y0, int x1, int y1, int x2, int y2)
+{
+    // The parallelogram that encloses the ellipse bounds its rows.
+    // Only the rows inside the clip rectangle are kept.
+    int ybox = abs(y1 - y0) + abs(y2 - y0) + 1;
+    int ytop = std::max(y0 - ybox, g_clip[1]);
+    int ybottom = std::min(y0 + ybox, g_clip[3]);
+    SPAN empty = { INT_MAX, INT_MIN };
+    SEGMENTPROC segmentProc = g_segmentProc;
+    PIXELPROC prev;
+
+    if (ytop > ybottom)
+        return;
+    s_fill.ytop = ytop;
+    s_fill.nrows = ybottom - ytop + 1;
+    s_fill.rows.assign(s_fill.nrows, empty);
+
+    // Trace the outline a pixel at a time, even if segments are being
+    // captured
+    g_segmentProc = 0;
+    prev = SetPixelProc(FillPixel);
+    Ellipse(x0, y0, x1, y1, x2, y2);
+    SetPixelProc(prev);
+    g_segmentProc = segmentProc;
+    for (int row = 0; row < s_fill.nrows; row++)
+    {
+        const SPAN& span = s_fill.rows[row];
+        int xl = std::max(span.xl, g_clip[0]);
+        int xr = std::min(span.xr, g_clip[2]);
+        int y = s_fill.ytop + row;
+
+        if (xl > xr)
+            continue;
+        EmitSpan(xl, xr, y);
+    }
+}
+
+//-----------------------------------------------------------
+//
+// Clipped conic curves
+//
+// Hyperbolas and parabolas are unbounded, so they are always
+// clipped to the clip rectangle set by SetClipRect. So are very large
+// ellipses drawn by ClippedEllipse. Every pixel of a clipped curve
+// passes through ClipPixel, which drops the pixels that lie outside
+// the clip rectangle, so that no clipped curve draws outside it.
+//
+// Before a hyperbola or parabola is drawn, the points at which the
+// curve intersects the four sides of the clip rectangle, widened by
+// half a pixel on each side, are calculated. These points divide the
+// curve into arcs that lie alternately inside and outside the clip
+// rectangle. Pitteway's algorithm draws only the arcs that lie
+// inside, so that the cost of drawing the curve is proportional to
+// the number of visible pixels.
+//
+// To find the intersections, each curve is expressed in terms of
+// an origin O and two vectors p and q, so that a point X on the
+// curve is X = O + a*p + b*q, where
+//          a^2 - b^2 = 1    for a hyperbola
+//          b = a^2          for a parabola
+// A side of the clip rectangle is a straight line in the (a,b)
+// plane, and so intersects the curve in at most two points. The
+// points on the curve are ordered by a parameter s, which is
+// s = b for each branch of a hyperbola, and s = a for a parabola.
+// Floating-point arithmetic is used only for this setup; the arcs
+// themselves are drawn with integer arithmetic.
+//
+// An ellipse is drawn by the same walk that the Ellipse function
+// takes, pixel for pixel, so that ClippedEllipse draws exactly the
+// pixels of Ellipse that lie inside the clip rectangle. Where the
+// walk is outside the clip rectangle, it jumps ahead (see ClipSkip)
+// to just before the point at which it next might come inside, or
+// turn into its next drawing octant.
+//
+//-----------------------------------------------------------
+
+// Pi, for angles around a clipped ellipse
+const double PI_CLIP = 3.14159265358979323846;
+
+// Types of clipped conic curves
+enum { CLIP_HYPERBOLA, CLIP_PARABOLA };
+
+// Conic curve described in terms of an origin O = (x0,y0) and vectors
+// p = (xp,yp) and q = (xq,yq). Coefficients A-F specify the implicit
+// equation of the curve, with the origin at O.
+struct CLIPCONIC
+{
+    int type;
+    int x0, y0;
+    int xp, yp, xq, yq;
+    long long A, B, C, D, E;
+    double F;
+};
+
+// Point at which a curve crosses a side of the clip rectangle
+struct CLIPPOINT
+{
+    int branch;  // hyperbola branch (0 or 1); 0 for parabola
+    double s;    // position of point along branch
+};
+
+// Sets the clip rectangle used by the Hyperbola, Parabola,
+// ClippedEllipse, LodEllipse, and FillEllipse functions. Only pixels
+// with xmin <= x <= xmax and ymin <= y <= ymax are drawn. The default
+// clip rectangle is (0,0) to (32767,32767).
+//
+void SetClipRect(int xmin, int ymin, int xmax, int ymax)
+{
+    g_clip[0] = xmin;
+    g_clip[1] = ymin;
+    g_clip[2] = xmax;
+    g_clip[3] = ymax;
+}
+
+// Pixel and segment functions in effect while a clipped curve is
+// being drawn (see ClipBegin)
+static PIXELPROC s_clipPixelProc;
+static SEGMENTPROC s_clipSegmentProc;
+
+// Horizontal run of visible pixels xl to xr in row y, which is sent
+// to the segment function as a line when the run ends. The run is
+// empty if xl > xr.
+static int s_clipRun[3] = { 0, -1, 0 };
+
+// Sends the run of visible pixels collected by ClipPixel, if any, to
+// the segment function
+//
+static void ClipFlush()
+{
+    SEGMENT seg = { true, s_clipRun[0], s_clipRun[2], s_clipRun[1],
+                    s_clipRun[2], 0, 0, 0, 0, 0, 0, false, {} };
+
+    if (s_clipRun[0] > s_clipRun[1])
+        return;
+    s_clipSegmentProc(&seg);
+    s_clipRun[0] = 0;
+    s_clipRun[1] = -1;
+}
+
+// Pixel function in effect while a clipped curve is drawn. Drops the
+// pixels outside the clip rectangle, and passes the rest on to the
+// caller's pixel function. If the caller has a segment function, the
+// visible pixels are instead collected into horizontal runs, which
+// are passed on as straight-line segments.
+//
+static void ClipPixel(int x, int y)
+{
+    if (x < g_clip[0] || y < g_clip[1] || x > g_clip[2] || y > g_clip[3])
+        return;
+    if (!s_clipSegmentProc)
+    {
+        s_clipPixelProc(x, y);
+        return;
+    }
+    if (y == s_clipRun[2] && x == s_clipRun[1] + 1)
+        s_clipRun[1] = x;
+    else if (y == s_clipRun[2] && x == s_clipRun[0] - 1)
+        s_clipRun[0] = x;
+    else
+    {
+        ClipFlush();
+        s_clipRun[0] = s_clipRun[1] = x;
+        s_clipRun[2] = y;
+    }
+}
+
+// Sends the pixels drawn by Line and Conic to ClipPixel until ClipEnd
+// is called
+//
+static void ClipBegin()
+{
+    s_clipPixelProc = g_pixelProc;
+    s_clipSegmentProc = g_segmentProc;
+    g_pixelProc = ClipPixel;
+    g_segmentProc = 0;
+}
+
+// Restores the pixel and segment functions replaced by ClipBegin
+//
+static void ClipEnd()
+{
+    if (s_clipSegmentProc)
+        ClipFlush();
+    g_pixelProc = s_clipPixelProc;
+    g_segmentProc = s_clipSegmentProc;
+}
+
+// Returns the point X = O + a*p + b*q on the curve at position s on
+// the specified branch. Also returns the tangent vector dX/ds.
+//
+static void ClipCurvePoint(const CLIPCONIC& cc, int branch, double s,
+                           double *x, double *y, double *tx, double *ty)
+{
+    double a, b, dads;
+
+    if (cc.type == CLIP_HYPERBOLA)
+    {
+        b = s;
+        a = sqrt(1 + b*b);
+        dads = b/a;
+        if (branch)
+        {
+            a = -a;
+            dads = -dads;
+        }
+        *tx = dads*cc.xp + cc.xq;
+        *ty = dads*cc.yp + cc.yq;
+    }
+    else
+    {
+        a = s;
+        b = a*a;
+        *tx = cc.xp + 2*a*cc.xq;
+        *ty = cc.yp + 2*a*cc.yq;
+    }
+    *x = cc.x0 + a*cc.xp + b*cc.xq;
+    *y = cc.y0 + a*cc.yp + b*cc.yq;
+}
+
+// Returns true if point (x,y) is inside the clip rectangle, widened
+// by half a pixel on each side, so that it includes every point that
+// rounds to a pixel inside the clip rectangle
+//
+static bool InsideClip(double x, double y)
+{
+    const double eps = 1e-6;
+
+    return (g_clip[0] - 0.5 - eps <= x && x <= g_clip[2] + 0.5 + eps &&
+            g_clip[1] - 0.5 - eps <= y && y <= g_clip[3] + 0.5 + eps);
+}
+
+// Finds the points at which the curve intersects the line along which
+// one side of the widened clip rectangle lies. This line is the set
+// of points X for which X.n = c, where n = (1,0) or (0,1) is the
+// normal to the line. The intersection points that lie on the side of
+// the widened clip rectangle are added to the pts array. Returns the
+// updated number of points in this array.
+//
+static int ClipSide(const CLIPCONIC& cc, int nx, int ny, double c,
+                    CLIPPOINT pts[], int npts)
+{
+    // The line is a*(p.n) + b*(q.n) = c - O.n in the (a,b) plane.
+    // Express points on the line as (a,b) = m + t*d, where m is the
+    // point on the line closest to the origin, and d is a unit
+    // vector parallel to the line.
+    double pn = cc.xp*nx + cc.yp*ny;
+    double qn = cc.xq*nx + cc.yq*ny;
+    double len = sqrt(pn*pn + qn*qn);
+    double cn = c - (cc.x0*nx + cc.y0*ny);
+    double ma, mb, da, db, k2, k1, k0, t[2];
+    int nt = 0;
+
+    if (len == 0)
+        return npts;  // side is parallel to the curve's axis of symmetry
+    ma = pn*cn/(len*len);
+    mb = qn*cn/(len*len);
+    da = -qn/len;
+    db = pn/len;
+
+    // Substitute (a,b) = m + t*d into curve equation to obtain the
+    // quadratic equation k2*t^2 + k1*t + k0 = 0
+    if (cc.type == CLIP_HYPERBOLA)
+    {
+        k2 = da*da - db*db;
+        k1 = 2*(ma*da - mb*db);
+        k0 = ma*ma - mb*mb - 1;
+    }
+    else
+    {
+        k2 = da*da;
+        k1 = 2*ma*da - db;
+        k0 = ma*ma - mb;
+    }
+    if (fabs(k2) < 1e-12*fabs(k1))
+    {
+        // Line is parallel to an asymptote or to the axis of a parabola
+        t[nt++] = -k0/k1;
+    }
+    else if (k2 != 0)
+    {
+        double disc = k1*k1 - 4*k2*k0;
+        if (disc >= 0)
+        {
+            double root = sqrt(disc);
+            t[nt++] = (-k1 - root)/(2*k2);
+            t[nt++] = (-k1 + root)/(2*k2);
+        }
+    }
+    for (int i = 0; i < nt; i++)
+    {
+        double a = ma + t[i]*da;
+        double b = mb + t[i]*db;
+        double x = cc.x0 + a*cc.xp + b*cc.xq;
+        double y = cc.y0 + a*cc.yp + b*cc.yq;
+
+        if (!InsideClip(x, y))
+            continue;  // intersection lies outside this side of rect
+        pts[npts].branch = (cc.type == CLIP_HYPERBOLA && a < 0);
+        pts[npts].s = (cc.type == CLIP_HYPERBOLA) ? b : a;
+        npts++;
+    }
+    return npts;
+}
+
+// Rounds coordinate v to the nearest integer
+//
+static int ClipRound(double v)
+{
+    return (int)floor(v + 0.5);
+}
+
+// Largest magnitude allowed for the values of the curve equation that
+// the clipped curves calculate, so that the walk, which works with
+// four times these values, cannot overflow 64 bits
+const double CLIP_MAXVALUE = 1e18;
+
+// Checks whether the pixel at the origin of the conic with coefficients
+// A-F is one that Pitteway's algorithm could reach by walking along the
+// curve from farther back. Within a drawing octant, the walk visits the
+// pixel in each column (or row) along the octant's major axis whose
+// span along the minor axis contains the curve, which is where f
+// changes sign between the two halves of that span. Returns 0 if the
+// pixel is such a pixel. Otherwise, returns -1 or 1, and sets (mx,my)
+// to the minor-axis step, to say in which direction the pixel should
+// be moved to get closer to the curve.
+//
+static int ClipOnPath(long long A, long long B, long long C, long long D,
+                      long long E, long long F, int *mx, int *my)
+{
+    WALK<long long> w;
+    long long q, g;
+    int sign;
+
+    w.octant = Octant(D, E);
+    WalkOctant(w, 0, 0, A, B, C, D, E, F);
+    *mx = w.dxdiag - w.dxsquare;
+    *my = w.dydiag - w.dysquare;
+    sign = (w.octant & 1) ? 1 : -1;
+
+    // Four times f at half a step either way along the minor axis
+    // is 4*F -/+ g + q
+    q = A*(*mx)*(*mx) + B*(*mx)*(*my) + C*(*my)*(*my);
+    g = 2*(D*(*mx) + E*(*my));
+    if (sign*(4*F - g + q) < 0)
+        return -1;
+    if (sign*(4*F + g + q) >= 0)
+        return 1;
+    return 0;
+}
+
+// Draws the arc of the curve between positions s0 and s1 on the
+// specified branch. The coefficients of the curve equation are
+// translated to an origin at the start pixel. Pitteway's algorithm
+// always tracks a curve in the direction (-dfdy,dfdx), at right
+// angles to the gradient, which keeps the concave side of the curve
+// (where f < 0) on the left. If this direction is opposite to the
+// direction of increasing s, the arc is drawn from s1 to s0 instead.
+// The end points are the pixels nearest the ends of the arc, which
+// can lie just outside the clip rectangle; ClipPixel drops them.
+// A walk that leaves the clip rectangle by more than that has
+// missed a turn, and is finished with a line that ClipPixel clips.
+//
+static void ClipArc(const CLIPCONIC& cc, int branch, double s0, double s1)
+{
+    double x, y, tx, ty, F;
+    long long sx, sy, D, E;
+    int xs, ys, xe, ye, swap;
+    int box[4] = { g_clip[0] - 2, g_clip[1] - 2,
+                   g_clip[2] + 2, g_clip[3] + 2 };
+
+    ClipCurvePoint(cc, branch, s1, &x, &y, &tx, &ty);
+    xe = ClipRound(x);
+    ye = ClipRound(y);
+    ClipCurvePoint(cc, branch, s0, &x, &y, &tx, &ty);
+    xs = ClipRound(x);
+    ys = ClipRound(y);
+    if (xs == xe && ys == ye)
+    {
+        Line(xs, ys, xs, ys);  // arc is only one pixel long
+        return;
+    }
+    for (int i = 0; i < 2; i++)
+    {
+        // Move origin from O to the start pixel
+        sx = xs - cc.x0;
+        sy = ys - cc.y0;
+        D = 2*cc.A*sx + cc.B*sy + cc.D;
+        E = cc.B*sx + 2*cc.C*sy + cc.E;
+        if (tx*double(-E) + ty*double(D) >= 0)
+            break;
+
+        // Swap start and end points, and reverse tangent
+        swap = xs;  xs = xe;  xe = swap;
+        swap = ys;  ys = ye;  ye = swap;
+        ClipCurvePoint(cc, branch, s1, &x, &y, &tx, &ty);
+        tx = -tx;
+        ty = -ty;
+    }
+    for (int i = 0; ; i++)
+    {
+        F = (double(cc.A)*sx + double(cc.B)*sy + double(cc.D))*sx
+          + (double(cc.C)*sy + double(cc.E))*sy + cc.F;
+        if (fabs(F) > CLIP_MAXVALUE)
+            return;  // curve is too large to draw
+
+        // Move the start pixel onto the walk's path (see ClipOnPath)
+        int mx, my, step = ClipOnPath(cc.A, cc.B, cc.C, D, E,
+                                      (long long)floor(F + 0.5), &mx, &my);
+
+        if (step == 0 || i == 2)
+            break;
+        xs += step*mx;
+        ys += step*my;
+        sx = xs - cc.x0;
+        sy = ys - cc.y0;
+        D = 2*cc.A*sx + cc.B*sy + cc.D;
+        E = cc.B*sx + 2*cc.C*sy + cc.E;
+    }
+    ConicWalk(xs, ys, xe, ye, cc.A, cc.B, cc.C, D, E,
+              (long long)floor(F + 0.5), box);
+}
+
+// Orders clip points by branch, and then by position along branch
+//
+static bool CompareClipPoints(const CLIPPOINT& a, const CLIPPOINT& b)
+{
+    return (a.branch != b.branch) ? (a.branch < b.branch) : (a.s < b.s);
+}
+
+// Draws the parts of a hyperbola or parabola that lie inside the clip
+// rectangle
+//
+static void ClipConic(const CLIPCONIC& cc)
+{
+    CLIPPOINT pts[8];
+    int npts = 0;
+
+    npts = ClipSide(cc, 1, 0, g_clip[0] - 0.5, pts, npts);
+    npts = ClipSide(cc, 1, 0, g_clip[2] + 0.5, pts, npts);
+    npts = ClipSide(cc, 0, 1, g_clip[1] - 0.5, pts, npts);
+    npts = ClipSide(cc, 0, 1, g_clip[3] + 0.5, pts, npts);
+    for (int i = 1; i < npts; i++)
+    {
+        // Insertion sort, since there are at most eight points
+        for (int j = i; j > 0 && CompareClipPoints(pts[j], pts[j-1]); j--)
+            std::swap(pts[j], pts[j-1]);
+    }
+
+    // Each arc between two consecutive intersection points on the
+    // same branch lies either entirely inside or entirely outside
+    // the clip rectangle. The arcs before the first intersection
+    // and after the last extend to infinity, and so lie outside.
+    for (int i = 1; i < npts; i++)
+    {
+        double x, y, tx, ty, s;
+
+        if (pts[i].branch != pts[i-1].branch || pts[i].s == pts[i-1].s)
+            continue;
+        s = (pts[i-1].s + pts[i].s)/2;
+        ClipCurvePoint(cc, pts[i].branch, s, &x, &y, &tx, &ty);
+        if (InsideClip(x, y))
+            ClipArc(cc, pts[i].branch, pts[i-1].s, pts[i].s);
+    }
+}
+
+// Draws the straight line through point (x0,y0) in direction (dx,dy),
+// clipped to the clip rectangle. The line consists of the points
+// (x0,y0) + t*(dx,dy) for which t0 <= t <= t1. Used to draw degenerate
+// curves.
+//
+static void ClipLine(int x0, int y0, int dx, int dy, double t0, double t1)
+{
+    double d[2] = { double(dx), double(dy) };
+    int p[2] = { x0, y0 };
+
+    if (dx == 0 && dy == 0)
+        return;
+    for (int i = 0; i < 2; i++)
+    {
+        double lo, hi;
+
+        if (d[i] == 0)
+        {
+            if (p[i] < g_clip[i] || p[i] > g_clip[i+2])
+                return;
+            continue;
+        }
+        lo = (g_clip[i] - 0.5 - p[i])/d[i];
+        hi = (g_clip[i+2] + 0.5 - p[i])/d[i];
+        if (lo > hi)
+        {
+            double swap = lo; lo = hi; hi = swap;
+        }
+        t0 = std::max(t0, lo);
+        t1 = std::min(t1, hi);
+    }
+    if (t0 > t1)
+        return;
+    Line(ClipRound(x0 + t0*dx), ClipRound(y0 + t0*dy),
+         ClipRound(x0 + t1*dx), ClipRound(y0 + t1*dy));
+}
+
+// Draws both branches of a hyperbola, clipped to the clip rectangle.
+// The hyperbola is specified in the same way as an ellipse is for the
+// Ellipse function: by its center point P0 = (x0,y0) and the end
+// points P1 = (x1,y1) and P2 = (x2,y2) of a pair of conjugate
+// diameters. In terms of the parallelogram defined by these points,
+// the hyperbola touches the parallelogram at P1 and at the point
+// opposite P1, where it is tangent to the sides of the parallelogram,
+// and the diagonals of the parallelogram are the asymptotes of the
+// hyperbola.
+//
+void Hyperbola(int x0, int y0, int x1, int y1, int x2, int y2)
+{
+    CLIPCONIC cc;
+    long long xp, yp, xq, yq, xprod;
+
+    xp = x1 - x0;
+    yp = y1 - y0;
+    xq = x2 - x0;
+    yq = y2 - y0;
+    xprod = xp*yq - xq*yp;
+    ClipBegin();
+    if (xprod == 0)
+    {
+        // Draw degenerate hyperbola as a straight line
+        ClipLine(x0, y0, (xp) ? xp : xq, (xp) ? yp : yq, -1e300, 1e300);
+        ClipEnd();
+        return;
+    }
+
+    // Equation is (p x X)^2 - (X x q)^2 + (p x q)^2 = 0, which is
+    // negative on the concave side of each branch
+    cc.type = CLIP_HYPERBOLA;
+    cc.x0 = x0;   cc.y0 = y0;
+    cc.xp = xp;   cc.yp = yp;
+    cc.xq = xq;   cc.yq = yq;
+    cc.A =  yp*yp - yq*yq;
+    cc.B =  2*(xq*yq - xp*yp);
+    cc.C =  xp*xp - xq*xq;
+    cc.D =  0;
+    cc.E =  0;
+    cc.F =  double(xprod)*double(xprod);
+    ClipConic(cc);
+    ClipEnd();
+}
+
+// Ellipse with center O = (x0,y0) and conjugate radii p = (xp,yp)
+// and q = (xq,yq), where p x q > 0. Coefficients A-C and F specify
+// the implicit equation of the ellipse, with the origin at O (D and
+// E are zero there). The ellipse lies within xr pixels of O in x,
+// and yr pixels in y.
+struct CLIPELLIPSE
+{
+    int x0, y0;
+    long long xp, yp, xq, yq;
+    long long A, B, C, F;
+    int xr, yr;
+};
+
+// Returns four times the value of the ellipse equation at the point
+// (x2/2,y2/2), whose coordinates are given in half pixels relative to
+// the center of the ellipse
+//
+static long long ClipValue(const CLIPELLIPSE& ce, long long x2,
+                           long long y2)
+{
+    return (ce.A*x2 + ce.B*y2)*x2 + ce.C*y2*y2 + 4*ce.F;
+}
+
+// Number of pixels short of the next point found by ClipSkip at which
+// a skip lands, to allow for the error in that point's position, and
+// for the walk turning into its next octant a pixel or two early
+const int CLIP_SKIPMARGIN = 4;
+
+// Fewest pixels that ClipSkip skips. A walk that cannot skip more
+// than this many pixels walks them instead.
+const int CLIP_MINSKIP = 8;
+
+// Least distance, in pixels along the minor axis, between the two
+// points at which the ellipse crosses a column (or row) that ClipSkip
+// skips
+const double CLIP_MINWIDTH = 4.0;
+
+// Angles along the ellipse of the points at which the ellipse crosses
+// the line X.n = c, which are added to the angles array. The angle t
+// is that of the point O + cos(t)*p + sin(t)*q. Returns the updated
+// number of angles in the array.
+//
+static int ClipCrossings(const CLIPELLIPSE& ce, int nx, int ny, double c,
+                         double angles[], int n)
+{
+    double pn = double(ce.xp*nx + ce.yp*ny);
+    double qn = double(ce.xq*nx + ce.yq*ny);
+    double r = sqrt(pn*pn + qn*qn);
+    double cn = c - (ce.x0*nx + ce.y0*ny);
+    double phi, dt;
+
+    if (r == 0 || fabs(cn) > r)
+        return n;
+    phi = atan2(qn, pn);
+    dt = acos(cn/r);
+    angles[n++] = phi - dt;
+    angles[n++] = phi + dt;
+    return n;
+}
+
+// Moves walk w, which is at a pixel outside the clip rectangle, ahead
+// along the ellipse, to the pixel that it would reach a few pixels
+// before either of the next points at which the ellipse crosses a
+// side of the clip rectangle (widened by half a pixel), or turns into
+// the next drawing octant. Every pixel skipped is outside the clip
+// rectangle, and within the walk's current octant. There, the pixel
+// in each column (or row) along the octant's major axis is the one
+// whose span along the minor axis contains the curve, so it is found
+// directly, and the walk is moved to it with WalkOctant. A walk that
+// is not on its curve, or that would not get far, is left where it
+// is. Returns true if the walk was moved.
+//
+static bool ClipSkip(WALK<long long>& w, const CLIPELLIPSE& ce)
+{
+    WALK<long long> to = w;
+    double angles[24], a, b, t0, dir, xt, yt, dt;
+    double ux, uy, vx, vy, qa, qb, qc, disc, root, best = 1e300;
+    long long x, y, mx, my, k, j, D, E, F;
+    int n = 0, octant, sign = (w.octant & 1) ? 1 : -1;
+
+    // The walk takes square steps (x,y) along the major axis, and
+    // steps (mx,my) along the minor axis. It must be on its curve: f
+    // changes sign, with the sign given by the octant, between the
+    // two halves of the pixel along the minor axis.
+    x = w.x - ce.x0;
+    y = w.y - ce.y0;
+    mx = w.dxdiag - w.dxsquare;
+    my = w.dydiag - w.dysquare;
+    if (x < -ce.xr || x > ce.xr || y < -ce.yr || y > ce.yr)
+        return false;
+    if (sign*ClipValue(ce, 2*x - mx, 2*y - my) < 0 ||
+        sign*ClipValue(ce, 2*x + mx, 2*y + my) >= 0)
+        return false;
+    octant = ((w.octant - 1) & 7) + 1;  // w.octant counts past 8
+    if (Octant(2*ce.A*x + ce.B*y, ce.B*x + 2*ce.C*y) != octant)
+        return false;
+
+    // Find the angle t0 of the walk's position on the ellipse, whose
+    // points are O + cos(t)*p + sin(t)*q, and the direction in which
+    // the walk moves the angle
+    a = double(x*ce.yq - y*ce.xq);
+    b = double(ce.xp*y - ce.yp*x);
+    t0 = atan2(b, a);
+    dir = (-sin(t0)*ce.xp + cos(t0)*ce.xq)*w.dxsquare +
+          (-sin(t0)*ce.yp + cos(t0)*ce.yq)*w.dysquare;
+    dir = (dir < 0) ? -1 : 1;
+
+    // The next octant begins where the tangent, -sin(t)*p + cos(t)*q,
+    // is horizontal, vertical, or diagonal. The ellipse comes inside
+    // the clip rectangle only after crossing one of its sides.
+    for (int i = 0; i < 4; i++)
+    {
+        static const int nrm[4][2] = { { 1, 0 }, { 0, 1 },
+                                       { 1, 1 }, { 1, -1 } };
+        double pn = double(ce.xp*nrm[i][0] + ce.yp*nrm[i][1]);
+        double qn = double(ce.xq*nrm[i][0] + ce.yq*nrm[i][1]);
+
+        angles[n++] = atan2(qn, pn);
+        angles[n++] = atan2(qn, pn) + PI_CLIP;
+    }
+    n = ClipCrossings(ce, 1, 0, g_clip[0] - 0.5, angles, n);
+    n = ClipCrossings(ce, 1, 0, g_clip[2] + 0.5, angles, n);
+    n = ClipCrossings(ce, 0, 1, g_clip[1] - 0.5, angles, n);
+    n = ClipCrossings(ce, 0, 1, g_clip[3] + 0.5, angles, n);
+    for (int i = 0; i < n; i++)
+    {
+        dt = fmod(dir*(angles[i] - t0), 2*PI_CLIP);
+        if (dt <= 0)
+            dt += 2*PI_CLIP;
+        best = std::min(best, dt);
+    }
+
+    // Count the square steps to that point, less a margin
+    dt = t0 + dir*best;
+    xt = ce.x0 + cos(dt)*ce.xp + sin(dt)*ce.xq;
+    yt = ce.y0 + cos(dt)*ce.yp + sin(dt)*ce.yq;
+    dt = (w.dxsquare) ? (xt - w.x)*w.dxsquare : (yt - w.y)*w.dysquare;
+    if (!(dt < INT_MAX/2))
+        return false;
+    k = (long long)floor(dt) - CLIP_SKIPMARGIN;
+    if (k < CLIP_MINSKIP || k >= w.stepsLeft ||
+        (w.pixelCount > 0 && k >= w.pixelCount))
+        return false;
+
+    // Solve for the distance j along the minor axis at which the
+    // ellipse crosses the column (or row) k steps ahead. Of the two
+    // crossings, the walk follows the one at which f changes sign
+    // the same way as at the walk's pixel. Where the other crossing
+    // is near, the walk can cut across to it, as it does at the ends
+    // of a thin ellipse, so the crossings must be CLIP_MINWIDTH apart
+    // both here and at the walk's pixel. The distance between them
+    // is a concave function of the column, and so they are at least
+    // that far apart in every column in between.
+    vx = double(mx);
+    vy = double(my);
+    qa = ce.A*vx*vx + ce.B*vx*vy + ce.C*vy*vy;
+    for (int i = 0; i < 2; i++)
+    {
+        ux = double(x + i*k*w.dxsquare);
+        uy = double(y + i*k*w.dysquare);
+        qb = 2*ce.A*ux*vx + ce.B*(ux*vy + uy*vx) + 2*ce.C*uy*vy;
+        qc = ce.A*ux*ux + ce.B*ux*uy + ce.C*uy*uy + double(ce.F);
+        disc = qb*qb - 4*qa*qc;
+        if (qa <= 0 || disc < 0 || sqrt(disc) < CLIP_MINWIDTH*qa)
+            return false;
+    }
+    root = (sign > 0) ? (-qb - sqrt(disc))/(2*qa) :
+                        (-qb + sqrt(disc))/(2*qa);
+    if (!(root > -1 && root < k + 1))
+        return false;
+
+    // Find the pixel exactly, with the same test as above
+    j = (long long)floor(root + 0.5);
+    x += k*w.dxsquare;
+    y += k*w.dysquare;
+    for (int i = 0; ; i++)
+    {
+        if (i == 4 || j < 0 || j > k)
+            return false;
+        if (sign*ClipValue(ce, 2*(x + j*mx) - mx, 2*(y + j*my) - my) < 0)
+            j--;
+        else if (sign*ClipValue(ce, 2*(x + j*mx) + mx,
+                                2*(y + j*my) + my) >= 0)
+            j++;
+        else
+            break;
+    }
+    x += j*mx;
+    y += j*my;
+
+    // The pixels skipped lie between the two pixels, since the curve
+    // moves steadily along both axes within an octant
+    if (std::max(w.x, int(ce.x0 + x)) >= g_clip[0] &&
+        std::min(w.x, int(ce.x0 + x)) <= g_clip[2] &&
+        std::max(w.y, int(ce.y0 + y)) >= g_clip[1] &&
+        std::min(w.y, int(ce.y0 + y)) <= g_clip[3])
+        return false;
+
+    // Move the walk, if the new pixel is still within its octant
+    D = 2*ce.A*x + ce.B*y;
+    E = ce.B*x + 2*ce.C*y;
+    F = (ce.A*x + ce.B*y)*x + ce.C*y*y + ce.F;
+    if (Octant(D, E) != octant)
+        return false;
+    WalkOctant(to, int(ce.x0 + x), int(ce.y0 + y), ce.A, ce.B, ce.C,
+               D, E, F);
+    if (!WalkInOctant(to))
+        return false;
+    to.stepsLeft -= (int)k - 1;
+    to.pixelCount = -1;
+    WalkCount(to);
+    w = to;
+    return true;
+}
+
+// Draws the ellipse ce, as Ellipse does, but only its pixels that lie
+// inside the clip rectangle. This function is ConicWalk, specialized
+// for a full ellipse that starts at O + p, where f = 0, except that
+// where the walk is outside the clip rectangle, it skips ahead with
+// ClipSkip. Pixels are sent to ClipPixel, which drops any pixels
+// that remain outside the clip rectangle.
+//
+static void ClipWalk(const CLIPELLIPSE& ce)
+{
+    WALK<long long> w;
+    SEGMENT seg;
+    int xs = int(ce.x0 + ce.xp), ys = int(ce.y0 + ce.yp);
+    long long D = 2*ce.A*ce.xp + ce.B*ce.yp;
+    long long E = ce.B*ce.xp + 2*ce.C*ce.yp;
+    int wait = 0;  // pixels to walk before trying to skip again
+
+    WalkStart(w, xs, ys, xs, ys, ce.A, ce.B, ce.C, D, E, 0LL);
+    WalkLimit(w, xs, ys, ce.A, ce.B, ce.C, D, E, 0LL, (int*)0);
+    for (;;)
+    {
+        while (WalkInOctant(w))
+        {
+            if (--w.stepsLeft < 0)
+            {
+                // Ran away
+                ConicSegment(&seg, xs, ys, xs, ys, ce.A, ce.B, ce.C, D, E,
+                             0LL, (int*)0);
+                WalkStopped(seg, w.x, w.y, true);
+                Line(w.x, w.y, xs, ys);
+                return;
+            }
+            if ((w.x < g_clip[0] || w.y < g_clip[1] ||
+                 w.x > g_clip[2] || w.y > g_clip[3]) && --wait < 0)
+            {
+                if (ClipSkip(w, ce))
+                    continue;
+                wait = CLIP_SKIPMARGIN;
+            }
+            g_pixelProc(w.x, w.y);
+            if (--w.pixelCount == 0)
+                return;  // we drew all pixels in final octant
+
+            WalkStep(w);
+        }
+
+        // Cross boundary into next drawing octant
+        if (--w.octantCount < 0)
+        {
+            // Oops -- failed to draw all pixels in final octant
+            ConicSegment(&seg, xs, ys, xs, ys, ce.A, ce.B, ce.C, D, E,
+                         0LL, (int*)0);
+            WalkStopped(seg, w.x, w.y, false);
+            Line(w.x, w.y, xs, ys);  // draw line to end point
+            return;
+        }
+        WalkTurn(w);
+    }
+}
+
+// Draws an ellipse, clipped to the clip rectangle. The ellipse is
+// specified in the same way as for the Ellipse function, and the
+// pixels drawn are exactly those of Ellipse that lie inside the clip
+// rectangle. Only the arcs that lie inside the clip rectangle are
+// traced, and the curve equation uses 64-bit coefficients, so this
+// function can draw an ellipse that is much larger than the clip
+// rectangle. An ellipse so large (about 25000 pixels in radius) that
+// the values of its equation would not fit in 64 bits is not drawn.
+//
+void ClippedEllipse(int x0, int y0, int x1, int y1, int x2, int y2)
+{
+    CLIPELLIPSE ce;
+    long long xp, yp, xq, yq, xprod;
+    double xr, yr, r, size;
+
+    xp = x1 - x0;
+    yp = y1 - y0;
+    xq = x2 - x0;
+    yq = y2 - y0;
+    xprod = xp*yq - xq*yp;
+
+    // Skip an ellipse that is too large to draw. Its half-width and
+    // half-height are xr and yr.
+    xr = sqrt(double(xp*xp + xq*xq));
+    yr = sqrt(double(yp*yp + yq*yq));
+    r = 2*std::max(xr, yr) + 3;
+    size = (double(yp*yp + yq*yq) + 2*fabs(double(xp*yp + xq*yq))
+            + double(xp*xp + xq*xq))*r*r + 4*double(xprod)*double(xprod);
+    if (size > CLIP_MAXVALUE)
+        return;
+
+    ClipBegin();
+    if (xprod == 0)
+    {
+        // Draw degenerate ellipse as a straight line
+        int x, y;
+
+        DegenerateEllipse(xp, yp, xq, yq, &x, &y);
+        Line(x0+x, y0+y, x0-x, y0-y);
+        ClipEnd();
+        return;
+    }
+    if (xprod < 0)
+    {
+        std::swap(xp, xq);
+        std::swap(yp, yq);
+        xprod = -xprod;
+    }
+
+    // Equation is (p x X)^2 + (X x q)^2 - (p x q)^2 = 0, which is
+    // negative inside the ellipse
+    ce.x0 = x0;   ce.y0 = y0;
+    ce.xp = xp;   ce.yp = yp;
+    ce.xq = xq;   ce.yq = yq;
+    ce.A =  yp*yp + yq*yq;
+    ce.B = -2*(xp*yp + xq*yq);
+    ce.C =  xp*xp + xq*xq;
+    ce.F = -xprod*xprod;
+    ce.xr = (int)ceil(xr) + 1;
+    ce.yr = (int)ceil(yr) + 1;
+    ClipWalk(ce);
+    ClipEnd();
+}
+
+// Draws a parabola, clipped to the clip rectangle. The parabola is
+// specified in the same way as a parabolic spline is for the
+// ParabolicSpline function: it passes through points Ps = (xs,ys)
+// and Pe = (xe,ye), where it is tangent to lines Ps.Pc and Pe.Pc,
+// and Pc = (xc,yc) is the point at which these tangents intersect.
+// Unlike ParabolicSpline, which draws only the arc between Ps and
+// Pe, this function draws the parabola to the edges of the clip
+// rectangle.
+//
+void Parabola(int xs, int ys, int xc, int yc, int xe, int ye)
+{
+    CLIPCONIC cc;
+    long long xp, yp, xq, yq, xprod;
+
+    // Parabolic spline is X(t) = Ps + t*p + t^2*q, 0 <= t <= 1
+    xp = 2*(xc - xs);
+    yp = 2*(yc - ys);
+    xq = xs - 2*xc + xe;
+    yq = ys - 2*yc + ye;
+    xprod = xp*yq - xq*yp;
+    ClipBegin();
+    if (xprod == 0)
+    {
+        // Draw degenerate parabola as a straight line
+        ClipLine(xs, ys, (xp) ? xp : xq, (xp) ? yp : yq, -1e300, 1e300);
+        ClipEnd();
+        return;
+    }
+
+    // Equation is (X x q)^2 - (p x X)*(p x q) = 0, which is negative
+    // on the concave side of the parabola
+    cc.type = CLIP_PARABOLA;
+    cc.x0 = xs;   cc.y0 = ys;
+    cc.xp = xp;   cc.yp = yp;
+    cc.xq = xq;   cc.yq = yq;
+    cc.A =  yq*yq;
+    cc.B = -2*xq*yq;
+    cc.C =  xq*xq;
+    cc.D =  yp*xprod;
+    cc.E = -xp*xprod;
+    cc.F =  0;
+    ClipConic(cc);
+    ClipEnd();
+}
+
+//-----------------------------------------------------------
+//
+// Spline chains
+//
+//-----------------------------------------------------------
+
+// Number of pixels drawn most recently that PolySpline remembers, so
+// that it does not draw them again
+const int POLY_HISTORY = 8;
+
+// Pixels collected from the spline currently being drawn
+static std::vector<XYVAL> s_polyPixels;
+
+// Pixel function that collects the pixels drawn by a spline
+//
+static void PolyPixel(int x, int y)
+{
+    XYVAL xy = { x, y };
+
+    s_polyPixels.push_back(xy);
+}
+
+// Segments collected from the spline currently being drawn, if a
+// segment function is in effect
+static std::vector<SEGMENT> s_polySegs;
+
+// Segment function that collects the segments of a spline
+//
+static void PolySegment(const SEGMENT *seg)
+{
+    s_polySegs.push_back(*seg);
+}
+
+// Pixels sent most recently to the pixel function, oldest first
+static XYVAL s_polyHistory[POLY_HISTORY];
+static int s_polyCount;
+
+// Horizontal run of pixels from (x0,y) to (x1,y), kept by PolyEmit
+// but not yet passed to the segment function. Step is the direction
+// of the run, +1 or -1, or 0 if it has only one pixel.
+static struct
+{
+    bool open;
+    int x0, x1, y, step;
+} s_polyRun;
+
+// Passes the run of pixels kept by PolyEmit to the segment function
+// as a horizontal line, which draws them in the same order
+//
+static void PolyFlush()
+{
+    if (s_polyRun.open)
+        Line(s_polyRun.x0, s_polyRun.y, s_polyRun.x1, s_polyRun.y);
+    s_polyRun.open = false;
+}
+
+// Sends pixel (x,y) to the pixel function, unless it repeats one of
+// the pixels sent most recently. A repeated pixel is dropped, but the
+// pixels sent after it are kept, so that the tip of a spline that
+// turns back on itself at a knot is still drawn. If a segment function
+// is in effect, the pixels that are kept are collected instead into
+// horizontal runs for PolyFlush.
+//
+static void PolyEmit(int x, int y)
+{
+    int k;
+
+    for (k = s_polyCount - 1; k >= 0; k--)
+    {
+        if (s_polyHistory[k].x == x && s_polyHistory[k].y == y)
+            return;
+    }
+    if (s_polyCount == POLY_HISTORY)
+    {
+        for (k = 1; k < POLY_HISTORY; k++)
+            s_polyHistory[k-1] = s_polyHistory[k];
+        s_polyCount--;
+    }
+    s_polyHistory[s_polyCount].x = x;
+    s_polyHistory[s_polyCount].y = y;
+    s_polyCount++;
+    if (!g_segmentProc)
+    {
+        g_pixelProc(x, y);
+        return;
+    }
+    if (s_polyRun.open && y == s_polyRun.y && abs(x - s_polyRun.x1) == 1 &&
+        x - s_polyRun.x1 != -s_polyRun.step)
+    {
+        s_polyRun.step = x - s_polyRun.x1;
+        s_polyRun.x1 = x;
+        return;
+    }
+    PolyFlush();
+    s_polyRun.open = true;
+    s_polyRun.x0 = s_polyRun.x1 = x;
+    s_polyRun.y = y;
+    s_polyRun.step = 0;
+}
+
+// Draws a chain of connected splines as a single stream of pixels.
+// Array pt contains the knots and control points of the splines, in
+// order: pt[0] is the start point of the first spline, and pt[2*i],
+// pt[2*i+1], and pt[2*i+2] are the start point, control point, and
+// end point of the ith spline. Argument npts is the number of points
+// in the array, and is odd. Function spline draws each spline. For
+// example, if spline is ParabolicSplineFx, the points are specified
+// in fixed-point format.
+//
+// A spline function might draw a spline from end point to start
+// point (when the triangle Ps.Pc.Pe has clockwise orientation), but
+// this function always sends the pixels to the pixel function in
+// order from the first spline to the last. The knot shared by two
+// splines is drawn only once. Where a spline doubles back over the
+// last few pixels drawn (for example, where the next spline leaves a
+// knot along the way the previous one came in), the repeated pixels
+// are dropped, and the pixels before them, including the knot, are
+// kept.
+//
+// If a segment function is in effect (see SetSegmentProc), the
+// segments of each spline are collected and stepped through with a
+// ConicIter, and the pixels that are kept are passed to the segment
+// function as horizontal lines, one for each run of pixels in a row.
+// The captured chain therefore draws the same pixels, in the same
+// order, as the chain drawn directly.
+//
+void PolySpline(SPLINEPROC spline, const XYVAL pt[], int npts)
+{
+    PIXELPROC prev = g_pixelProc;
+    SEGMENTPROC segmentProc = g_segmentProc;
+
+    s_polyCount = 0;
+    s_polyRun.open = false;
+    for (int i = 2; i < npts; i += 2)
+    {
+        const XYVAL& ps = pt[i-2];
+        const XYVAL& pc = pt[i-1];
+        const XYVAL& pe = pt[i];
+        long long xprod;
+        int n, step;
+
+        s_polyPixels.clear();
+        if (segmentProc)
+        {
+            XYVAL xy;
+
+            s_polySegs.clear();
+            g_segmentProc = PolySegment;
+            spline(ps.x, ps.y, pc.x, pc.y, pe.x, pe.y);
+            g_segmentProc = segmentProc;
+            for (size_t k = 0; k < s_polySegs.size(); k++)
+            {
+                ConicIter iter;
+
+                iter.Start(s_polySegs[k]);
+                while (iter.Next(&xy.x, &xy.y))
+                    s_polyPixels.push_back(xy);
+            }
+        }
+        else
+        {
+            g_pixelProc = PolyPixel;
+            spline(ps.x, ps.y, pc.x, pc.y, pe.x, pe.y);
+            g_pixelProc = prev;
+        }
+
+        // The spline functions swap Ps and Pe if (Pc - Ps) x (Pe - Pc)
+        // is negative, so draw their pixels in reverse order
+        xprod = (long long)(pc.x - ps.x)*(pe.y - pc.y)
+              - (long long)(pc.y - ps.y)*(pe.x - pc.x);
+        n = s_polyPixels.size();
+        step = (xprod < 0) ? -1 : 1;
+        for (int j = (xprod < 0) ? n - 1 : 0; 0 <= j && j < n; j += step)
+            PolyEmit(s_polyPixels[j].x, s_polyPixels[j].y);
+    }
+    PolyFlush();
+    s_polyCount = 0;
+}
+
+//-----------------------------------------------------------
+//
+// Integer ellipse geometry
+//
+// These functions calculate the bounding box, the 8-sided bounding
+// polygon, the inscribed 8-sided polygon, and the major and minor
+// axes of an ellipse that is specified by its center point P0 and
+// the end points P1 and P2 of a pair of conjugate diameters, as for
+// the Ellipse function. The calculations use only integer arithmetic,
+// and each result is rounded to the nearest integer. The results are
+// exact (before rounding) if P1 and P2 are within 16383 pixels of P0
+// in x and y.
+//
+//-----------------------------------------------------------
+
+// Returns floor(sqrt(n)) for 0 <= n < 2^62
+//
+static long long FloorSqrt(long long n)
+{
+    long long root = 0;
+    long long bit = 1LL << 60;
+
+    while (bit > n)
+        bit >>= 2;
+    while (bit != 0)
+    {
+        if (n >= root + bit)
+        {
+            n -= root + bit;
+            root = (root >> 1) + bit;
+        }
+        else
+            root >>= 1;
+        bit >>= 2;
+    }
+    return root;
+}
+
+// Returns sqrt(n/d), rounded to the nearest integer, for n >= 0 and
+// d > 0
+//
+static long long SqrtRatio(long long n, long long d)
+{
+    long long r = FloorSqrt(n/d);
+
+    // Round up if n/d >= (r + 1/2)^2
+    return (4*(n - (r*r + r)*d) >= d) ? r + 1 : r;
+}
+
+// Returns n/sqrt(d), rounded to the nearest integer, for d > 0
+//
+static int DivSqrt(long long n, long long d)
+{
+    int q = SqrtRatio(n*n, d);
+
+    return (n < 0) ? -q : q;
+}
+
+// Returns the square root of n, rounded to the nearest integer, for
+// 0 <= n < 2^61
+//
+int ISqrt(long long n)
+{
+    return SqrtRatio(n, 1);
+}
+
+// Calculates the minimum bounding box for an ellipse. The box is
+// returned in array box as {xmin, ymin, xmax, ymax}, the same order
+// used by SetClipRect.
+//
+void EllipseBox(int x0, int y0, int x1, int y1, int x2, int y2, int box[4])
+{
+    long long xp = x1 - x0, yp = y1 - y0;
+    long long xq = x2 - x0, yq = y2 - y0;
+    int xbox = ISqrt(xp*xp + xq*xq);
+    int ybox = ISqrt(yp*yp + yq*yq);
+
+    box[0] = x0 - xbox;
+    box[1] = y0 - ybox;
+    box[2] = x0 + xbox;
+    box[3] = y0 + ybox;
+}
+
+// Calculates the 8-sided bounding polygon for an ellipse. Two opposing
+// sides of the polygon are vertical, two are horizontal, two are
+// +45-degree diagonals, and two are -45-degree diagonals. Each side
+// touches the ellipse at exactly one point, at which the side is
+// tangent to the ellipse. The vertices are returned in array pgon.
+//
+void EllipsePgon(int x0, int y0, int x1, int y1, int x2, int y2,
+                 XYVAL pgon[8])
+{
+    long long xp = x1 - x0, yp = y1 - y0;
+    long long xq = x2 - x0, yq = y2 - y0;
+    int X = ISqrt(xp*xp + xq*xq);
+    int Y = ISqrt(yp*yp + yq*yq);
+    int Z = ISqrt((xp + yp)*(xp + yp) + (xq + yq)*(xq + yq));
+    int W = ISqrt((xp - yp)*(xp - yp) + (xq - yq)*(xq - yq));
+
+    pgon[0].x = x0 + X;      pgon[0].y = y0 - X + Z;
+    pgon[1].x = x0 - Y + Z;  pgon[1].y = y0 + Y;
+    pgon[2].x = x0 + Y - W;  pgon[2].y = y0 + Y;
+    pgon[3].x = x0 - X;      pgon[3].y = y0 - X + W;
+    pgon[4].x = x0 - X;      pgon[4].y = y0 + X - Z;
+    pgon[5].x = x0 + Y - Z;  pgon[5].y = y0 - Y;
+    pgon[6].x = x0 - Y + W;  pgon[6].y = y0 - Y;
+    pgon[7].x = x0 + X;      pgon[7].y = y0 + X - W;
+}
+
+// Calculates the 8-sided polygon inscribed in an ellipse. Each vertex
+// is a point at which the drawing octant changes in Pitteway's
+// algorithm, which is also the point at which a side of the bounding
+// polygon calculated by EllipsePgon touches the ellipse. The vertices
+// are returned in array pgon. Returns false, and leaves pgon unchanged,
+// if the ellipse is degenerate.
+//
+bool EllipseInscribedPgon(int x0, int y0, int x1, int y1, int x2, int y2,
+                          XYVAL pgon[8])
+{
+    long long xp = x1 - x0, yp = y1 - y0;
+    long long xq = x2 - x0, yq = y2 - y0;
+    long long XX = xp*xp + xq*xq;
+    long long YY = yp*yp + yq*yq;
+    long long ZZ = (xp + yp)*(xp + yp) + (xq + yq)*(xq + yq);
+    long long WW = (xp - yp)*(xp - yp) + (xq - yq)*(xq - yq);
+    long long T, U, V;
+
+    if (XX == 0 || YY == 0 || ZZ == 0 || WW == 0)
+        return false;  // degenerate ellipse
+
+    // The tangent points are (X, T/X), (U/Z, (Z^2 - U)/Z),
+    // (T/Y, Y), and (-V/W, (W^2 - V)/W), and their reflections
+    // through the center
+    T = xp*yp + xq*yq;
+    U = xp*(xp + yp) + xq*(xq + yq);
+    V = xp*(xp - yp) + xq*(xq - yq);
+    pgon[0].x = ISqrt(XX);        pgon[0].y = DivSqrt(T, XX);
+    pgon[1].x = DivSqrt(U, ZZ);   pgon[1].y = DivSqrt(ZZ - U, ZZ);
+    pgon[2].x = DivSqrt(T, YY);   pgon[2].y = ISqrt(YY);
+    pgon[3].x = -DivSqrt(V, WW);  pgon[3].y = DivSqrt(WW - V, WW);
+    for (int i = 0; i < 4; i++)
+    {
+        pgon[i+4].x = x0 - pgon[i].x;
+        pgon[i+4].y = y0 - pgon[i].y;
+        pgon[i].x += x0;
+        pgon[i].y += y0;
+    }
+    return true;
+}
+
+// Calculates the major and minor axes of an ellipse. The end points
+// of the major axis are returned in axes[0] and axes[1], and the end
+// points of the minor axis in axes[2] and axes[3]. Returns false, and
+// leaves axes unchanged, if the ellipse is a circle (in which case
+// the axes are not unique) or is degenerate.
+//
+bool EllipseAxes(int x0, int y0, int x1, int y1, int x2, int y2,
+                 XYVAL axes[4])
+{
+    long long xp = x1 - x0, yp = y1 - y0;
+    long long xq = x2 - x0, yq = y2 - y0;
+    long long A = yp*yp + yq*yq;
+    long long C = xp*xp + xq*xq;
+    long long T = xp*yp + xq*yq;
+    long long R, S, major, minor;
+    int x, y, shift = 0;
+
+    if (xp*yq == xq*yp)
+        return false;  // area of ellipse is zero
+
+    // The axes point along the eigenvectors of the matrix [C T; T A].
+    // The squared lengths of the semi-axes are the eigenvalues,
+    // (C + A + R)/2 and (C + A - R)/2, where R is calculated below.
+    // For a thin ellipse, C + A - R suffers from cancellation, so R is
+    // calculated with as many fraction bits as will fit, and all the
+    // other values are scaled up to match.
+    while (((C + A) << shift) < (1LL << 29))
+        shift++;
+    R = ISqrt(((C - A)*(C - A) + 4*T*T) << 2*shift);
+    if (R == 0)
+        return false;  // circle
+    S = (C + A) << shift;
+    C <<= shift;
+    A <<= shift;
+    major = S + R;
+    minor = S - R;
+    x = SqrtRatio(major*(R + C - A), (4*R) << shift);
+    y = SqrtRatio(major*(R + A - C), (4*R) << shift);
+    if (T < 0)
+        x = -x;
+    axes[0].x = x0 + x;  axes[0].y = y0 + y;
+    axes[1].x = x0 - x;  axes[1].y = y0 - y;
+    x = SqrtRatio(minor*(R + A - C), (4*R) << shift);
+    y = SqrtRatio(minor*(R + C - A), (4*R) << shift);
+    if (T > 0)
+        x = -x;
+    axes[2].x = x0 + x;  axes[2].y = y0 + y;
+    axes[3].x = x0 - x;  axes[3].y = y0 - y;
+    return true;
+}
+
+// Calculates the coefficients of the implicit equation
+//      f(x,y) = A*x^2 + B*x*y + C*y^2 + D*x + E*y + F = 0
+// of an ellipse, with the origin at the center point P0. Coefficients
+// A, B, and C are the same ones that the Ellipse function passes to
+// Conic; Ellipse places the origin at P1 instead, which changes only
+// D, E, and F. The coefficients are returned in array coef, in order.
+// f(x,y) is negative inside the ellipse and positive outside.
+//
+void EllipseCoefficients(int x0, int y0, int x1, int y1, int x2, int y2,
+                         long long coef[6])
+{
+    long long xp = x1 - x0, yp = y1 - y0;
+    long long xq = x2 - x0, yq = y2 - y0;
+    long long xprod = xp*yq - xq*yp;
+
+    coef[0] =  yp*yp + yq*yq;
+    coef[1] = -2*(xp*yp + xq*yq);
+    coef[2] =  xp*xp + xq*xq;
+    coef[3] =  0;
+    coef[4] =  0;
+    coef[5] = -xprod*xprod;
+}
+
+// Returns true if point (x,y) is inside or on the ellipse specified by
+// points P0, P1, and P2, as for the Ellipse function. A degenerate
+// ellipse has zero area, and contains no points.
+//
+bool PointInEllipse(int x0, int y0, int x1, int y1, int x2, int y2,
+                    int x, int y)
+{
+    long long coef[6];
+    long long dx = x - x0, dy = y - y0;
+
+    EllipseCoefficients(x0, y0, x1, y1, x2, y2, coef);
+    if (coef[5] == 0)
+        return false;  // degenerate ellipse
+    return (coef[0]*dx + coef[1]*dy)*dx + coef[2]*dy*dy + coef[5] <= 0;
+}
+
+// Batch version of EllipseBox. Array ell contains the points P0, P1,
+// and P2 for each of the count ellipses, in that order, and array box
+// receives four values per ellipse.
+//
+void EllipseBoxes(const XYVAL ell[], int count, int box[])
+{
+    for (int i = 0; i < count; i++, ell += 3, box += 4)
+    {
+        EllipseBox(ell[0].x, ell[0].y, ell[1].x, ell[1].y,
+                   ell[2].x, ell[2].y, box);
+    }
+}
+
+// Batch version of EllipsePgon. Array ell contains the points P0, P1,
+// and P2 for each of the count ellipses, in that order, and array pgon
+// receives eight vertices per ellipse.
+//
+void EllipsePgons(const XYVAL ell[], int count, XYVAL pgon[])
+{
+    for (int i = 0; i < count; i++, ell += 3, pgon += 8)
+    {
+        EllipsePgon(ell[0].x, ell[0].y, ell[1].x, ell[1].y,
+                    ell[2].x, ell[2].y, pgon);
+    }
+}
+
+//-----------------------------------------------------------
+//
+// Bounds and culling
+//
+// The bounds of a conic curve are calculated in four directions:
+// x, y, x + y, and x - y. The ranges of x and y form the bounding
+// box, and all four ranges together form the 8-sided bounding
+// polygon. A curve that is bounded in this way can be tested against
+// a viewport or tile rectangle before it is drawn. The bounds are
+// those of the exact curve, rounded to the nearest integer. The
+// pixels that Pitteway's algorithm draws near an extreme point can
+// stray one pixel past these bounds, so BoundsIntersect and
+// CullConics allow a one-pixel margin. (As with the bounding box in
+// Demo1, a very thin curve can stray further, due to the known
+// limitation of the algorithm.)
+//
+//-----------------------------------------------------------
+
+// Calculates the range [lo,hi] of a*cos(t) + b*sin(t) for t in
+// [0,2*PI) if full is true, or in [0,PI/2] otherwise
+//
+static void ArcRange(long long a, long long b, bool full, int& lo, int& hi)
+{
+    int r = ISqrt(a*a + b*b);
+
+    hi = (full || (a > 0 && b > 0)) ? r : (a > b) ? a : b;
+    lo = (full || (a < 0 && b < 0)) ? -r : (a < b) ? a : b;
+}
+
+// Calculates the range [lo,hi] of the quadratic Bezier function with
+// control values s, c, and e
+//
+static void BezierRange(long long s, long long c, long long e,
+                        int& lo, int& hi)
+{
+    lo = (s < e) ? s : e;
+    hi = (s < e) ? e : s;
+    if (c < lo || c > hi)
+    {
+        // The extreme value (se - c^2)/(s - 2c + e) occurs at
+        // t = (s - c)/(s - 2c + e)
+        long long num = s*e - c*c;
+        long long den = s - 2*c + e;
+        int ext;
+
+        if (den < 0)
+        {
+            num = -num;
+            den = -den;
+        }
+        ext = RoundDiv(num, den);
+        if (c < lo)
+            lo = ext;
+        else
+            hi = ext;
+    }
+}
+
+// Calculates the bounds of an ellipse arc with center (x0,y0) that
+// goes from P0 + P to P0 + Q, where P and Q are conjugate vectors
+// (xp,yp) and (xq,yq). If full is true, the arc is the full ellipse.
+//
+static void EllipseArcBounds(int x0, int y0, long long xp, long long yp,
+                             long long xq, long long yq, bool full,
+                             CONICBOUNDS *bounds)
+{
+    ArcRange(xp, xq, full, bounds->xmin, bounds->xmax);
+    ArcRange(yp, yq, full, bounds->ymin, bounds->ymax);
+    ArcRange(xp + yp, xq + yq, full, bounds->smin, bounds->smax);
+    ArcRange(xp - yp, xq - yq, full, bounds->dmin, bounds->dmax);
+    bounds->xmin += x0;
+    bounds->xmax += x0;
+    bounds->ymin += y0;
+    bounds->ymax += y0;
+    bounds->smin += x0 + y0;
+    bounds->smax += x0 + y0;
+    bounds->dmin += x0 - y0;
+    bounds->dmax += x0 - y0;
+}
+
+// Calculates the bounds of the ellipse drawn by the Ellipse function
+//
+void EllipseBounds(int x0, int y0, int x1, int y1, int x2, int y2,
+                   CONICBOUNDS *bounds)
+{
+    EllipseArcBounds(x0, y0, x1 - x0, y1 - y0, x2 - x0, y2 - y0, true,
+                     bounds);
+}
+
+// Calculates the bounds of the spline drawn by the EllipticSpline
+// function. The spline is a quarter of the ellipse with center
+// Ps + Pe - Pc, and goes from Ps to Pe.
+//
+void EllipticSplineBounds(int xs, int ys, int xc, int yc, int xe, int ye,
+                          CONICBOUNDS *bounds)
+{
+    EllipseArcBounds(xs + xe - xc, ys + ye - yc, xc - xe, yc - ye,
+                     xc - xs, yc - ys, false, bounds);
+}
+
+// Calculates the bounds of the spline drawn by the ParabolicSpline
+// function
+//
+void ParabolicSplineBounds(int xs, int ys, int xc, int yc, int xe, int ye,
+                           CONICBOUNDS *bounds)
+{
+    BezierRange(xs, xc, xe, bounds->xmin, bounds->xmax);
+    BezierRange(ys, yc, ye, bounds->ymin, bounds->ymax);
+    BezierRange(xs + ys, xc + yc, xe + ye, bounds->smin, bounds->smax);
+    BezierRange(xs - ys, xc - yc, xe - ye, bounds->dmin, bounds->dmax);
+}
+
+// Returns true if the 8-sided bounding polygon, enlarged by a one-pixel
+// margin, intersects rectangle rect, which is specified as {xmin, ymin,
+// xmax, ymax}. Each side of the polygon is parallel to a side or a
+// diagonal of the rectangle, so the two shapes intersect if and only
+// if their ranges overlap in all four directions.
+//
+bool BoundsIntersect(const CONICBOUNDS *bounds, const int rect[4])
+{
+    return bounds->xmin <= rect[2] + 1 && bounds->xmax >= rect[0] - 1 &&
+           bounds->ymin <= rect[3] + 1 && bounds->ymax >= rect[1] - 1 &&
+           bounds->smin <= rect[2] + rect[3] + 1 &&
+           bounds->smax >= rect[0] + rect[1] - 1 &&
+           bounds->dmin <= rect[2] - rect[1] + 1 &&
+           bounds->dmax >= rect[0] - rect[3] - 1;
+}
+
+// Culls an array of conic curves against rectangle rect, which is
+// specified as {xmin, ymin, xmax, ymax}. Argument type is CONIC_ELLIPSE,
+// CONIC_ELLIPTIC_SPLINE, or CONIC_PARABOLIC_SPLINE. The ith curve is
+// specified by points (xa[i],ya[i]), (xb[i],yb[i]), and (xc[i],yc[i]),
+// which are P0, P1, and P2 for an ellipse, or Ps, Pc, and Pe for a
+// spline. The indexes of the curves whose bounding polygons (with the
+// one-pixel margin) intersect the rectangle are written to array index
+// in increasing order, and the function returns the number of these
+// indexes.
+//
+int CullConics(int type, const int xa[], const int ya[],
+               const int xb[], const int yb[], const int xc[],
+               const int yc[], int count, const int rect[4], int index[])
+{
+    int n = 0;
+
+    for (int i = 0; i < count; i++)
+    {
+        CONICBOUNDS bounds;
+        int xmin, ymin, xmax, ymax;
+
+        // Find a loose bounding box without square roots or divides:
+        // the parallelogram that encloses an ellipse, or the triangle
+        // that encloses a spline
+        if (type == CONIC_ELLIPSE)
+        {
+            int dx = abs(xb[i] - xa[i]) + abs(xc[i] - xa[i]);
+            int dy = abs(yb[i] - ya[i]) + abs(yc[i] - ya[i]);
+
+            xmin = xa[i] - dx;
+            xmax = xa[i] + dx;
+            ymin = ya[i] - dy;
+            ymax = ya[i] + dy;
+        }
+        else
+        {
+            xmin = std::min(xa[i], std::min(xb[i], xc[i]));
+            xmax = std::max(xa[i], std::max(xb[i], xc[i]));
+            ymin = std::min(ya[i], std::min(yb[i], yc[i]));
+            ymax = std::max(ya[i], std::max(yb[i], yc[i]));
+        }
+        if (xmin > rect[2] + 1 || xmax < rect[0] - 1 ||
+            ymin > rect[3] + 1 || ymax < rect[1] - 1)
+        {
+            continue;  // curve is entirely outside rectangle
+        }
+        if (xmin < rect[0] || xmax > rect[2] ||
+            ymin < rect[1] || ymax > rect[3])
+        {
+            // Curve might cross rectangle boundary, so check the
+            // tight bounding polygon
+            switch (type)
+            {
+            case CONIC_ELLIPSE:
+                EllipseBounds(xa[i], ya[i], xb[i], yb[i], xc[i], yc[i],
+                              &bounds);
+                break;
+            case CONIC_ELLIPTIC_SPLINE:
+                EllipticSplineBounds(xa[i], ya[i], xb[i], yb[i],
+                                     xc[i], yc[i], &bounds);
+                break;
+            default:
+                ParabolicSplineBounds(xa[i], ya[i], xb[i], yb[i],
+                                      xc[i], yc[i], &bounds);
+                break;
+            }
+            if (!BoundsIntersect(&bounds, rect))
+                continue;
+        }
+        index[n++] = i;
+    }
+    return n;
+}
+
+//-----------------------------------------------------------
+//
+// Stamps
+//
+// The pixels that Ellipse draws depend only on the deltas (xp,yp) and
+// (xq,yq) from the center P0 to the conjugate diameter end points P1
+// and P2, and not on the position of the center. For a small ellipse,
+// the pixel pattern can be traced once, stored as a stamp, and copied
+// to each ellipse of the same shape. A stamp is traced into a bit mask
+// for each row, and is stored as the list of the runs of 1 bits in
+// these masks, at three bytes per run, so that copying it takes one
+// span fill per run. Stamps are traced the first time they are needed,
+// and are kept in a cache of fixed size, which holds the stamps of
+// tens of thousands of different shapes. The cache has a table of
+// slots, which is small enough to stay in the processor's cache, and
+// a pool from which the runs of each stamp are taken in order. Each
+// shape can go in only one slot, which is chosen by hashing its
+// deltas; a shape that needs the slot of another replaces it, and the
+// other is traced again if it is needed again. When the pool runs
+// out, the cache is emptied, and the stamps still in use are traced
+// again. FreeStamps frees the cache.
+//
+//-----------------------------------------------------------
+
+// Largest radius, in pixels, of an ellipse that is drawn from a stamp
+const int STAMP_MAXRADIUS = 16;
+
+// Number of deltas in the range -STAMP_MAXRADIUS to +STAMP_MAXRADIUS
+const int STAMP_DELTAS = 2*STAMP_MAXRADIUS + 1;
+
+// Width and height of a stamp, and the offset of the center pixel.
+// With deltas up to STAMP_MAXRADIUS, the radius of the bounding box
+// can be up to sqrt(2)*STAMP_MAXRADIUS, and a pixel drawn by Ellipse
+// can lie one pixel outside the bounding box.
+const int STAMP_CENTER = 3*STAMP_MAXRADIUS/2 + 1;
+const int STAMP_SIZE = 2*STAMP_CENTER + 1;
+
+// Number of slots in the stamp cache, as a power of 2, and number of
+// runs in its pool. The slots take 1.5 megabytes, and the pool takes 6
+// megabytes, or about 25 runs for each slot, which is the number of
+// runs in a stamp of typical size.
+const int STAMP_SLOTBITS = 17;
+const int STAMP_SLOTS = 1 << STAMP_SLOTBITS;
+const int STAMP_POOLRUNS = 1 << 21;
+
+// Run of pixels in a stamp, from x offset xl to xr (inclusive) in the
+// row at y offset dy from the center
+struct STAMPRUN
+{
+    signed char dy, xl, xr;
+};
+
+// Slot of the stamp cache. The runs of the stamp are pool[first]
+// through pool[first+count-1].
+struct STAMP
+{
+    int key;             // deltas of the ellipse (see GetStamp); -1 if none
+    unsigned short count;  // number of runs
+    bool valid;          // false if Ellipse strays outside the stamp
+    int first;           // index in pool of first run
+};
+
+// Stamp cache, with slots and pool 0 until the first stamp is traced
+static struct
+{
+    STAMP *slots;
+    STAMPRUN *pool;
+    int used;            // number of runs used in the pool
+} s_stamps;
+
+// Row masks of the stamp being traced: bit i of a row mask is set if
+// the pixel at x offset i - STAMP_CENTER from the center is drawn
+static struct
+{
+    int ymin, ymax;      // range of rows used (ymin > ymax if none)
+    bool valid;          // false if Ellipse strays outside the stamp
+    unsigned long long row[STAMP_SIZE];
+} s_trace;
+
+// Pixel function that adds a pixel to the stamp being traced
+//
+static void StampPixel(int x, int y)
+{
+    x += STAMP_CENTER;
+    y += STAMP_CENTER;
+    if (x < 0 || x >= STAMP_SIZE || y < 0 || y >= STAMP_SIZE)
+    {
+        s_trace.valid = false;
+        return;
+    }
+    s_trace.row[y] |= 1ULL << x;
+    s_trace.ymin = std::min(s_trace.ymin, y);
+    s_trace.ymax = std::max(s_trace.ymax, y);
+}
+
+// Returns the index of the single 1 bit in bit, which is a power of 2
+// less than 2^63. Uses a de Bruijn sequence to look up the index.
+//
+static inline int LowBitIndex(unsigned long long bit)
+{
+    static const unsigned char index[64] = {
+         0,  1,  2, 53,  3,  7, 54, 27,  4, 38, 41,  8, 34, 55, 48, 28,
+        62,  5, 39, 46, 44, 42, 22,  9, 24, 35, 59, 56, 49, 18, 29, 11,
+        63, 52,  6, 26, 37, 40, 33, 47, 61, 45, 43, 21, 23, 58, 17, 10,
+        51, 25, 36, 32, 60, 20, 57, 16, 50, 31, 19, 15, 30, 14, 13, 12
+    };
+
+    return index[(bit*0x022fdd63cc95386dULL) >> 58];
+}
+
+// Empties the stamp cache, allocating it first if necessary
+//
+static void ClearStamps()
+{
+    if (s_stamps.slots == 0)
+    {
+        s_stamps.slots = new STAMP[STAMP_SLOTS];
+        s_stamps.pool = new STAMPRUN[STAMP_POOLRUNS];
+    }
+    for (int k = 0; k < STAMP_SLOTS; k++)
+        s_stamps.slots[k].key = -1;
+    s_stamps.used = 0;
+}
+
+// Returns the stamp for the ellipse with deltas (xp,yp) and (xq,yq),
+// tracing it if necessary. All four deltas are in the range
+// -STAMP_MAXRADIUS to +STAMP_MAXRADIUS. The ellipse is traced a pixel
+// at a time, even if a segment function is in effect.
+//
+static const STAMP *GetStamp(int xp, int yp, int xq, int yq)
+{
+    int i = (xp + STAMP_MAXRADIUS)*STAMP_DELTAS + yp + STAMP_MAXRADIUS;
+    int j = (xq + STAMP_MAXRADIUS)*STAMP_DELTAS + yq + STAMP_MAXRADIUS;
+    int key = i*STAMP_DELTAS*STAMP_DELTAS + j;
+    unsigned slot = (key*2654435761u) >> (32 - STAMP_SLOTBITS);
+    SEGMENTPROC segmentProc = g_segmentProc;
+    PIXELPROC prev;
+    STAMP *stamp;
+    int rows;
+
+    if (s_stamps.slots == 0)
+        ClearStamps();
+    stamp = &s_stamps.slots[slot];
+    if (stamp->key == key)
+        return stamp;
+
+    // Trace the ellipse with its center at the origin
+    s_trace.ymin = STAMP_SIZE;
+    s_trace.ymax = -1;
+    s_trace.valid = true;
+    std::fill(s_trace.row, s_trace.row + STAMP_SIZE, 0ULL);
+    g_segmentProc = 0;
+    prev = g_pixelProc;
+    g_pixelProc = StampPixel;
+    Ellipse(0, 0, xp, yp, xq, yq);
+    g_pixelProc = prev;
+    g_segmentProc = segmentProc;
+
+    // Make room in the pool for as many runs as the rows can hold
+    rows = s_trace.ymax - s_trace.ymin + 1;
+    if (s_stamps.used + rows*(STAMP_SIZE/2 + 1) > STAMP_POOLRUNS)
+        ClearStamps();
+    stamp->key = key;
+    stamp->valid = s_trace.valid;
+    stamp->first = s_stamps.used;
+    stamp->count = 0;
+    if (!s_trace.valid)
+        return stamp;
+
+    // Store each run. Adding the lowest 1 bit to a mask carries
+    // through the lowest run, to the first 0 bit above the run.
+    for (int y = s_trace.ymin; y <= s_trace.ymax; y++)
+    {
+        unsigned long long mask = s_trace.row[y];
+
+        while (mask != 0)
+        {
+            unsigned long long low = mask & (~mask + 1);
+            unsigned long long carry = mask + low;
+            unsigned long long high = carry & (~carry + 1);
+            STAMPRUN& run = s_stamps.pool[s_stamps.used++];
+
+            run.dy = (signed char)(y - STAMP_CENTER);
+            run.xl = (signed char)(LowBitIndex(low) - STAMP_CENTER);
+            run.xr = (signed char)(LowBitIndex(high) - 1 - STAMP_CENTER);
+            mask &= carry;
+        }
+    }
+    stamp->count = s_stamps.used - stamp->first;
+    return stamp;
+}
+
+// Frees the stamps traced by StampEllipse. Stamps that are needed
+// again are traced again.
+//
+void FreeStamps()
+{
+    delete[] s_stamps.slots;
+    delete[] s_stamps.pool;
+    s_stamps.slots = 0;
+    s_stamps.pool = 0;
+}
+
+// Draws a small ellipse, specified as for the Ellipse function, by
+// copying its stamp. Each run of the stamp is drawn as a span by
+// DrawSpan, except that a run of one pixel, which is the most common
+// kind in the outline of a small ellipse, goes straight to the pixel
+// function. If a segment function is in effect, each run is passed to
+// it as a horizontal line instead. The pixels drawn are the same ones that Ellipse
+// draws, but each pixel is drawn only once. Returns false, and draws
+// nothing, if the ellipse is too large for a stamp, or if it is too
+// thin to be drawn reliably (see the known limitation of Pitteway's
+// algorithm), in which case the caller should call Ellipse instead.
+//
+bool StampEllipse(int x0, int y0, int x1, int y1, int x2, int y2)
+{
+    int xp = x1 - x0, yp = y1 - y0;
+    int xq = x2 - x0, yq = y2 - y0;
+    const STAMP *stamp;
+
+    if (abs(xp) > STAMP_MAXRADIUS || abs(yp) > STAMP_MAXRADIUS ||
+        abs(xq) > STAMP_MAXRADIUS || abs(yq) > STAMP_MAXRADIUS)
+    {
+        return false;
+    }
+    stamp = GetStamp(xp, yp, xq, yq);
+    if (!stamp->valid)
+        return false;
+    for (int i = 0; i < stamp->count; i++)
+    {
+        const STAMPRUN& run = s_stamps.pool[stamp->first + i];
+
+        if (run.xl == run.xr && !g_segmentProc)
+            g_pixelProc(x0 + run.xl, y0 + run.dy);
+        else
+            EmitSpan(x0 + run.xl, x0 + run.xr, y0 + run.dy);
+    }
+    return true;
+}
+
+//-----------------------------------------------------------
+//
+// Level of detail
+//
+// LodEllipse chooses the cheapest way to draw an ellipse from its
+// integer bounding box (see EllipseBox). An ellipse whose box, grown by
+// a pixel as in CullConics, lies outside the clip rectangle set by
+// SetClipRect is culled. The size of the box is compared through the
+// squares of its half-width and half-height, and the box itself is only
+// calculated for an ellipse near an edge of the clip rectangle, so that
+// most ellipses are classified without square roots. An ellipse that is
+// less than a pixel across is drawn as a single dot at its center. A
+// tiny ellipse, with deltas of up to STAMP_MAXRADIUS, is drawn from a
+// stamp (see StampEllipse). Ellipses of normal size are drawn by
+// Ellipse. A huge ellipse is drawn by ClippedEllipse, which skips the
+// arcs of the ellipse outside the clip rectangle, and uses 64-bit
+// coefficients that do not overflow.
+//
+//-----------------------------------------------------------
+
+// Smallest half-width or half-height, in pixels, of a huge ellipse.
+// The coefficients that Ellipse calculates overflow an int for an
+// ellipse of about this size.
+const int LOD_HUGERADIUS = 512;
+
+// Number of ellipses drawn by each path in LodEllipse
+static LODSTATS s_lodStats;
+
+// Draws an ellipse, specified as for the Ellipse function, by the
+// cheapest method that its size allows. Returns the method used:
+// LOD_CULLED, LOD_DOT, LOD_STAMP, LOD_CONIC, or LOD_CLIPPED.
+//
+int LodEllipse(int x0, int y0, int x1, int y1, int x2, int y2)
+{
+    long long xp = x1 - x0, yp = y1 - y0;
+    long long xq = x2 - x0, yq = y2 - y0;
+    long long xsq = xp*xp + xq*xq;
+    long long ysq = yp*yp + yq*yq;
+    int box[4];
+
+    // The enclosing parallelogram bounds the ellipse loosely. Only when
+    // it crosses an edge of the clip rectangle is the exact box needed.
+    box[0] = x0 - (int)(llabs(xp) + llabs(xq));
+    box[1] = y0 - (int)(llabs(yp) + llabs(yq));
+    box[2] = 2*x0 - box[0];
+    box[3] = 2*y0 - box[1];
+    if (box[0] <= g_clip[0] || box[2] >= g_clip[2] ||
+        box[1] <= g_clip[1] || box[3] >= g_clip[3])
+    {
+        if (box[0] > g_clip[2] + 1 || box[2] < g_clip[0] - 1 ||
+            box[1] > g_clip[3] + 1 || box[3] < g_clip[1] - 1)
+        {
+            s_lodStats.culled++;
+            return LOD_CULLED;
+        }
+        EllipseBox(x0, y0, x1, y1, x2, y2, box);
+        if (box[0] > g_clip[2] + 1 || box[2] < g_clip[0] - 1 ||
+            box[1] > g_clip[3] + 1 || box[3] < g_clip[1] - 1)
+        {
+            s_lodStats.culled++;
+            return LOD_CULLED;
+        }
+    }
+
+    if (xsq == 0 && ysq == 0)
+    {
+        s_lodStats.dots++;
+        if (g_segmentProc)
+            Line(x0, y0, x0, y0);
+        else
+            g_pixelProc(x0, y0);
+        return LOD_DOT;
+    }
+    if (StampEllipse(x0, y0, x1, y1, x2, y2))
+    {
+        s_lodStats.stamps++;
+        return LOD_STAMP;
+    }
+
+    // ISqrt(n) <= r exactly when n <= r*(r + 1), so the half-width and
+    // half-height of the box are tested without taking square roots.
+    if (xsq <= (LOD_HUGERADIUS - 1)*LOD_HUGERADIUS &&
+        ysq <= (LOD_HUGERADIUS - 1)*LOD_HUGERADIUS)
+    {
+        s_lodStats.conics++;
+        Ellipse(x0, y0, x1, y1, x2, y2);
+        return LOD_CONIC;
+    }
+    s_lodStats.clipped++;
+    ClippedEllipse(x0, y0, x1, y1, x2, y2);
+    return LOD_CLIPPED;
+}
+
+// Copies the counts of ellipses drawn by each path in LodEllipse to
+// stats. If reset is true, the counts are then set to zero.
+//
+void GetLodStats(LODSTATS *stats, bool reset)
+{
+    *stats = s_lodStats;
+    if (reset)
+    {
+        LODSTATS zero = {};
+
+        s_lodStats = zero;
+    }
+}
+
+// Copies the counts of walks stopped early by ConicWalk and ConicIter,
+// and the arguments of the most recent one, to stats, so that the
+// caller can report bad input. If reset is true, the counts are then
+// set to zero.
+//
+void GetWalkStats(WALKSTATS *stats, bool reset)
+{
+    *stats = s_walkStats;
+    if (reset)
+    {
+        WALKSTATS zero = {};
+
+        s_walkStats = zero;
+    }
+}
+
+//-----------------------------------------------------------
+//
+// Pixel iterator
+//
+// The ConicIter class declared in conic.h runs the same walk as
+// the ConicWalk function, using the Walk functions above, but it
+// returns from Next after each pixel rather than calling the pixel
+// function. The curve is drawn one step at a time as the caller
+// asks for pixels, so the caller decides how much of the curve
+// is drawn, and when.
+//
+//-----------------------------------------------------------
+
+// Prepares to step through the arc from (xs,ys) to (xe,ye). The
+// arguments are the same as for ConicWalk.
+//
+void ConicIter::Start(int xs, int ys, int xe, int ye, long long A,
+                      long long B, long long C, long long D, long long E,
+                      long long F, const int *box)
+{
+    WalkStart(*this, xs, ys, xe, ye, A, B, C, D, E, F);
+    WalkLimit(*this, xs, ys, A, B, C, D, E, F, box);
+    ConicSegment(&seg, xs, ys, xe, ye, A, B, C, D, E, F, box);
+    mode = ITER_CONIC;
+    useBox = (box != 0);
+    if (useBox)
+        std::copy(box, box + 4, this->box);
+    held = false;
+}
+
+// Prepares to step through a segment received by a segment function
+// (see SetSegmentProc)
+//
+void ConicIter::Start(const SEGMENT& seg)
+{
+    if (seg.line)
+        StartLine(seg.xs, seg.ys, seg.xe, seg.ye);
+    else
+        Start(seg.xs, seg.ys, seg.xe, seg.ye, seg.A, seg.B, seg.C,
+              seg.D, seg.E, seg.F, (seg.useBox) ? seg.box : 0);
+}
+
+// Prepares to step through a straight line from (xs,ys) to (xe,ye),
+// which has the same pixels as the line drawn by the Line function
+//
+void ConicIter::StartLine(int xs, int ys, int xe, int ye)
+{
+    LineStart(*this, xs, ys, xe, ye);
+    mode = ITER_LINE;
+    held = false;
+}
+
+// Prepares to step through a full ellipse. The arguments and the
+// order of the pixels are the same as for the Ellipse function.
+//
+void ConicIter::StartEllipse(int x0, int y0, int x1, int y1, int x2, int y2)
+{
+    long long xp, yp, xq, yq, xprod;
+    long long A, B, C;
+
+    xp = x1 - x0;
+    yp = y1 - y0;
+    xq = x2 - x0;
+    yq = y2 - y0;
+    A =  yp*yp + yq*yq;
+    B = -2*(xp*yp + xq*yq);
+    C =  xp*xp + xq*xq;
+    xprod = xp*yq - xq*yp;
+    if (xprod == 0)
+    {
+        // Degenerate ellipse is a straight line
+        int x, y;
+
+        DegenerateEllipse(xp, yp, xq, yq, &x, &y);
+        StartLine(x0+x, y0+y, x0-x, y0-y);
+        return;
+    }
+    if (xprod < 0)
+    {
+        std::swap(x1, x2);
+        std::swap(y1, y2);
+        std::swap(xp, xq);
+        std::swap(yp, yq);
+        xprod = -xprod;
+    }
+    Start(x1, y1, x1, y1, A, B, C, 2*yq*xprod, -2*xq*xprod, 0);
+}
+
+// Takes the next step of the walk, ignoring any pixel held by
+// NextRun. Returns false if the curve is complete.
+//
+bool ConicIter::Step(int *px, int *py)
+{
+    if (mode == ITER_CONIC)
+    {
+        // Cross into the octant that contains the next pixel
+        while (!WalkInOctant(*this))
+        {
+            if (--octantCount < 0)
+                break;  // failed to draw all pixels in final octant
+
+            WalkTurn(*this);
+        }
+        bool missed = octantCount < 0 ||
+                      (useBox && (x < box[0] || y < box[1] ||
+                                  x > box[2] || y > box[3]));
+
+        if (missed || --stepsLeft < 0)
+        {
+            // Finish with a line to the end point, as ConicWalk does
+            WalkStopped(seg, x, y, !missed);
+            LineStart(*this, x, y, xe, ye);
+            mode = ITER_LINE;
+        }
+    }
+    if (mode == ITER_DONE)
+        return false;
+
+    *px = x;
+    *py = y;
+    if (--pixelCount == 0)
+        mode = ITER_DONE;  // that was the last pixel
+    else if (mode == ITER_CONIC)
+        WalkStep(*this);
+    else
+        LineStep(*this);
+    return true;
+}
+
+//-----------------------------------------------------------
+// Next function -- Gets the next pixel of the curve in (*px,*py).
+// Returns false, and leaves *px and *py unchanged, if there are no
+// more pixels.
+//-----------------------------------------------------------
+bool ConicIter::Next(int *px, int *py)
+{
+    if (held)
+    {
+        *px = heldPt.x;
+        *py = heldPt.y;
+        held = false;
+        return true;
+    }
+    return Step(px, py);
+}
+
+//-----------------------------------------------------------
+// NextRun function -- Gets the next horizontal run of pixels, from
+// (*xl,*py) to (*xr,*py), where *xl <= *xr. A run is a sequence of
+// pixels in the same row that the curve passes through from left
+// to right or right to left; the curve may return to the same row
+// later in another run. Returns false if there are no more pixels.
+//-----------------------------------------------------------
+bool ConicIter::NextRun(int *xl, int *xr, int *py)
+{
+    int x0, y0, x1, y1, dx = 0;
+
+    if (!Next(&x0, &y0))
+        return false;
+
+    *xl = *xr = x0;
+    *py = y0;
+    while (Step(&x1, &y1))
+    {
+        if (y1 != y0 || abs(x1 - x0) != 1 || (dx && x1 - x0 != dx))
+        {
+            // Pixel starts the next run, so hold it for later
+            heldPt.x = x1;
+            heldPt.y = y1;
+            held = true;
+            break;
+        }
+        dx = x1 - x0;
+        x0 = x1;
+        if (dx < 0)
+            *xl = x1;
+        else
+            *xr = x1;
+    }
+    return true;
+}
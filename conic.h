@@ -4,17 +4,282 @@
 //
 //-----------------------------------------------------------
 
+#ifndef CONIC_H
+#define CONIC_H
+
+#if __cplusplus >= 202002L
+#include <iterator>
+#endif
+
 // Implemented by demo program
 extern void DrawPixel(int x, int y);
 
+// Fixed-point coordinates have FIX_SHIFT bits of fraction
+const int FIX_SHIFT = 8;
+const int FIX_ONE = 1 << FIX_SHIFT;
+
+// x-y coordinate pair
+struct XYVAL
+{
+    int x; int y;
+};
+
+// Bounds of a conic curve: the bounding box, and the ranges of x + y
+// and x - y, which together with the box form an 8-sided polygon
+struct CONICBOUNDS
+{
+    int xmin, ymin, xmax, ymax;
+    int smin, smax;  // range of x + y
+    int dmin, dmax;  // range of x - y
+};
+
+// Curve types for CullConics
+enum
+{
+    CONIC_ELLIPSE,
+    CONIC_ELLIPTIC_SPLINE,
+    CONIC_PARABOLIC_SPLINE
+};
+
+// Drawing methods chosen by LodEllipse
+enum
+{
+    LOD_CULLED,    // outside the clip rectangle; not drawn
+    LOD_DOT,       // less than a pixel across; drawn as one pixel
+    LOD_STAMP,     // tiny; drawn from a stamp
+    LOD_CONIC,     // drawn by Ellipse
+    LOD_CLIPPED    // huge; drawn by ClippedEllipse
+};
+
+// Number of ellipses drawn by each method in LodEllipse
+struct LODSTATS
+{
+    int culled, dots, stamps, conics, clipped;
+};
+
+// A segment of a curve, as received by a segment function (see
+// SetSegmentProc): either a straight line from (xs,ys) to (xe,ye),
+// or an arc from (xs,ys) to (xe,ye) of the conic with coefficients
+// A-F, with the arguments of Conic64. If useBox is true, box holds
+// the bounds used to detect a missed turn (see ConicIter).
+struct SEGMENT
+{
+    bool line;
+    int xs, ys, xe, ye;
+    long long A, B, C, D, E, F;
+    bool useBox;
+    int box[4];  // xmin, ymin, xmax, ymax
+};
+
+// Walks that Pitteway's algorithm could not finish normally (see
+// GetWalkStats). A walk that misses a sharp turn can head away from
+// the curve and never reach the end point. It is stopped when it
+// leaves its bounding box, when it has turned through more octants
+// than the arc spans, or, as a last resort, when it has drawn more
+// pixels than an arc of its size can have. It is then finished with
+// a straight line to the end point.
+struct WALKSTATS
+{
+    int missedTurns;     // walks stopped by their box or octant count
+    int overruns;        // walks stopped by the pixel limit
+    SEGMENT last;        // arguments of the most recent such walk
+    int x, y;            // pixel at which it was stopped
+};
+
+// The ConicIter class runs Pitteway's algorithm one pixel at a time.
+// Start takes the same arguments as Conic64 (and also accepts those
+// of Conic), but instead of sending pixels to the pixel function,
+// the iterator hands them back one at a time from Next, or one
+// horizontal run at a time from NextRun. Between calls, the members
+// x through k3 hold the algorithm's state, so the caller can stop
+// early, or step through several curves together -- for example, to
+// merge their pixels in scanline order. If box is not 0, a missed
+// turn is detected as described for the ConicWalk function in
+// conic.cpp, and the iterator finishes with a line to the end point.
+// The iterator stops a runaway walk after stepsLeft pixels, in the
+// same way as ConicWalk.
+//
+class ConicIter
+{
+public:
+    int x, y;                // next pixel
+    int xe, ye;              // end point of arc
+    int octant, octantCount, pixelCount;
+    int dxsquare, dysquare;  // square step
+    int dxdiag, dydiag;      // diagonal step
+    long long d, u, v;       // decision variable and its increments
+    long long k1, k2, k3;    // second differences
+    int stepsLeft;           // pixels left before walk is stopped
+
+    ConicIter()
+    {
+        mode = ITER_DONE;
+        held = false;
+    }
+    ConicIter(int xs, int ys, int xe, int ye, long long A, long long B,
+              long long C, long long D, long long E, long long F,
+              const int *box = 0)
+    {
+        Start(xs, ys, xe, ye, A, B, C, D, E, F, box);
+    }
+    ~ConicIter()
+    {
+    }
+    void Start(int xs, int ys, int xe, int ye, long long A, long long B,
+               long long C, long long D, long long E, long long F,
+               const int *box = 0);
+    void Start(const SEGMENT& seg);
+    void StartLine(int xs, int ys, int xe, int ye);
+    void StartEllipse(int x0, int y0, int x1, int y1, int x2, int y2);
+    bool Next(int *px, int *py);
+    bool NextRun(int *xl, int *xr, int *py);
+    bool Done() const
+    {
+        return !held && mode == ITER_DONE;
+    }
+
+#if __cplusplus >= 202002L
+    // Input iterator, so that a ConicIter is a C++20 range of XYVAL
+    // pixels. The range is single-pass: begin consumes a pixel.
+    class iterator
+    {
+    public:
+        typedef XYVAL value_type;
+        typedef long difference_type;
+
+        iterator() : iter(0), pt()
+        {
+        }
+        explicit iterator(ConicIter *iter) : iter(iter), pt()
+        {
+            ++*this;
+        }
+        const XYVAL& operator*() const
+        {
+            return pt;
+        }
+        iterator& operator++()
+        {
+            if (!iter->Next(&pt.x, &pt.y))
+                iter = 0;
+            return *this;
+        }
+        void operator++(int)
+        {
+            ++*this;
+        }
+        bool operator==(std::default_sentinel_t) const
+        {
+            return iter == 0;
+        }
+
+    private:
+        ConicIter *iter;
+        XYVAL pt;
+    };
+    iterator begin()
+    {
+        return iterator(this);
+    }
+    std::default_sentinel_t end() const
+    {
+        return std::default_sentinel;
+    }
+#endif
+
+private:
+    enum { ITER_DONE, ITER_CONIC, ITER_LINE };
+    int mode;                // current algorithm, or ITER_DONE
+    bool useBox;             // true if bounds box is used
+    int box[4];              // xmin, ymin, xmax, ymax
+    bool held;               // true if pixel heldPt not yet returned
+    XYVAL heldPt;            // pixel read ahead by NextRun
+    SEGMENT seg;             // arguments of Start, for GetWalkStats
+
+    bool Step(int *px, int *py);
+};
+
+// Pixel, span, and segment output functions
+typedef void (*PIXELPROC)(int x, int y);
+typedef void (*SPANPROC)(int xl, int xr, int y);
+typedef void (*SEGMENTPROC)(const SEGMENT *seg);
+
+// Spline-drawing function, such as ParabolicSpline or EllipticSplineFx
+typedef void (*SPLINEPROC)(int xs, int ys, int xc, int yc, int xe, int ye);
+
 // Implemented in conic.cpp
+extern PIXELPROC SetPixelProc(PIXELPROC proc);
+extern SPANPROC SetSpanProc(SPANPROC proc);
+extern SEGMENTPROC SetSegmentProc(SEGMENTPROC proc);
+extern void DrawSpan(int xl, int xr, int y);
 extern void Line(int xs, int ys, int xe, int ye);
 extern int GetOctant(int dfdx, int dfdy);
 extern void Conic(int xs, int ys, int xe, int ye,
                   int A, int B, int C, int D, int E, int F);
+extern void Conic64(int xs, int ys, int xe, int ye,
+                    long long A, long long B, long long C,
+                    long long D, long long E, long long F);
 extern void Ellipse(int x0, int y0, int x1, int y1, int x2, int y2);
 extern void EllipticSpline(int xs, int ys, int xc, int yc, int xe, int ye);
 extern void ParabolicSpline(int xs, int ys, int xc, int yc, int xe, int ye);
+extern void RationalQuadSpline(int xs, int ys, int xc, int yc,
+                               int xe, int ye, int w);
+extern void EllipticSplineFx(int xs, int ys, int xc, int yc,
+                             int xe, int ye);
+extern void ParabolicSplineFx(int xs, int ys, int xc, int yc,
+                              int xe, int ye);
+extern int CubicSplineFx(int xs, int ys, int x1, int y1, int x2, int y2,
+                         int xe, int ye, int tol);
+extern int CubicSpline(int xs, int ys, int x1, int y1, int x2, int y2,
+                       int xe, int ye, int tol);
+extern int CubicLineCount(int xs, int ys, int x1, int y1, int x2, int y2,
+                          int xe, int ye, int tol);
+extern void SetClipRect(int xmin, int ymin, int xmax, int ymax);
+extern void Hyperbola(int x0, int y0, int x1, int y1, int x2, int y2);
+extern void Parabola(int xs, int ys, int xc, int yc, int xe, int ye);
+extern void ClippedEllipse(int x0, int y0, int x1, int y1,
+                           int x2, int y2);
+extern void WideEllipse(int x0, int y0, int x1, int y1, int x2, int y2,
+                        int width);
+extern void WideEllipticSpline(int xs, int ys, int xc, int yc,
+                               int xe, int ye, int width);
+extern void WideParabolicSpline(int xs, int ys, int xc, int yc,
+                                int xe, int ye, int width);
+extern void FillEllipse(int x0, int y0, int x1, int y1, int x2, int y2);
+extern void PolySpline(SPLINEPROC spline, const XYVAL pt[], int npts);
+extern int ISqrt(long long n);
+extern void EllipseBox(int x0, int y0, int x1, int y1, int x2, int y2,
+                       int box[4]);
+extern void EllipsePgon(int x0, int y0, int x1, int y1, int x2, int y2,
+                        XYVAL pgon[8]);
+extern bool EllipseInscribedPgon(int x0, int y0, int x1, int y1,
+                                 int x2, int y2, XYVAL pgon[8]);
+extern bool EllipseAxes(int x0, int y0, int x1, int y1, int x2, int y2,
+                        XYVAL axes[4]);
+extern void EllipseBoxes(const XYVAL ell[], int count, int box[]);
+extern void EllipseCoefficients(int x0, int y0, int x1, int y1,
+                                int x2, int y2, long long coef[6]);
+extern bool PointInEllipse(int x0, int y0, int x1, int y1, int x2, int y2,
+                           int x, int y);
+extern void EllipsePgons(const XYVAL ell[], int count, XYVAL pgon[]);
+extern void EllipseBounds(int x0, int y0, int x1, int y1, int x2, int y2,
+                          CONICBOUNDS *bounds);
+extern void EllipticSplineBounds(int xs, int ys, int xc, int yc,
+                                 int xe, int ye, CONICBOUNDS *bounds);
+extern void ParabolicSplineBounds(int xs, int ys, int xc, int yc,
+                                  int xe, int ye, CONICBOUNDS *bounds);
+extern bool BoundsIntersect(const CONICBOUNDS *bounds, const int rect[4]);
+extern int CullConics(int type, const int xa[], const int ya[],
+                      const int xb[], const int yb[], const int xc[],
+                      const int yc[], int count, const int rect[4],
+                      int index[]);
+extern bool StampEllipse(int x0, int y0, int x1, int y1, int x2, int y2);
+extern void FreeStamps();
+extern int LodEllipse(int x0, int y0, int x1, int y1, int x2, int y2);
+extern void GetLodStats(LODSTATS *stats, bool reset);
+extern void GetWalkStats(WALKSTATS *stats, bool reset);
+
+#endif  // CONIC_H
 
 
 
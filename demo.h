@@ -4,6 +4,12 @@
 //
 //---------------------------------------------------------------------
 
+#ifndef DEMO_H
+#define DEMO_H
+
+#include <vector>
+#include "conic.h"
+
 const float PI = 3.14159265358979323846;
 
 // Window width and height
@@ -13,11 +19,12 @@ const int DEMO_HEIGHT = 960;
 // Offset of frame from edges of window
 const int EDGE_OFFSET = 6;
 
-// x-y coordinate pair
-struct XYVAL
-{
-    int x; int y;
-};
+// Time allowed for drawing each frame, in milliseconds
+const double RENDER_MS = 12.0;
+
+// Length of a simulation step, and nominal time between frames, in
+// milliseconds
+const double STEP_MS = 1000.0/60;
 
 typedef unsigned int COLOR;
 #define RGBX(r,g,b)  (COLOR)(((r)&255)|(((g)&255)<<8)|(((b)&255)<<16))  
@@ -38,15 +45,19 @@ const COLOR YELLOW    = RGBX(255, 255,   0);
 // The Bounce class generates an animated parallelogram that bounces
 // off the sides of a rectangular drawing area. The pt array specifies
 // the four vertexes of the parallelogram, and the vpt array specifies
-// the velocities at which the vertexes are moving. The Update function
-// uses the velocities to calculate the next position of the vertexes.
-// All calculations use integer arithmetic.
+// the velocities at which the vertexes are moving. The Step function
+// uses the velocities to calculate the next position of the vertexes,
+// and saves the previous position in the prev array. The Interpolate
+// function calculates a position in between the two, so the animation
+// can be drawn at any frame rate while it is simulated with a fixed
+// time step. All calculations use integer arithmetic.
 //
 class Bounce
 {
 public:
     XYVAL pt[4];      // vertexes (in order) J, P, K, Q
     XYVAL vpt[4];     // velocities of points -, P, K, Q
+    XYVAL prev[4];    // vertexes before the most recent Step
     int xmin, ymin;   // top-left corner of animation boundary
     int xmax, ymax;   // bottom-right corner of animation boundary
 
@@ -55,4 +66,40 @@ public:
     {
     }
     void Update(XYVAL xy[]);
+    void Step();
+    void Interpolate(int alpha, XYVAL xy[]);
+};
+
+// The BounceBatch class animates count parallelograms with the same
+// motion model as the Bounce class. Each coordinate of each vertex,
+// and each velocity, is kept in its own array, indexed by
+// parallelogram, so that the Step function can update all of the
+// parallelograms with short loops of branch-free integer arithmetic
+// that the compiler turns into SIMD code. GetEllipses writes the
+// ellipses inscribed in the parallelograms to separate arrays for the
+// center point P0 and the conjugate diameter end points P1 and P2,
+// the form in which CullConics takes them.
+//
+class BounceBatch
+{
+public:
+    int count;                  // number of parallelograms
+    std::vector<int> x[4];      // vertexes J, P, K, Q
+    std::vector<int> y[4];
+    std::vector<int> vx[4];     // velocities of -, P, K, Q
+    std::vector<int> vy[4];
+    int xmin, ymin;             // top-left corner of boundary
+    int xmax, ymax;             // bottom-right corner of boundary
+
+    BounceBatch(int width, int height, int count);
+    ~BounceBatch()
+    {
+    }
+    void Set(int i, const XYVAL pt[4], const XYVAL vpt[4]);
+    void Randomize(unsigned seed);
+    void Step();
+    void GetEllipses(int x0[], int y0[], int x1[], int y1[],
+                     int x2[], int y2[]) const;
 };
+
+#endif  // DEMO_H
@@ -0,0 +1,218 @@
+//---------------------------------------------------------------------
+//
+// grid.cpp -- EllipseGrid class member functions
+//
+//---------------------------------------------------------------------
+
+#include <algorithm>
+#include "grid.h"
+
+// Constructor. The grid covers the area from (0,0) to (width-1,
+// height-1). An ellipse or query that extends outside this area is
+// assigned to the nearest cells at the edge of the grid.
+EllipseGrid::EllipseGrid(int width, int height, int cellSize) :
+            cellSize(cellSize),
+            ncols((width + cellSize - 1)/cellSize),
+            nrows((height + cellSize - 1)/cellSize),
+            query(0)
+{
+    if (ncols < 1)
+        ncols = 1;
+    if (nrows < 1)
+        nrows = 1;
+    cell.resize(ncols*nrows);
+}
+
+// Calculates the range of cells overlapped by bounding box box
+void EllipseGrid::CellRange(const int box[4], int cells[4])
+{
+    int lim[4] = { ncols - 1, nrows - 1, ncols - 1, nrows - 1 };
+
+    for (int i = 0; i < 4; i++)
+    {
+        int c = (box[i] < 0) ? 0 : box[i]/cellSize;
+
+        cells[i] = (c > lim[i]) ? lim[i] : c;
+    }
+}
+
+// Adds ellipse id to the cells that its bounding box overlaps
+void EllipseGrid::Link(int id)
+{
+    ITEM& item = items[id];
+
+    EllipseBox(item.x0, item.y0, item.x1, item.y1, item.x2, item.y2,
+               item.box);
+    CellRange(item.box, item.cells);
+    for (int cy = item.cells[1]; cy <= item.cells[3]; cy++)
+    {
+        for (int cx = item.cells[0]; cx <= item.cells[2]; cx++)
+            cell[cy*ncols + cx].push_back(id);
+    }
+}
+
+// Removes ellipse id from the cells that it was added to
+void EllipseGrid::Unlink(int id)
+{
+    ITEM& item = items[id];
+
+    for (int cy = item.cells[1]; cy <= item.cells[3]; cy++)
+    {
+        for (int cx = item.cells[0]; cx <= item.cells[2]; cx++)
+        {
+            std::vector<int>& list = cell[cy*ncols + cx];
+            std::vector<int>::iterator it;
+
+            it = std::find(list.begin(), list.end(), id);
+            if (it == list.end())
+                continue;  // not listed; the lists are left unchanged
+            *it = list.back();
+            list.pop_back();
+        }
+    }
+}
+
+//---------------------------------------------------------------------
+// Insert function -- Adds an ellipse to the grid. The ellipse is
+// specified by its center point (x0,y0) and the end points (x1,y1)
+// and (x2,y2) of two conjugate diameters. Returns the id of the
+// ellipse.
+//---------------------------------------------------------------------
+int EllipseGrid::Insert(int x0, int y0, int x1, int y1, int x2, int y2)
+{
+    ITEM item = { x0, y0, x1, y1, x2, y2, { 0, 0, 0, 0 },
+                  { 0, 0, 0, 0 }, query, true };
+    int id;
+
+    if (freeIds.empty())
+    {
+        id = items.size();
+        items.push_back(item);
+    }
+    else
+    {
+        id = freeIds.back();
+        freeIds.pop_back();
+        items[id] = item;
+    }
+    Link(id);
+    return id;
+}
+
+//---------------------------------------------------------------------
+// Move function -- Replaces the points that specify ellipse id. The
+// cell lists are updated only if the ellipse moves into a different
+// range of cells, so moving an ellipse by a few pixels each frame
+// is usually just a bounding box calculation. An id that is not in
+// use is ignored.
+//---------------------------------------------------------------------
+void EllipseGrid::Move(int id, int x0, int y0, int x1, int y1, int x2, int y2)
+{
+    if (!IsLive(id))
+        return;
+
+    ITEM& item = items[id];
+    int box[4], cells[4];
+
+    item.x0 = x0;  item.y0 = y0;
+    item.x1 = x1;  item.y1 = y1;
+    item.x2 = x2;  item.y2 = y2;
+    EllipseBox(x0, y0, x1, y1, x2, y2, box);
+    CellRange(box, cells);
+    if (std::equal(cells, cells + 4, item.cells))
+    {
+        std::copy(box, box + 4, item.box);
+        return;
+    }
+    Unlink(id);
+    Link(id);
+}
+
+// Remove function -- Removes ellipse id from the grid. An id that is
+// not in use, such as one that was already removed, is ignored, so
+// that it is not put on the free list twice.
+void EllipseGrid::Remove(int id)
+{
+    if (!IsLive(id))
+        return;
+    Unlink(id);
+    items[id].live = false;
+    freeIds.push_back(id);
+}
+
+//---------------------------------------------------------------------
+// Pick function -- Finds the ellipses that contain point (x,y), as
+// determined by the ellipse's implicit equation (see PointInEllipse).
+// Their ids are written to ids, in increasing order. Returns the
+// number of ellipses found.
+//---------------------------------------------------------------------
+int EllipseGrid::Pick(int x, int y, std::vector<int>& ids)
+{
+    int box[4] = { x, y, x, y };
+    int cells[4];
+
+    ids.clear();
+    CellRange(box, cells);
+    const std::vector<int>& list = cell[cells[1]*ncols + cells[0]];
+    for (size_t i = 0; i < list.size(); i++)
+    {
+        const ITEM& item = items[list[i]];
+
+        if (x < item.box[0] || item.box[2] < x ||
+            y < item.box[1] || item.box[3] < y)
+        {
+            continue;
+        }
+        if (PointInEllipse(item.x0, item.y0, item.x1, item.y1,
+                           item.x2, item.y2, x, y))
+        {
+            ids.push_back(list[i]);
+        }
+    }
+    std::sort(ids.begin(), ids.end());
+    return ids.size();
+}
+
+//---------------------------------------------------------------------
+// Query function -- Finds the ellipses whose bounding boxes overlap
+// rectangle rect, which is specified as {xmin, ymin, xmax, ymax}.
+// Their ids are written to ids, in increasing order. Returns the
+// number of ellipses found.
+//---------------------------------------------------------------------
+int EllipseGrid::Query(const int rect[4], std::vector<int>& ids)
+{
+    int cells[4];
+
+    ids.clear();
+    if (++query == 0)
+    {
+        // Query number wrapped around, so reset all the marks
+        for (size_t i = 0; i < items.size(); i++)
+            items[i].mark = 0;
+        query = 1;
+    }
+    CellRange(rect, cells);
+    for (int cy = cells[1]; cy <= cells[3]; cy++)
+    {
+        for (int cx = cells[0]; cx <= cells[2]; cx++)
+        {
+            const std::vector<int>& list = cell[cy*ncols + cx];
+
+            for (size_t i = 0; i < list.size(); i++)
+            {
+                ITEM& item = items[list[i]];
+
+                if (item.mark == query)
+                    continue;  // already examined in another cell
+                item.mark = query;
+                if (item.box[0] <= rect[2] && rect[0] <= item.box[2] &&
+                    item.box[1] <= rect[3] && rect[1] <= item.box[3])
+                {
+                    ids.push_back(list[i]);
+                }
+            }
+        }
+    }
+    std::sort(ids.begin(), ids.end());
+    return ids.size();
+}
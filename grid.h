@@ -0,0 +1,64 @@
+//---------------------------------------------------------------------
+//
+// grid.h -- Include file for the EllipseGrid spatial index
+//
+//---------------------------------------------------------------------
+
+#ifndef GRID_H
+#define GRID_H
+
+#include <vector>
+#include "conic.h"
+
+// The EllipseGrid class is a spatial index for ellipses that are
+// specified, as for the Ellipse function, by a center point P0 and
+// the end points P1 and P2 of a pair of conjugate diameters. The
+// drawing area is divided into square cells, and each ellipse is
+// listed in every cell that its bounding box overlaps. A point query
+// examines only the ellipses listed in the cell containing the point,
+// and a rectangle query examines only the cells that the rectangle
+// overlaps, so the cost of a query does not depend on the total
+// number of ellipses. Insert, Move, and Remove update only the cells
+// that the ellipse overlaps. Each ellipse is identified by the id
+// that Insert returns; the id of a removed ellipse can be reused.
+// Move and Remove ignore an id that is not in use.
+//
+class EllipseGrid
+{
+public:
+    EllipseGrid(int width, int height, int cellSize);
+    ~EllipseGrid()
+    {
+    }
+    int Insert(int x0, int y0, int x1, int y1, int x2, int y2);
+    void Move(int id, int x0, int y0, int x1, int y1, int x2, int y2);
+    void Remove(int id);
+    int Pick(int x, int y, std::vector<int>& ids);
+    int Query(const int rect[4], std::vector<int>& ids);
+
+private:
+    struct ITEM
+    {
+        int x0, y0, x1, y1, x2, y2;  // P0, P1, and P2
+        int box[4];       // bounding box {xmin, ymin, xmax, ymax}
+        int cells[4];     // range of cells {cxmin, cymin, cxmax, cymax}
+        unsigned mark;    // query number, to avoid duplicate results
+        bool live;        // true if in use; false once removed
+    };
+    int cellSize;         // width and height of a cell, in pixels
+    int ncols, nrows;     // number of columns and rows of cells
+    unsigned query;       // current query number
+    std::vector<ITEM> items;           // ellipses, indexed by id
+    std::vector<int> freeIds;          // ids of removed ellipses
+    std::vector<std::vector<int> > cell;  // ids listed in each cell
+
+    bool IsLive(int id) const
+    {
+        return (0 <= id && id < (int)items.size() && items[id].live);
+    }
+    void CellRange(const int box[4], int cells[4]);
+    void Link(int id);
+    void Unlink(int id);
+};
+
+#endif  // GRID_H
@@ -0,0 +1,188 @@
+//---------------------------------------------------------------------
+//
+// indexed.cpp -- IndexedSurface class member functions
+//
+//---------------------------------------------------------------------
+
+#include <string.h>
+#include <limits.h>
+#include <algorithm>
+#include "indexed.h"
+
+// The SIMD version of Expand is compiled for SSSE3 on x86 processors,
+// with g++ or clang, and is used if the processor supports it
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#define INDEXED_SSSE3
+#include <tmmintrin.h>
+#endif
+
+// Colors that the palette starts with
+static const COLOR s_demoColors[] =
+{
+    BLACK, BLUE, DARKBLUE, DARKGRAY, DARKGREEN, GREEN, GRAY, MAGENTA,
+    ORANGE, RED, WHITE, YELLOW
+};
+
+// Constructor
+IndexedSurface::IndexedSurface(int width, int height) :
+            width(width), height(height), numColors(0)
+{
+    for (size_t i = 0; i < sizeof(s_demoColors)/sizeof(COLOR); i++)
+        Lookup(s_demoColors[i]);
+    color = WHITE;
+    index = Lookup(WHITE);
+    pixels = new unsigned char[width*height];
+    Clear(BLACK);
+}
+
+// Destructor
+IndexedSurface::~IndexedSurface()
+{
+    delete[] pixels;
+}
+
+// Returns the palette entry for color rgb. If there is none, adds one,
+// or if the palette is full, returns the entry whose color is nearest.
+int IndexedSurface::Lookup(COLOR rgb)
+{
+    for (int i = 0; i < numColors; i++)
+    {
+        if (palette[i] == rgb)
+            return i;
+    }
+    if (numColors < MAX_COLORS)
+    {
+        palette[numColors] = rgb;
+        return numColors++;
+    }
+
+    int best = 0, bestDist = INT_MAX;
+
+    for (int i = 0; i < numColors; i++)
+    {
+        int dist = 0;
+
+        for (int shift = 0; shift < 24; shift += 8)
+        {
+            int d = (int)((rgb >> shift) & 255) -
+                    (int)((palette[i] >> shift) & 255);
+            dist += d*d;
+        }
+        if (dist < bestDist)
+        {
+            best = i;
+            bestDist = dist;
+        }
+    }
+    return best;
+}
+
+// Sets every pixel in the surface to color rgb
+void IndexedSurface::Clear(COLOR rgb)
+{
+    memset(pixels, Lookup(rgb), width*height);
+}
+
+// Fills the horizontal span of pixels from (xl,y) to (xr,y), inclusive
+void IndexedSurface::Span(int xl, int xr, int y)
+{
+    if ((unsigned)y >= (unsigned)height)
+        return;
+    if (xl < 0)
+        xl = 0;
+    if (xr >= width)
+        xr = width - 1;
+    if (xl > xr)
+        return;
+    memset(&pixels[y*width + xl], index, xr - xl + 1);
+}
+
+// Fills the rectangle from (xmin,ymin) to (xmax,ymax), inclusive
+void IndexedSurface::FillRect(int xmin, int ymin, int xmax, int ymax)
+{
+    for (int y = ymin; y <= ymax; y++)
+        Span(xmin, xmax, y);
+}
+
+#ifdef INDEXED_SSSE3
+// Expands n pixels at src to dst, 16 at a time, and returns the
+// number expanded. The palette must have at most 16 entries. Each of
+// the four bytes of the palette colors is held in a 16-byte table, so
+// that one shuffle looks up that byte for 16 pixels at once, and the
+// four bytes are then interleaved to form the 16 COLOR values.
+__attribute__((target("ssse3")))
+static int ExpandRow16(const unsigned char *src, COLOR *dst, int n,
+                       const __m128i table[4])
+{
+    int x = 0;
+
+    for (; x + 16 <= n; x += 16)
+    {
+        __m128i v = _mm_loadu_si128((const __m128i *)&src[x]);
+        __m128i r = _mm_shuffle_epi8(table[0], v);
+        __m128i g = _mm_shuffle_epi8(table[1], v);
+        __m128i b = _mm_shuffle_epi8(table[2], v);
+        __m128i a = _mm_shuffle_epi8(table[3], v);
+        __m128i rgLo = _mm_unpacklo_epi8(r, g);
+        __m128i rgHi = _mm_unpackhi_epi8(r, g);
+        __m128i baLo = _mm_unpacklo_epi8(b, a);
+        __m128i baHi = _mm_unpackhi_epi8(b, a);
+        __m128i *p = (__m128i *)&dst[x];
+
+        _mm_storeu_si128(p, _mm_unpacklo_epi16(rgLo, baLo));
+        _mm_storeu_si128(p + 1, _mm_unpackhi_epi16(rgLo, baLo));
+        _mm_storeu_si128(p + 2, _mm_unpacklo_epi16(rgHi, baHi));
+        _mm_storeu_si128(p + 3, _mm_unpackhi_epi16(rgHi, baHi));
+    }
+    return x;
+}
+#endif
+
+//---------------------------------------------------------------------
+// Expand function -- Converts the palette indexes of the pixels in the
+// rectangle from (xmin,ymin) to (xmax,ymax), inclusive, to COLOR
+// values. Pixel (xmin,ymin) is written to dst[0], and each row is
+// pitch pixels after the one above it, so that a rectangle can be
+// expanded in place into a full-size COLOR buffer. This is the only
+// step at which pixels take 32 bits, and it is done only when the
+// surface is presented. When the palette has no more than 16 entries,
+// as it does for the demo colors, and the processor supports SSSE3,
+// 16 pixels are looked up at a time; otherwise, one at a time.
+//---------------------------------------------------------------------
+void IndexedSurface::Expand(int xmin, int ymin, int xmax, int ymax,
+                            COLOR *dst, int pitch) const
+{
+    int n = xmax - xmin + 1;
+
+#ifdef INDEXED_SSSE3
+    __m128i table[4];
+    bool simd = false;
+
+    if (numColors <= 16 && __builtin_cpu_supports("ssse3"))
+    {
+        unsigned char bytes[4][16];
+
+        memset(bytes, 0, sizeof(bytes));
+        for (int i = 0; i < numColors; i++)
+        {
+            for (int k = 0; k < 4; k++)
+                bytes[k][i] = (palette[i] >> 8*k) & 255;
+        }
+        for (int k = 0; k < 4; k++)
+            table[k] = _mm_loadu_si128((const __m128i *)bytes[k]);
+        simd = true;
+    }
+#endif
+    for (int y = ymin; y <= ymax; y++, dst += pitch)
+    {
+        const unsigned char *src = &pixels[y*width + xmin];
+        int x = 0;
+
+#ifdef INDEXED_SSSE3
+        if (simd)
+            x = ExpandRow16(src, dst, n, table);
+#endif
+        for (; x < n; x++)
+            dst[x] = palette[src[x]];
+    }
+}
@@ -0,0 +1,64 @@
+//---------------------------------------------------------------------
+//
+// indexed.h -- Include file for the IndexedSurface class, a software
+//     framebuffer with one byte per pixel and a color palette
+//
+//---------------------------------------------------------------------
+
+#ifndef INDEXED_H
+#define INDEXED_H
+
+#include "demo.h"
+
+// The IndexedSurface class is a software framebuffer that holds one
+// 8-bit palette index per pixel, and so takes a quarter of the memory
+// of a Surface of the same size, and a quarter of the bandwidth to
+// clear. The pixels are stored row by row, like those of a Surface.
+// SetColor selects the palette entry for a COLOR value, adding it to
+// the palette if it is not already there, and Plot, Span, and
+// FillRect draw with that entry. The palette starts with the colors
+// defined in demo.h. Once all MAX_COLORS entries are in use, SetColor
+// selects the nearest entry. To present the surface, Expand converts
+// a rectangle of it to COLOR values that can be copied to the screen.
+//
+class IndexedSurface
+{
+public:
+    enum { MAX_COLORS = 256 };
+
+    unsigned char *pixels;        // width*height indexes, row by row
+    int width, height;            // size in pixels
+    COLOR palette[MAX_COLORS];    // color of each palette entry
+    int numColors;                // number of palette entries in use
+    COLOR color;                  // color selected by SetColor
+    unsigned char index;          // its palette entry
+
+    IndexedSurface(int width, int height);
+    ~IndexedSurface();
+    void SetColor(COLOR rgb)
+    {
+        if (rgb != color)
+        {
+            color = rgb;
+            index = Lookup(rgb);
+        }
+    }
+    void Clear(COLOR rgb);
+    void Plot(int x, int y)
+    {
+        if ((unsigned)x < (unsigned)width && (unsigned)y < (unsigned)height)
+            pixels[y*width + x] = index;
+    }
+    void Span(int xl, int xr, int y);
+    void FillRect(int xmin, int ymin, int xmax, int ymax);
+    void Expand(int xmin, int ymin, int xmax, int ymax,
+                COLOR *dst, int pitch) const;
+
+private:
+    int Lookup(COLOR rgb);
+
+    IndexedSurface(const IndexedSurface&);    // not copyable
+    IndexedSurface& operator=(const IndexedSurface&);
+};
+
+#endif  // INDEXED_H
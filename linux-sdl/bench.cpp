@@ -0,0 +1,1423 @@
+//---------------------------------------------------------------------
+//
+// bench.cpp -- Throughput benchmark for the conic-drawing functions.
+//     Generates a repeatable stress scene, draws it with each of the
+//     drawing methods in turn, and reports curves per second, pixels
+//     per second, and memory use. Checks that each method draws exactly
+//     the same pixels as the plain Conic and Line functions, and
+//     compares drawing into a Surface with drawing into the other
+//     kinds of surface. Can also replay a recording made by a demo,
+//     and compare the results with those of another build. Runs
+//     without a window.
+//
+//---------------------------------------------------------------------
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <limits.h>
+#include <time.h>
+#include <sys/resource.h>
+#include <algorithm>
+#include "conic.h"
+#include "demo.h"
+#include "indexed.h"
+#include "mask.h"
+#include "record.h"
+#include "scene.h"
+#include "tiled.h"
+
+// Surface that the scene is drawn into, and the number of pixels
+// drawn so far
+Surface *g_surface = 0;
+long long g_pixels = 0;
+
+// DrawPixel function is used by Line and Conic functions to set the
+// pixel at drawing coordinates (x,y) to the currently selected color
+//
+void DrawPixel(int x, int y)
+{
+    g_surface->Plot(x, y);
+    g_pixels++;
+}
+
+// Span function that fills a horizontal run of pixels in the surface
+//
+static void SurfaceSpan(int xl, int xr, int y)
+{
+    g_surface->Span(xl, xr, y);
+    g_pixels += xr - xl + 1;
+}
+
+// Span function of the surface being drawn into. It is SurfaceSpan
+// except while TimeTargets draws into another kind of surface.
+static SPANPROC s_span = SurfaceSpan;
+
+// Indexed and tiled surfaces that TimeTargets draws into, or 0
+const int NUM_TILED = 3;
+static IndexedSurface *s_indexed = 0;
+static TiledSurface *s_tiled[NUM_TILED];
+
+// Selects the color of the pixels drawn next, in g_surface and in the
+// other surfaces that have a color. The indexed surface maps it to a
+// palette entry.
+//
+static void SetColor(COLOR rgb)
+{
+    g_surface->color = rgb;
+    if (s_indexed)
+        s_indexed->SetColor(rgb);
+    for (int i = 0; i < NUM_TILED; i++)
+    {
+        if (s_tiled[i])
+            s_tiled[i]->color = rgb;
+    }
+}
+
+// Segments of the curve being drawn by DrawIter
+static std::vector<SEGMENT> s_segs;
+
+static void AddSegment(const SEGMENT *seg)
+{
+    s_segs.push_back(*seg);
+}
+
+// Returns the time from a monotonic, high-resolution timer, in
+// milliseconds
+//
+static double NowMs()
+{
+    timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return 1000.0*ts.tv_sec + ts.tv_nsec/1.0e6;
+}
+
+//---------------------------------------------------------------------
+// Drawing methods. Each one draws every primitive in the display list
+// into g_surface. Primitives that a method has no special way to draw
+// are drawn by DrawPrim.
+//---------------------------------------------------------------------
+
+// Draws each primitive a pixel at a time, with DrawPrim
+//
+static void DrawDirect(const DisplayList& dl)
+{
+    for (size_t i = 0; i < dl.prims.size(); i++)
+    {
+        SetColor(dl.prims[i].color);
+        DrawPrim(dl.prims[i]);
+    }
+}
+
+// Draws each ellipse with LodEllipse, which culls, stamps, or clips
+// it according to its size, and fills stamps a span at a time
+//
+static void DrawLod(const DisplayList& dl)
+{
+    SPANPROC prev = SetSpanProc(s_span);
+
+    SetClipRect(0, 0, g_surface->width - 1, g_surface->height - 1);
+    for (size_t i = 0; i < dl.prims.size(); i++)
+    {
+        const PRIM& prim = dl.prims[i];
+
+        SetColor(prim.color);
+        if (prim.type == PRIM_ELLIPSE)
+            LodEllipse(prim.pt[0].x, prim.pt[0].y, prim.pt[1].x,
+                       prim.pt[1].y, prim.pt[2].x, prim.pt[2].y);
+        else
+            DrawPrim(prim);
+    }
+    SetSpanProc(prev);
+}
+
+// Draws each ellipse with ClippedEllipse, which skips the arcs that
+// lie outside the clip rectangle
+//
+static void DrawClipped(const DisplayList& dl)
+{
+    SetClipRect(0, 0, g_surface->width - 1, g_surface->height - 1);
+    for (size_t i = 0; i < dl.prims.size(); i++)
+    {
+        const PRIM& prim = dl.prims[i];
+
+        SetColor(prim.color);
+        if (prim.type == PRIM_ELLIPSE)
+            ClippedEllipse(prim.pt[0].x, prim.pt[0].y, prim.pt[1].x,
+                           prim.pt[1].y, prim.pt[2].x, prim.pt[2].y);
+        else
+            DrawPrim(prim);
+    }
+}
+
+// Collects the segments of each primitive, and draws them a
+// horizontal run at a time with ConicIter
+//
+static void DrawIter(const DisplayList& dl)
+{
+    SEGMENTPROC prev = SetSegmentProc(AddSegment);
+
+    for (size_t i = 0; i < dl.prims.size(); i++)
+    {
+        const PRIM& prim = dl.prims[i];
+
+        SetColor(prim.color);
+        if (prim.type == PRIM_RECT)
+        {
+            DrawPrim(prim);
+            continue;
+        }
+        s_segs.clear();
+        DrawPrim(prim);
+        for (size_t j = 0; j < s_segs.size(); j++)
+        {
+            ConicIter iter;
+            int xl, xr, y;
+
+            iter.Start(s_segs[j]);
+            while (iter.NextRun(&xl, &xr, &y))
+                s_span(xl, xr, y);
+        }
+    }
+    SetSegmentProc(prev);
+}
+
+// Draws the display list with a Scheduler, with the largest budget
+// it allows, calling Render until the frame is complete
+//
+static void DrawScheduled(const DisplayList& dl)
+{
+    Scheduler sched(g_surface, BLACK);
+
+    sched.budget = INT_MAX;
+    sched.Submit(dl);
+    while (!sched.Done())
+        g_pixels += sched.Render();
+}
+
+// Table of drawing methods
+static const struct
+{
+    const char *name;
+    void (*draw)(const DisplayList& dl);
+}
+s_methods[] =
+{
+    { "direct", DrawDirect },
+    { "lod", DrawLod },
+    { "clipped", DrawClipped },
+    { "iter", DrawIter },
+    { "sched", DrawScheduled }
+};
+
+const int NUM_METHODS = sizeof(s_methods)/sizeof(s_methods[0]);
+
+// Draws only the ellipses, or only the splines, in the display list,
+// a pixel at a time
+//
+static void DrawEllipses(const DisplayList& dl)
+{
+    for (size_t i = 0; i < dl.prims.size(); i++)
+    {
+        if (dl.prims[i].type == PRIM_ELLIPSE)
+        {
+            SetColor(dl.prims[i].color);
+            DrawPrim(dl.prims[i]);
+        }
+    }
+}
+
+static void DrawSplines(const DisplayList& dl)
+{
+    for (size_t i = 0; i < dl.prims.size(); i++)
+    {
+        int type = dl.prims[i].type;
+
+        if (type != PRIM_ELLIPSE && type != PRIM_LINE && type != PRIM_RECT)
+        {
+            SetColor(dl.prims[i].color);
+            DrawPrim(dl.prims[i]);
+        }
+    }
+}
+
+// Draws each ellipse filled, with FillEllipse, which sends each row
+// to the span function. This is not one of the methods above, since
+// it draws different pixels.
+//
+static void DrawFilled(const DisplayList& dl)
+{
+    SPANPROC prev = SetSpanProc(s_span);
+
+    for (size_t i = 0; i < dl.prims.size(); i++)
+    {
+        const PRIM& prim = dl.prims[i];
+
+        SetColor(prim.color);
+        if (prim.type == PRIM_ELLIPSE)
+            FillEllipse(prim.pt[0].x, prim.pt[0].y, prim.pt[1].x,
+                        prim.pt[1].y, prim.pt[2].x, prim.pt[2].y);
+        else
+            DrawPrim(prim);
+    }
+    SetSpanProc(prev);
+}
+
+// Returns a hash of the pixels in the surface, so that the images
+// drawn by different methods, or different builds, can be compared
+//
+static unsigned HashSurface(const Surface *surface)
+{
+    unsigned hash = 2166136261u;  // FNV-1a
+    int n = surface->width*surface->height;
+
+    for (int i = 0; i < n; i++)
+    {
+        hash ^= surface->pixels[i];
+        hash *= 16777619u;
+    }
+    return hash;
+}
+
+// Returns the index in s_methods of the method with the given name,
+// or -1 if there is none
+//
+static int FindMethod(const char *name)
+{
+    for (int m = 0; m < NUM_METHODS; m++)
+    {
+        if (strcmp(name, s_methods[m].name) == 0)
+            return m;
+    }
+    return -1;
+}
+
+//---------------------------------------------------------------------
+// Pixel-exactness check. Every drawing method must set exactly the
+// same pixels as the reference method, DrawDirect, which draws each
+// primitive with the plain Conic and Line functions. The primitives
+// are drawn one at a time, with the reference method into one surface
+// and with each of the other methods into another. The two surfaces
+// are then compared in the tiles that either one wrote to, and those
+// tiles are cleared for the next primitive.
+//---------------------------------------------------------------------
+
+const int TILE_SIZE = Surface::TILE_SIZE;
+
+// Greatest number of differing pixels listed for one primitive
+const int MAX_DIFFS_SHOWN = 8;
+
+// Appends to tiles the index of each tile covered by the dirty
+// rectangles in rects (see Surface::GetDirtyRects) that is not
+// already marked in mark, and marks it
+//
+static void AddTiles(const std::vector<int>& rects, int cols,
+                     std::vector<char>& mark, std::vector<int>& tiles)
+{
+    for (size_t i = 0; i < rects.size(); i += 4)
+    {
+        for (int ty = rects[i+1]/TILE_SIZE; ty <= rects[i+3]/TILE_SIZE; ty++)
+        {
+            for (int tx = rects[i]/TILE_SIZE; tx <= rects[i+2]/TILE_SIZE; tx++)
+            {
+                int t = ty*cols + tx;
+
+                if (!mark[t])
+                {
+                    mark[t] = 1;
+                    tiles.push_back(t);
+                }
+            }
+        }
+    }
+}
+
+// Gets the pixel bounds of tile t, from (*x0,*y0) to (*x1-1,*y1-1)
+//
+static void TileBounds(const Surface *surface, int t, int cols,
+                       int *x0, int *y0, int *x1, int *y1)
+{
+    *x0 = (t % cols)*TILE_SIZE;
+    *y0 = (t / cols)*TILE_SIZE;
+    *x1 = std::min(*x0 + TILE_SIZE, surface->width);
+    *y1 = std::min(*y0 + TILE_SIZE, surface->height);
+}
+
+// Returns a hash of the coordinates of the pixels that are not BLACK
+// in the listed tiles of the surface
+//
+static unsigned HashTiles(const Surface *surface,
+                          const std::vector<int>& tiles, int cols)
+{
+    unsigned hash = 2166136261u;  // FNV-1a
+    int x0, y0, x1, y1;
+
+    for (size_t i = 0; i < tiles.size(); i++)
+    {
+        TileBounds(surface, tiles[i], cols, &x0, &y0, &x1, &y1);
+        for (int y = y0; y < y1; y++)
+        {
+            const COLOR *p = &surface->pixels[y*surface->width];
+
+            for (int x = x0; x < x1; x++)
+            {
+                if (p[x] != BLACK)
+                {
+                    hash = (hash ^ x)*16777619u;
+                    hash = (hash ^ y)*16777619u;
+                }
+            }
+        }
+    }
+    return hash;
+}
+
+// Returns the number of pixels in the listed tiles that differ between
+// surface ref, drawn by the reference method, and surface test. If
+// show is true, prints the first few of them.
+//
+static int CompareTiles(const Surface *ref, const Surface *test,
+                        const std::vector<int>& tiles, int cols, bool show)
+{
+    int width = ref->width;
+    int diffs = 0;
+    int x0, y0, x1, y1;
+
+    for (size_t i = 0; i < tiles.size(); i++)
+    {
+        TileBounds(ref, tiles[i], cols, &x0, &y0, &x1, &y1);
+        for (int y = y0; y < y1; y++)
+        {
+            const COLOR *a = &ref->pixels[y*width];
+            const COLOR *b = &test->pixels[y*width];
+
+            if (memcmp(&a[x0], &b[x0], (x1 - x0)*sizeof(COLOR)) == 0)
+                continue;
+            for (int x = x0; x < x1; x++)
+            {
+                if (a[x] == b[x])
+                    continue;
+                if (show && diffs < MAX_DIFFS_SHOWN)
+                    printf("    (%d,%d) %s\n", x, y,
+                           (a[x] != BLACK) ? "missing" : "extra");
+                diffs++;
+            }
+        }
+    }
+    return diffs;
+}
+
+// Sets the pixels in the listed tiles of the surface to BLACK. The
+// tiles are not marked dirty.
+//
+static void ClearTiles(Surface *surface, const std::vector<int>& tiles,
+                       int cols)
+{
+    int x0, y0, x1, y1;
+
+    for (size_t i = 0; i < tiles.size(); i++)
+    {
+        TileBounds(surface, tiles[i], cols, &x0, &y0, &x1, &y1);
+        for (int y = y0; y < y1; y++)
+        {
+            COLOR *p = &surface->pixels[y*surface->width];
+
+            std::fill(p + x0, p + x1, BLACK);
+        }
+    }
+}
+
+// Prints a display list entry
+//
+static void PrintPrim(int index, const PRIM& prim)
+{
+    printf("  shape %d: type %d, (%d,%d) (%d,%d) (%d,%d)\n", index,
+           prim.type, prim.pt[0].x, prim.pt[0].y, prim.pt[1].x,
+           prim.pt[1].y, prim.pt[2].x, prim.pt[2].y);
+}
+
+//---------------------------------------------------------------------
+// Verify function -- Checks each drawing method against the reference
+// method, one entry of display list dl at a time. Sets failed[m] to
+// the number of entries that method m draws differently, and for the
+// first show of them, prints the entry and the pixels that differ.
+// Sets hashes[i] to a hash of the pixels that the reference method
+// draws for entry i, for comparison with a golden file.
+//---------------------------------------------------------------------
+static void Verify(const DisplayList& dl, int show, int failed[],
+                   std::vector<unsigned>& hashes)
+{
+    Surface *saved = g_surface;
+    Surface ref(DEMO_WIDTH, DEMO_HEIGHT);
+    Surface test(DEMO_WIDTH, DEMO_HEIGHT);
+    int cols = (ref.width + TILE_SIZE - 1)/TILE_SIZE;
+    int rows = (ref.height + TILE_SIZE - 1)/TILE_SIZE;
+    std::vector<char> mark(cols*rows, 0);
+    std::vector<int> rects, refTiles, tiles;
+    DisplayList one;
+
+    ref.Clear(BLACK);
+    test.Clear(BLACK);
+    ref.GetDirtyRects(rects);
+    test.GetDirtyRects(rects);
+    hashes.clear();
+    for (int m = 0; m < NUM_METHODS; m++)
+        failed[m] = 0;
+    for (size_t i = 0; i < dl.prims.size(); i++)
+    {
+        one.prims.assign(1, dl.prims[i]);
+        one.prims[0].color = WHITE;
+        g_surface = &ref;
+        DrawDirect(one);
+        ref.GetDirtyRects(rects);
+        refTiles.clear();
+        AddTiles(rects, cols, mark, refTiles);
+        hashes.push_back(HashTiles(&ref, refTiles, cols));
+        for (int m = 0; m < NUM_METHODS; m++)
+        {
+            if (s_methods[m].draw == DrawDirect)
+                continue;  // the reference method
+            g_surface = &test;
+            s_methods[m].draw(one);
+            test.GetDirtyRects(rects);
+            tiles = refTiles;
+            AddTiles(rects, cols, mark, tiles);
+            if (CompareTiles(&ref, &test, tiles, cols, false) > 0 &&
+                failed[m]++ < show)
+            {
+                printf("Method %s draws differently from %s:\n",
+                       s_methods[m].name, s_methods[0].name);
+                PrintPrim(i, dl.prims[i]);
+                printf("    %d pixels differ\n",
+                       CompareTiles(&ref, &test, tiles, cols, true));
+            }
+            ClearTiles(&test, tiles, cols);
+            for (size_t j = refTiles.size(); j < tiles.size(); j++)
+                mark[tiles[j]] = 0;
+        }
+        ClearTiles(&ref, refTiles, cols);
+        for (size_t j = 0; j < refTiles.size(); j++)
+            mark[refTiles[j]] = 0;
+    }
+    g_surface = saved;
+}
+
+// Sets the pixels in the listed tiles of the surface that lie outside
+// the rectangle from (xmin,ymin) to (xmax,ymax) to BLACK
+//
+static void ClearOutside(Surface *surface, const std::vector<int>& tiles,
+                         int cols, int xmin, int ymin, int xmax, int ymax)
+{
+    int x0, y0, x1, y1;
+
+    for (size_t i = 0; i < tiles.size(); i++)
+    {
+        TileBounds(surface, tiles[i], cols, &x0, &y0, &x1, &y1);
+        for (int y = y0; y < y1; y++)
+        {
+            COLOR *p = &surface->pixels[y*surface->width];
+
+            for (int x = x0; x < x1; x++)
+            {
+                if (x < xmin || x > xmax || y < ymin || y > ymax)
+                    p[x] = BLACK;
+            }
+        }
+    }
+}
+
+// Checks ClippedEllipse with a clip rectangle smaller than the surface,
+// so that many ellipses cross its edges. Each ellipse in display list
+// dl must set exactly the pixels that Ellipse sets inside the clip
+// rectangle. Returns the number of ellipses drawn differently, and
+// prints the first show of them, like Verify.
+//
+static int VerifyClipped(const DisplayList& dl, int show)
+{
+    Surface *saved = g_surface;
+    Surface ref(DEMO_WIDTH, DEMO_HEIGHT);
+    Surface test(DEMO_WIDTH, DEMO_HEIGHT);
+    int cols = (ref.width + TILE_SIZE - 1)/TILE_SIZE;
+    int rows = (ref.height + TILE_SIZE - 1)/TILE_SIZE;
+    int xmin = ref.width/4, ymin = ref.height/4;
+    int xmax = ref.width - xmin - 1, ymax = ref.height - ymin - 1;
+    std::vector<char> mark(cols*rows, 0);
+    std::vector<int> rects, tiles;
+    int failed = 0;
+
+    ref.Clear(BLACK);
+    test.Clear(BLACK);
+    ref.GetDirtyRects(rects);
+    test.GetDirtyRects(rects);
+    ref.color = test.color = WHITE;
+    SetClipRect(xmin, ymin, xmax, ymax);
+    for (size_t i = 0; i < dl.prims.size(); i++)
+    {
+        const PRIM& prim = dl.prims[i];
+
+        if (prim.type != PRIM_ELLIPSE)
+            continue;
+        g_surface = &ref;
+        DrawPrim(prim);
+        g_surface = &test;
+        ClippedEllipse(prim.pt[0].x, prim.pt[0].y, prim.pt[1].x,
+                       prim.pt[1].y, prim.pt[2].x, prim.pt[2].y);
+        tiles.clear();
+        ref.GetDirtyRects(rects);
+        AddTiles(rects, cols, mark, tiles);
+        test.GetDirtyRects(rects);
+        AddTiles(rects, cols, mark, tiles);
+        ClearOutside(&ref, tiles, cols, xmin, ymin, xmax, ymax);
+        if (CompareTiles(&ref, &test, tiles, cols, false) > 0 &&
+            failed++ < show)
+        {
+            printf("ClippedEllipse draws differently from Ellipse in "
+                   "(%d,%d)-(%d,%d):\n", xmin, ymin, xmax, ymax);
+            PrintPrim(i, prim);
+            printf("    %d pixels differ\n",
+                   CompareTiles(&ref, &test, tiles, cols, true));
+        }
+        ClearTiles(&ref, tiles, cols);
+        ClearTiles(&test, tiles, cols);
+        for (size_t j = 0; j < tiles.size(); j++)
+            mark[tiles[j]] = 0;
+    }
+    g_surface = saved;
+    return failed;
+}
+
+// Number of steps for which VerifyBounce compares BounceBatch with
+// Bounce, which is enough for most parallelograms to bounce off each
+// side of the boundary
+const int BOUNCE_STEPS = 300;
+
+// Checks that BounceBatch moves count parallelograms, scattered by
+// Randomize with seed, exactly as the same number of Bounce objects
+// would. Returns the number of parallelograms whose vertexes differ
+// after any of BOUNCE_STEPS steps.
+//
+static int VerifyBounce(int count, unsigned seed)
+{
+    BounceBatch batch(DEMO_WIDTH, DEMO_HEIGHT, count);
+    std::vector<Bounce> bounces(count, Bounce(DEMO_WIDTH, DEMO_HEIGHT));
+    std::vector<char> bad(count, 0);
+    int failed = 0;
+
+    batch.Randomize(seed);
+    for (int i = 0; i < count; i++)
+    {
+        for (int k = 0; k < 4; k++)
+        {
+            bounces[i].pt[k].x = batch.x[k][i];
+            bounces[i].pt[k].y = batch.y[k][i];
+            bounces[i].vpt[k].x = batch.vx[k][i];
+            bounces[i].vpt[k].y = batch.vy[k][i];
+        }
+    }
+    for (int step = 0; step < BOUNCE_STEPS; step++)
+    {
+        batch.Step();
+        for (int i = 0; i < count; i++)
+        {
+            bounces[i].Step();
+            for (int k = 0; k < 4; k++)
+            {
+                if (bounces[i].pt[k].x != batch.x[k][i] ||
+                    bounces[i].pt[k].y != batch.y[k][i])
+                {
+                    failed += !bad[i];
+                    bad[i] = 1;
+                }
+            }
+        }
+    }
+    return failed;
+}
+
+// Prints the number of walks that Pitteway's algorithm stopped early
+// since the last call, and the arguments of the most recent one
+//
+static void ReportWalkStats()
+{
+    WALKSTATS stats;
+
+    GetWalkStats(&stats, true);
+    printf("Walks stopped early: %d missed turns, %d overruns\n",
+           stats.missedTurns, stats.overruns);
+    if (stats.missedTurns + stats.overruns > 0)
+    {
+        const SEGMENT& seg = stats.last;
+
+        printf("  last: arc (%d,%d) to (%d,%d), A-F = %lld %lld %lld "
+               "%lld %lld %lld, stopped at (%d,%d)\n", seg.xs, seg.ys,
+               seg.xe, seg.ye, seg.A, seg.B, seg.C, seg.D, seg.E, seg.F,
+               stats.x, stats.y);
+    }
+}
+
+//---------------------------------------------------------------------
+// Other kinds of surface. Each one is drawn into by a pixel function
+// and a span function, which take the place of DrawPixel and
+// SurfaceSpan, and is checked against g_surface after the same
+// drawing. A surface that can be shown on the screen is presented by
+// converting it to COLOR values in s_frame, as a demo would before
+// copying it to a texture.
+//---------------------------------------------------------------------
+
+// Frame that a surface is presented into
+static std::vector<COLOR> s_frame;
+
+// One-bit coverage mask
+static MaskSurface *s_mask = 0;
+
+static void MaskPixel(int x, int y)
+{
+    s_mask->Plot(x, y);
+    g_pixels++;
+}
+
+static void MaskSpan(int xl, int xr, int y)
+{
+    s_mask->Span(xl, xr, y);
+    g_pixels += xr - xl + 1;
+}
+
+// Returns the number of pixels whose bit in the mask does not match
+// whether the pixel in g_surface has been drawn
+//
+static long long CompareMask()
+{
+    long long diffs = 0;
+
+    for (int y = 0; y < g_surface->height; y++)
+    {
+        const COLOR *p = &g_surface->pixels[y*g_surface->width];
+
+        for (int x = 0; x < g_surface->width; x++)
+            diffs += (p[x] != BLACK) != s_mask->Get(x, y);
+    }
+    return diffs;
+}
+
+static void ClearMask()
+{
+    s_mask->Clear();
+}
+
+static size_t MaskBytes()
+{
+    return (size_t)s_mask->stride*s_mask->height*sizeof(MaskSurface::WORD);
+}
+
+// One byte per pixel, with a palette
+static void IndexedPixel(int x, int y)
+{
+    s_indexed->Plot(x, y);
+    g_pixels++;
+}
+
+static void IndexedSpan(int xl, int xr, int y)
+{
+    s_indexed->Span(xl, xr, y);
+    g_pixels += xr - xl + 1;
+}
+
+static void ClearIndexed()
+{
+    s_indexed->Clear(BLACK);
+}
+
+static void PresentIndexed()
+{
+    s_indexed->Expand(0, 0, s_indexed->width - 1, s_indexed->height - 1,
+                      &s_frame[0], s_indexed->width);
+}
+
+// Returns the number of pixels in the presented frame that differ
+// from those in g_surface
+//
+static long long CompareFrame()
+{
+    long long diffs = 0;
+
+    for (size_t i = 0; i < s_frame.size(); i++)
+        diffs += s_frame[i] != g_surface->pixels[i];
+    return diffs;
+}
+
+static long long CompareIndexed()
+{
+    PresentIndexed();
+    return CompareFrame();
+}
+
+static size_t IndexedBytes()
+{
+    return (size_t)s_indexed->width*s_indexed->height;
+}
+
+// Tiled surfaces, one for each entry of s_tiled
+template <int N> static void TiledPixel(int x, int y)
+{
+    s_tiled[N]->Plot(x, y);
+    g_pixels++;
+}
+
+template <int N> static void TiledSpan(int xl, int xr, int y)
+{
+    s_tiled[N]->Span(xl, xr, y);
+    g_pixels += xr - xl + 1;
+}
+
+template <int N> static void ClearTiled()
+{
+    s_tiled[N]->Clear(BLACK);
+}
+
+template <int N> static void PresentTiled()
+{
+    s_tiled[N]->Detile(0, 0, s_tiled[N]->width - 1, s_tiled[N]->height - 1,
+                       &s_frame[0], s_tiled[N]->width);
+}
+
+template <int N> static long long CompareTiled()
+{
+    PresentTiled<N>();
+    return CompareFrame();
+}
+
+template <int N> static size_t TiledBytes()
+{
+    const TiledSurface *t = s_tiled[N];
+
+    return ((size_t)t->tileCols*t->tileRows << 2*t->tileShift)*sizeof(COLOR);
+}
+
+// Functions for g_surface itself, the reference surface
+static void ClearSurface()
+{
+    g_surface->Clear(BLACK);
+}
+
+static void PresentSurface()
+{
+    memcpy(&s_frame[0], g_surface->pixels, s_frame.size()*sizeof(COLOR));
+}
+
+static size_t SurfaceBytes()
+{
+    return (size_t)g_surface->width*g_surface->height*sizeof(COLOR);
+}
+
+// Table of kinds of surface. The first is g_surface, which the others
+// are compared with.
+static const struct
+{
+    const char *name;
+    PIXELPROC plot;            // pixel function
+    SPANPROC span;             // span function
+    void (*clear)();           // clears the surface
+    void (*present)();         // presents it in s_frame, or 0 if none
+    long long (*compare)();    // counts pixels that differ from g_surface
+    size_t (*bytes)();         // returns size of the pixels, in bytes
+}
+s_targets[] =
+{
+    { "color", DrawPixel, SurfaceSpan, ClearSurface, PresentSurface, 0,
+      SurfaceBytes },
+    { "mask", MaskPixel, MaskSpan, ClearMask, 0, CompareMask, MaskBytes },
+    { "indexed", IndexedPixel, IndexedSpan, ClearIndexed, PresentIndexed,
+      CompareIndexed, IndexedBytes },
+    { "tile8", TiledPixel<0>, TiledSpan<0>, ClearTiled<0>, PresentTiled<0>,
+      CompareTiled<0>, TiledBytes<0> },
+    { "tile32", TiledPixel<1>, TiledSpan<1>, ClearTiled<1>, PresentTiled<1>,
+      CompareTiled<1>, TiledBytes<1> },
+    { "morton8", TiledPixel<2>, TiledSpan<2>, ClearTiled<2>,
+      PresentTiled<2>, CompareTiled<2>, TiledBytes<2> }
+};
+
+const int NUM_TARGETS = sizeof(s_targets)/sizeof(s_targets[0]);
+
+// Drawing methods used by TimeTargets: pixels from Line and Conic, for
+// the whole scene, its ellipses, and its splines; runs from ConicIter;
+// and filled ellipses
+static const struct
+{
+    const char *name;
+    void (*draw)(const DisplayList& dl);
+}
+s_workloads[] =
+{
+    { "direct", DrawDirect },
+    { "ellipse", DrawEllipses },
+    { "spline", DrawSplines },
+    { "iter", DrawIter },
+    { "fill", DrawFilled }
+};
+
+const int NUM_WORKLOADS = sizeof(s_workloads)/sizeof(s_workloads[0]);
+
+//---------------------------------------------------------------------
+// TimeTargets function -- Draws display list dl repeat times into
+// each kind of surface with each of the workloads, and reports the
+// time taken to clear the surface, to draw the scene, and to present
+// it, and the size of the surface. After each workload, checks that
+// each of the other surfaces holds the same image as g_surface.
+// Returns the number of surfaces and workloads whose image differs.
+//---------------------------------------------------------------------
+static int TimeTargets(const DisplayList& dl, int repeat)
+{
+    int failed = 0;
+    MaskSurface mask(g_surface->width, g_surface->height);
+    IndexedSurface indexed(g_surface->width, g_surface->height);
+    TiledSurface tile8(g_surface->width, g_surface->height, 3, false);
+    TiledSurface tile32(g_surface->width, g_surface->height, 5, false);
+    TiledSurface morton8(g_surface->width, g_surface->height, 3, true);
+    PIXELPROC prev = SetPixelProc(DrawPixel);
+
+    s_mask = &mask;
+    s_indexed = &indexed;
+    s_tiled[0] = &tile8;
+    s_tiled[1] = &tile32;
+    s_tiled[2] = &morton8;
+    s_frame.resize(g_surface->width*g_surface->height);
+    printf("%-8s %-8s %9s %9s %10s %14s %8s %10s %8s\n", "target",
+           "workload", "clear ms", "ms/pass", "present ms", "pixels/s",
+           "KB", "same", "speedup");
+    for (int w = 0; w < NUM_WORKLOADS; w++)
+    {
+        double refMs = 0;
+
+        for (int k = 0; k < NUM_TARGETS; k++)
+        {
+            double clearMs = 0, ms = 0, presentMs = 0, t;
+
+            SetPixelProc(s_targets[k].plot);
+            s_span = s_targets[k].span;
+            g_pixels = 0;
+            for (int pass = 0; pass < repeat; pass++)
+            {
+                t = NowMs();
+                s_targets[k].clear();
+                clearMs += NowMs() - t;
+                t = NowMs();
+                s_workloads[w].draw(dl);
+                ms += NowMs() - t;
+                if (s_targets[k].present)
+                {
+                    t = NowMs();
+                    s_targets[k].present();
+                    presentMs += NowMs() - t;
+                }
+            }
+
+            double secs = (ms > 0) ? ms/1000 : 1e-9;
+            char same[16], speedup[16], present[16];
+            long long diffs = 0;
+
+            if (k == 0)
+            {
+                refMs = ms;
+                strcpy(same, "reference");
+            }
+            else
+            {
+                diffs = s_targets[k].compare();
+                if (diffs == 0)
+                    strcpy(same, "yes");
+                else
+                {
+                    sprintf(same, "%lld bad", diffs);
+                    failed++;
+                }
+            }
+            if (diffs == 0 && ms > 0)
+                sprintf(speedup, "%.2fx", refMs/ms);
+            else
+                strcpy(speedup, "-");
+            if (s_targets[k].present)
+                sprintf(present, "%.3f", presentMs/repeat);
+            else
+                strcpy(present, "-");
+            printf("%-8s %-8s %9.3f %9.2f %10s %14.0f %8lu %10s %8s\n",
+                   s_targets[k].name, s_workloads[w].name,
+                   clearMs/repeat, ms/repeat, present, g_pixels/secs,
+                   (unsigned long)(s_targets[k].bytes()/1024), same,
+                   speedup);
+        }
+    }
+    SetPixelProc(prev);
+    s_span = SurfaceSpan;
+    s_mask = 0;
+    s_indexed = 0;
+    for (int i = 0; i < NUM_TILED; i++)
+        s_tiled[i] = 0;
+    return failed;
+}
+
+// Number of animation frames that TimeBounce draws per pass
+const int BOUNCE_FRAMES = 20;
+
+//---------------------------------------------------------------------
+// TimeBounce function -- Animates count parallelograms with a
+// BounceBatch, scattered by Randomize with seed, as a stress test of
+// the path from animation to pixels. Each frame steps the batch, gets
+// the inscribed ellipses, culls them against a viewport in the middle
+// of the surface with CullConics, and draws the visible ones, first
+// with Ellipse and then with LodEllipse. Reports the time per frame
+// for each stage, and checks that both drawing functions produce the
+// same image in every frame. Returns the number of frames that differ.
+//---------------------------------------------------------------------
+static int TimeBounce(int count, unsigned seed, int repeat)
+{
+    int w = g_surface->width, h = g_surface->height;
+    int rect[4] = { w/4, h/4, w - w/4 - 1, h - h/4 - 1 };
+    BounceBatch batch(w, h, count);
+    std::vector<int> x0(count), y0(count), x1(count), y1(count);
+    std::vector<int> x2(count), y2(count), index(count);
+    int frames = BOUNCE_FRAMES*repeat, diffs = 0;
+    double stepMs = 0, cullMs = 0, drawMs[2] = { 0, 0 }, t;
+    long long visible = 0;
+    unsigned hash[2] = { 0, 0 };
+    SPANPROC prev = SetSpanProc(s_span);
+
+    if (count == 0)
+        return 0;
+    batch.Randomize(seed);
+    SetClipRect(0, 0, w - 1, h - 1);
+    for (int frame = 0; frame < frames; frame++)
+    {
+        int n;
+
+        t = NowMs();
+        batch.Step();
+        stepMs += NowMs() - t;
+        t = NowMs();
+        batch.GetEllipses(&x0[0], &y0[0], &x1[0], &y1[0], &x2[0], &y2[0]);
+        n = CullConics(CONIC_ELLIPSE, &x0[0], &y0[0], &x1[0], &y1[0],
+                       &x2[0], &y2[0], count, rect, &index[0]);
+        cullMs += NowMs() - t;
+        visible += n;
+        for (int m = 0; m < 2; m++)
+        {
+            g_surface->Clear(BLACK);
+            SetColor(WHITE);
+            t = NowMs();
+            for (int j = 0; j < n; j++)
+            {
+                int i = index[j];
+
+                if (m == 0)
+                    Ellipse(x0[i], y0[i], x1[i], y1[i], x2[i], y2[i]);
+                else
+                    LodEllipse(x0[i], y0[i], x1[i], y1[i], x2[i], y2[i]);
+            }
+            drawMs[m] += NowMs() - t;
+            hash[m] = HashSurface(g_surface);
+        }
+        diffs += (hash[0] != hash[1]);
+    }
+    SetSpanProc(prev);
+    printf("Bounce: %d parallelograms, %d frames, %.0f ellipses per "
+           "frame in the viewport (%d,%d)-(%d,%d)\n", count, frames,
+           (double)visible/frames, rect[0], rect[1], rect[2], rect[3]);
+    printf("%-8s %10s %14s\n", "stage", "ms/frame", "ellipses/s");
+    printf("%-8s %10.3f %14.0f\n", "step", stepMs/frames,
+           (stepMs > 0) ? (double)count*frames*1000/stepMs : 0);
+    printf("%-8s %10.3f %14.0f\n", "cull", cullMs/frames,
+           (cullMs > 0) ? (double)count*frames*1000/cullMs : 0);
+    printf("%-8s %10.3f %14.0f\n", "ellipse", drawMs[0]/frames,
+           (drawMs[0] > 0) ? visible*1000/drawMs[0] : 0);
+    printf("%-8s %10.3f %14.0f\n", "lod", drawMs[1]/frames,
+           (drawMs[1] > 0) ? visible*1000/drawMs[1] : 0);
+    printf("LodEllipse and Ellipse draw different images in %d of %d "
+           "frames\n", diffs, frames);
+    return diffs;
+}
+
+// Results for one frame of a recording
+struct FRAMERESULT
+{
+    long long pixels;    // number of pixels drawn
+    double ms;           // drawing time, in milliseconds
+    unsigned hash;       // hash of the surface after the frame
+};
+
+//---------------------------------------------------------------------
+// Replay function -- Draws each frame of the recording in file path,
+// as fast as possible, with the named method. The sched method draws
+// each frame as the demos do, submitting its display list to the same
+// scheduler as the frame before it, but with no limit on the number
+// of pixels per call; the other methods clear the surface and draw
+// the whole frame. Reports the drawing time per frame. If outPath is
+// not 0, writes the pixel count, drawing time, and image hash of each
+// frame to the file outPath. If cmpPath is not 0, compares the
+// results with those in the file cmpPath, written by an earlier run
+// (for example, of a different build), and reports the frames whose
+// images differ, and the change in drawing time. Returns the program
+// exit code: 0 if the images all match, and 1 otherwise.
+//---------------------------------------------------------------------
+static int Replay(const char *path, const char *method,
+                  const char *outPath, const char *cmpPath)
+{
+    Player player;
+    DisplayList dl;
+    std::vector<FRAMERESULT> results;
+    long long curves = 0, pixels = 0;
+    double total = 0, worst = 0;
+    int m = FindMethod(method);
+    int retval = 0;
+
+    if (m < 0)
+    {
+        fprintf(stderr, "Unknown method %s\n", method);
+        return 1;
+    }
+    if (!player.Open(path))
+    {
+        fprintf(stderr, "Cannot read recording %s\n", path);
+        return 1;
+    }
+    g_surface = new Surface(player.width, player.height);
+    g_surface->Clear(BLACK);
+
+    Scheduler sched(g_surface, BLACK);
+
+    sched.budget = INT_MAX;
+    while (player.Read(&dl))
+    {
+        FRAMERESULT res;
+        double t = NowMs();
+
+        g_pixels = 0;
+        if (strcmp(method, "sched") == 0)
+        {
+            sched.Submit(dl);
+            while (!sched.Done())
+                g_pixels += sched.Render();
+        }
+        else
+        {
+            g_surface->Clear(BLACK);
+            s_methods[m].draw(dl);
+        }
+        res.ms = NowMs() - t;
+        res.pixels = g_pixels;
+        res.hash = HashSurface(g_surface);
+        results.push_back(res);
+        curves += dl.prims.size();
+        pixels += res.pixels;
+        total += res.ms;
+        if (res.ms > worst)
+            worst = res.ms;
+    }
+    if (player.Failed())
+    {
+        fprintf(stderr, "Recording %s is damaged after frame %d\n", path,
+                (int)results.size());
+        retval = 1;
+    }
+
+    int frames = results.size();
+    double secs = (total > 0) ? total/1000 : 1e-9;
+
+    printf("Replay: %d frames of %s, %dx%d, method %s\n", frames, path,
+           player.width, player.height, method);
+    if (frames > 0)
+    {
+        printf("Time: %.1f ms, mean %.3f ms/frame, worst %.3f ms\n",
+               total, total/frames, worst);
+        printf("Throughput: %.0f curves/s, %.0f pixels/s\n",
+               curves/secs, pixels/secs);
+    }
+    ReportWalkStats();
+    if (outPath)
+    {
+        FILE *fp = fopen(outPath, "w");
+
+        if (fp == 0)
+        {
+            fprintf(stderr, "Cannot create %s\n", outPath);
+            retval = 1;
+        }
+        else
+        {
+            for (int i = 0; i < frames; i++)
+                fprintf(fp, "%d %lld %.4f %08x\n", i, results[i].pixels,
+                        results[i].ms, results[i].hash);
+            fclose(fp);
+        }
+    }
+    if (cmpPath)
+    {
+        FILE *fp = fopen(cmpPath, "r");
+        FRAMERESULT res;
+        double oldTotal = 0;
+        int i, n = 0, diffs = 0;
+
+        if (fp == 0)
+        {
+            fprintf(stderr, "Cannot read %s\n", cmpPath);
+            delete g_surface;
+            return 1;
+        }
+        while (fscanf(fp, "%d %lld %lf %x", &i, &res.pixels, &res.ms,
+                      &res.hash) == 4 && i == n && n < frames)
+        {
+            oldTotal += res.ms;
+            if (res.hash != results[n].hash)
+            {
+                if (++diffs <= 10)
+                    printf("Frame %d differs: hash %08x, was %08x\n", n,
+                           results[n].hash, res.hash);
+            }
+            n++;
+        }
+        fclose(fp);
+        if (n != frames)
+        {
+            printf("%s has results for %d frames, not %d\n", cmpPath, n,
+                   frames);
+            retval = 1;
+        }
+        printf("Compared %d frames: %d differ", n, diffs);
+        if (oldTotal > 0)
+        {
+            double newTotal = 0;
+
+            for (i = 0; i < n; i++)
+                newTotal += results[i].ms;
+            printf(", time %.1f ms, was %.1f ms (%+.1f%%)", newTotal,
+                   oldTotal, 100*(newTotal - oldTotal)/oldTotal);
+        }
+        printf("\n");
+        if (diffs > 0)
+            retval = 1;
+    }
+    delete g_surface;
+    return retval;
+}
+
+static void Usage()
+{
+    fprintf(stderr,
+        "Usage: bench [options]\n"
+        "  -n count    number of shapes (default 10000)\n"
+        "  -s seed     random number seed (default 1)\n"
+        "  -min size   smallest size, in pixels (default 2)\n"
+        "  -max size   largest size, in pixels (default 256)\n"
+        "  -uniform    spread sizes evenly, instead of each doubling\n"
+        "              of size being equally likely\n"
+        "  -w k=n      set weight of shape kind k (0 to %d) to n\n"
+        "  -r repeat   number of times to draw the scene (default 5)\n"
+        "  -m method   time this method only, and the reference method\n"
+        "  -v n        list the pixels that differ for the first n\n"
+        "              shapes that a method draws differently\n"
+        "  -o file     write a hash of the pixels of each shape, as\n"
+        "              drawn by the reference method, to a golden file\n"
+        "  -c file     compare the pixels of each shape with a golden\n"
+        "              file written by -o\n"
+        "  -replay file  draw the frames recorded by a demo, with the\n"
+        "              sched method unless -m is given; with this\n"
+        "              option, -o and -c write and compare the results\n"
+        "              of each frame\n",
+        SCENE_KINDS - 1);
+    exit(1);
+}
+
+int main(int argc, char* argv[])
+{
+    SCENEPARAMS params;
+    DisplayList dl;
+    const char *only = 0;
+    const char *replayPath = 0;
+    const char *outPath = 0;
+    const char *cmpPath = 0;
+    int repeat = 5;
+    int show = 0;
+    int kind, weight, clipFailed, bounceFailed;
+    int failed[NUM_METHODS];
+    double refMs = 0;
+    std::vector<unsigned> hashes;
+    WALKSTATS walks;
+    int retval = 0;
+
+    DefaultSceneParams(&params);
+    for (int i = 1; i < argc; i++)
+    {
+        const char *arg = argv[i];
+        const char *val = (i + 1 < argc) ? argv[i+1] : 0;
+
+        if (strcmp(arg, "-uniform") == 0)
+        {
+            params.sizeDist = SIZE_UNIFORM;
+            continue;
+        }
+        if (val == 0)
+            Usage();
+        i++;
+        if (strcmp(arg, "-n") == 0)
+            params.count = atoi(val);
+        else if (strcmp(arg, "-s") == 0)
+            params.seed = strtoul(val, 0, 0);
+        else if (strcmp(arg, "-min") == 0)
+            params.minSize = atoi(val);
+        else if (strcmp(arg, "-max") == 0)
+            params.maxSize = atoi(val);
+        else if (strcmp(arg, "-r") == 0)
+            repeat = atoi(val);
+        else if (strcmp(arg, "-v") == 0)
+            show = atoi(val);
+        else if (strcmp(arg, "-m") == 0 && FindMethod(val) >= 0)
+            only = val;
+        else if (strcmp(arg, "-replay") == 0)
+            replayPath = val;
+        else if (strcmp(arg, "-o") == 0)
+            outPath = val;
+        else if (strcmp(arg, "-c") == 0)
+            cmpPath = val;
+        else if (strcmp(arg, "-w") == 0 &&
+                 sscanf(val, "%d=%d", &kind, &weight) == 2 &&
+                 kind >= 0 && kind < SCENE_KINDS && weight >= 0)
+            params.weight[kind] = weight;
+        else
+            Usage();
+    }
+    if (params.count < 0 || repeat < 1)
+        Usage();
+    if (replayPath)
+        return Replay(replayPath, only ? only : "sched", outPath, cmpPath);
+
+    double t = NowMs();
+    GenerateScene(&params, &dl);
+    t = NowMs() - t;
+    printf("Scene: %d shapes, seed %u, sizes %d to %d (%s), "
+           "generated in %.1f ms\n", params.count, params.seed,
+           params.minSize, params.maxSize,
+           (params.sizeDist == SIZE_LOG) ? "log" : "uniform", t);
+
+    t = NowMs();
+    GetWalkStats(&walks, true);  // reset the counts
+    Verify(dl, show, failed, hashes);
+    printf("Checked each method against %s in %.1f ms\n",
+           s_methods[0].name, NowMs() - t);
+    for (int m = 1; m < NUM_METHODS; m++)
+    {
+        if (failed[m] > 0)
+            retval = 1;
+    }
+    t = NowMs();
+    clipFailed = VerifyClipped(dl, show);
+    printf("Checked ClippedEllipse in a smaller clip rectangle in %.1f ms: "
+           "%d ellipses differ\n", NowMs() - t, clipFailed);
+    if (clipFailed > 0)
+        retval = 1;
+    t = NowMs();
+    bounceFailed = VerifyBounce(params.count, params.seed);
+    printf("Checked BounceBatch against Bounce in %.1f ms: "
+           "%d parallelograms differ\n", NowMs() - t, bounceFailed);
+    if (bounceFailed > 0)
+        retval = 1;
+    ReportWalkStats();
+    if (outPath)
+    {
+        FILE *fp = fopen(outPath, "w");
+
+        if (fp == 0)
+        {
+            fprintf(stderr, "Cannot create %s\n", outPath);
+            return 1;
+        }
+        for (size_t i = 0; i < hashes.size(); i++)
+            fprintf(fp, "%d %08x\n", (int)i, hashes[i]);
+        fclose(fp);
+    }
+    if (cmpPath)
+    {
+        FILE *fp = fopen(cmpPath, "r");
+        unsigned hash;
+        int i, n = 0, diffs = 0;
+
+        if (fp == 0)
+        {
+            fprintf(stderr, "Cannot read %s\n", cmpPath);
+            return 1;
+        }
+        while (n < (int)hashes.size() &&
+               fscanf(fp, "%d %x", &i, &hash) == 2 && i == n)
+        {
+            if (hash != hashes[n] && ++diffs <= show)
+            {
+                printf("Shape %d differs from golden file:\n", n);
+                PrintPrim(n, dl.prims[n]);
+            }
+            n++;
+        }
+        fclose(fp);
+        if (n != (int)hashes.size())
+            printf("%s has hashes for %d shapes, not %d\n", cmpPath, n,
+                   (int)hashes.size());
+        printf("Golden file: %d of %d shapes differ\n", diffs, n);
+        if (diffs > 0 || n != (int)hashes.size())
+            retval = 1;
+    }
+
+    // Time the methods. A speedup over the reference method is shown
+    // only for a method that draws exactly the same pixels.
+    g_surface = new Surface(DEMO_WIDTH, DEMO_HEIGHT);
+    printf("%-8s %10s %12s %14s %10s %10s %8s\n", "method", "ms/pass",
+           "curves/s", "pixels/s", "hash", "exact", "speedup");
+    for (int m = 0; m < NUM_METHODS; m++)
+    {
+        if (only && m > 0 && strcmp(only, s_methods[m].name) != 0)
+            continue;
+
+        double ms = 0;
+
+        g_pixels = 0;
+        for (int pass = 0; pass < repeat; pass++)
+        {
+            g_surface->Clear(BLACK);
+            t = NowMs();
+            s_methods[m].draw(dl);
+            ms += NowMs() - t;
+        }
+
+        double secs = (ms > 0) ? ms/1000 : 1e-9;
+        char exact[16], speedup[16];
+
+        if (m == 0)
+        {
+            refMs = ms;
+            strcpy(exact, "reference");
+        }
+        else if (failed[m] == 0)
+            strcpy(exact, "yes");
+        else
+            sprintf(exact, "%d bad", failed[m]);
+        if (failed[m] == 0 && ms > 0)
+            sprintf(speedup, "%.2fx", refMs/ms);
+        else
+            strcpy(speedup, "-");
+        printf("%-8s %10.2f %12.0f %14.0f %10x %10s %8s\n",
+               s_methods[m].name, ms/repeat,
+               (double)params.count*repeat/secs, g_pixels/secs,
+               HashSurface(g_surface), exact, speedup);
+    }
+    if (TimeTargets(dl, repeat) > 0)
+        retval = 1;
+    if (TimeBounce(params.count, params.seed, repeat) > 0)
+        retval = 1;
+
+    rusage usage;
+
+    getrusage(RUSAGE_SELF, &usage);
+    printf("Memory: scene %lu KB, surface %lu KB, peak resident %ld KB\n",
+           (unsigned long)(dl.prims.capacity()*sizeof(PRIM)/1024),
+           (unsigned long)((size_t)g_surface->width*g_surface->height*
+                           sizeof(COLOR)/1024),
+           usage.ru_maxrss);
+    delete g_surface;
+    return retval;
+}
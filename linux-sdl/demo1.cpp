@@ -10,117 +10,96 @@
 #include <stdio.h>
 #include <math.h> 
 #include <assert.h>
+#include <string.h>
 #include "conic.h"
 #include "demo.h"
+#include "record.h"
+#include "sched.h"
+#include "simclock.h"
+#include "tribuf.h"
 
-// Global renderer and color values used by the DrawPixel function
+// Global renderer, and the software framebuffer into which the
+// scheduler draws each frame
 SDL_Renderer *g_renderer = 0;
+Surface *g_surface = 0;
 
 // DrawPixel function is used by Line and Conic functions to set the
 // pixel at drawing coordinates (x,y) to the currently selected color
 //
 void DrawPixel(int x, int y)
 {
-    SDL_RenderDrawPoint(g_renderer, x, y);
+    g_surface->Plot(x, y);
 }
 
-// SetColor function is used by the functions in this module to
-// specify the color to use for subsequent drawing operations
+// Returns the time from a monotonic, high-resolution timer, in
+// milliseconds
 //
-inline void SetColor(COLOR rgb)
+double NowMs()
 {
-    Uint8 r = rgb & 255;
-    Uint8 g = (rgb >> 8) & 255;
-    Uint8 b = (rgb >> 16) & 255;
+    return 1000.0*SDL_GetPerformanceCounter()/SDL_GetPerformanceFrequency();
+}
+
+// Copies the rectangles in rects, which holds four values {xmin, ymin,
+// xmax, ymax} per rectangle, from framebuffer pixels to texture
+//
+void UploadRects(SDL_Texture *texture, const COLOR *pixels,
+                 const std::vector<int>& rects)
+{
+    int width = g_surface->width;
+
+    for (size_t i = 0; i < rects.size(); i += 4)
+    {
+        const int *r = &rects[i];
+        SDL_Rect rect = { r[0], r[1], r[2] - r[0] + 1, r[3] - r[1] + 1 };
+
+        SDL_UpdateTexture(texture, &rect, &pixels[r[1]*width + r[0]],
+                          width*sizeof(COLOR));
+    }
+}
+
+// Copies the tiles of the framebuffer that have changed since the
+// previous call to texture, rather than the whole framebuffer
+//
+void UpdateDirtyTiles(SDL_Texture *texture)
+{
+    static std::vector<int> rects;
 
-    SDL_SetRenderDrawColor(g_renderer, r, g, b, SDL_ALPHA_OPAQUE);
+    g_surface->GetDirtyRects(rects);
+    UploadRects(texture, g_surface->pixels, rects);
 }
 
-// Draws the minimum bounding box for an ellipse given the center
-// point (x0,y0) of the ellipse and the end points (x1,y1) and 
-// (x2,y2) of two conjugate diameters of the ellipse.
-void BoundingBox(int x0, int y0, int x1, int y1, int x2, int y2)
+// Adds the minimum bounding box for an ellipse to display list dl,
+// given the center point (x0,y0) of the ellipse and the end points
+// (x1,y1) and (x2,y2) of two conjugate diameters of the ellipse.
+void BoundingBox(DisplayList *dl, COLOR color,
+                 int x0, int y0, int x1, int y1, int x2, int y2)
 {
-    float xp, yp, xq, yq;
-    int xbox, ybox;
-    SDL_Rect bbox;
-
-    // Translate center of ellipse to origin
-    xp = x1 - x0;
-    yp = y1 - y0;
-    xq = x2 - x0;
-    yq = y2 - y0;
-    xbox = sqrt(xp*xp + xq*xq) + 0.5;
-    ybox = sqrt(yp*yp + yq*yq) + 0.5;
-    bbox.x = x0-xbox;
-    bbox.y = y0-ybox;
-    bbox.w = 2*xbox + 1;
-    bbox.h = 2*ybox + 1;
-    SDL_RenderFillRect(g_renderer, &bbox);
+    int box[4];
+
+    EllipseBox(x0, y0, x1, y1, x2, y2, box);
+    dl->Add(PRIM_RECT, color, box[0], box[1], box[2], box[3]);
 }
 
-// Draws the enclosing polygon for an ellipse given the center
-// point (x0,y0) of the ellipse and the end points (x1,y1) and 
-// (x2,y2) of two conjugate diameters of the ellipse. The polygon
+// Adds the enclosing polygon for an ellipse to display list dl,
+// given the center point (x0,y0) of the ellipse and the end points
+// (x1,y1) and (x2,y2) of two conjugate diameters of the ellipse. The polygon
 // has 8 sides: two opposing sides are vertical, two are hori-
 // zontal, two are +45-degree diagonals, and two are -45-degree
 // diagonals. Each side of the polygon touches the ellipse at
 // exactly one point, at which the side is tangent to the ellipse.
-void BoundingPgon(int x0, int y0, int x1, int y1, int x2, int y2)
+void BoundingPgon(DisplayList *dl, COLOR color,
+                  int x0, int y0, int x1, int y1, int x2, int y2)
 {
-    float xp, yp, xq, yq;
-    float tmp1, tmp2;
-    float X, Y, Z, W, U, V;
-    SDL_Point xy[9];
-
-    // Translate center of ellipse to origin
-    xp = x1 - x0;
-    yp = y1 - y0;
-    xq = x2 - x0;
-    yq = y2 - y0;
-
-    // Compute vertexes of bounding polygon
-    X = sqrt(xp*xp + xq*xq);
-    Y = sqrt(yp*yp + yq*yq);
-    tmp1 = xp + yp;
-    tmp2 = xq + yq;
-    Z = sqrt(tmp1*tmp1+tmp2*tmp2);
-    tmp1 = xp - yp;
-    tmp2 = xq - yq;
-    W = sqrt(tmp1*tmp1+tmp2*tmp2);
-
-    xy[0].x = x0 + 0.5 + X;
-    xy[0].y = y0 + 0.5 - X + Z;
+    XYVAL xy[9];
 
-    xy[1].x = x0 + 0.5 - Y + Z;
-    xy[1].y = y0 + 0.5 + Y;
-
-    xy[2].x = x0 + 0.5 + Y - W;
-    xy[2].y = y0 + 0.5 + Y;
-
-    xy[3].x = x0 + 0.5 - X;
-    xy[3].y = y0 + 0.5 - X + W;
-
-    xy[4].x = x0 + 0.5 - X;
-    xy[4].y = y0 + 0.5 + X - Z;
-
-    xy[5].x = x0 + 0.5 + Y - Z;
-    xy[5].y = y0 + 0.5 - Y;
-
-    xy[6].x = x0 + 0.5 - Y + W;
-    xy[6].y = y0 + 0.5 - Y;
-
-    xy[7].x = x0 + 0.5 + X;
-    xy[7].y = y0 + 0.5 + X - W;
-
-    xy[8].x = xy[0].x;  // close polyline
-    xy[8].y = xy[0].y;
+    EllipsePgon(x0, y0, x1, y1, x2, y2, xy);
+    xy[8] = xy[0];  // close polyline
 
     // Draw eight sides of bounding polygon
-    SDL_RenderDrawLines(g_renderer, xy, 9);
+    dl->AddPolyline(color, xy, 9);
 }
 
-// Draws an 8-sided polygon inscribed in an ellipse specified
+// Adds an 8-sided polygon inscribed in an ellipse specified
 // by its center point (x0,y0) and the end points (x1,y1) and 
 // (x2,y2) of two conjugate diameters of the ellipse. Each
 // vertex of the polygon is a point at which the drawing
@@ -128,133 +107,51 @@ void BoundingPgon(int x0, int y0, int x1, int y1, int x2, int y2)
 // the same point at which one vertical, horizontal, or diagonal
 // side of the bounding polygon (drawn by the BoundingPolygon
 // function) touches (and is tangent to) the ellipse.
-void InscribedPgon(int x0, int y0, int x1, int y1, int x2, int y2)
+void InscribedPgon(DisplayList *dl, COLOR color,
+                   int x0, int y0, int x1, int y1, int x2, int y2)
 {
-    float xp, yp, xq, yq;
-    float tmp1, tmp2;
-    float X, Y, Z, W, U, V;
-    SDL_Point xy[9];
-
-    // Translate center of ellipse to origin
-    xp = x1 - x0;
-    yp = y1 - y0;
-    xq = x2 - x0;
-    yq = y2 - y0;
-
-    // Compute vertexes of framing polygon
-    X = sqrt(xp*xp + xq*xq);
-    Y = sqrt(yp*yp + yq*yq);
-    tmp1 = xp + yp;
-    tmp2 = xq + yq;
-    Z = sqrt(tmp1*tmp1+tmp2*tmp2);
-    tmp1 = xp - yp;
-    tmp2 = xq - yq;
-    W = sqrt(tmp1*tmp1+tmp2*tmp2);
-    if (X == 0 || Y == 0 || Z == 0 || W == 0)
+    XYVAL xy[9];
+
+    if (!EllipseInscribedPgon(x0, y0, x1, y1, x2, y2, xy))
     {
         return;  // degenerate ellipse
     }
-    U = xp*(xp + yp) + xq*(xq + yq);
-    V = xp*(xp - yp) + xq*(xq - yq);
-    tmp1 = xp*yp + xq*yq;
-
-    xy[0].x = x0 + 0.5 + X;
-    xy[0].y = y0 + 0.5 + tmp1/X;
-
-    xy[1].x = x0 + 0.5 + U/Z;    
-    xy[1].y = y0 + 0.5 - U/Z + Z;
-
-    xy[2].x = x0 + 0.5 + tmp1/Y;
-    xy[2].y = y0 + 0.5 + Y;
-
-    xy[3].x = x0 + 0.5 - V/W;    
-    xy[3].y = y0 + 0.5 - V/W + W;
-
-    xy[4].x = x0 + 0.5 - X;      
-    xy[4].y = y0 + 0.5 - tmp1/X; 
-
-    xy[5].x = x0 + 0.5 - U/Z;    
-    xy[5].y = y0 + 0.5 + U/Z - Z;
-
-    xy[6].x = x0 + 0.5 - tmp1/Y; 
-    xy[6].y = y0 + 0.5 - Y;      
-
-    xy[7].x = x0 + 0.5 + V/W;    
-    xy[7].y = y0 + 0.5 + V/W - W;
-
-    xy[8].x = xy[0].x;  // close polyline
-    xy[8].y = xy[0].y;
+    xy[8] = xy[0];  // close polyline
 
     // Connect eight vertexes of inscribed polygon
-    SDL_RenderDrawLines(g_renderer, xy, 9);
+    dl->AddPolyline(color, xy, 9);
 }
 
-// Draws the major and minor axes for an ellipse given the center
-// point (x0,y0) of the ellipse and the end points (x1,y1) and 
-// (x2,y2) of two conjugate diameters of the ellipse.
-void DrawAxes(int x0, int y0, int x1, int y1, int x2, int y2)
+// Adds the major and minor axes for an ellipse to display list dl,
+// given the center point (x0,y0) of the ellipse and the end points
+// (x1,y1) and (x2,y2) of two conjugate diameters of the ellipse.
+void DrawAxes(DisplayList *dl, COLOR color,
+              int x0, int y0, int x1, int y1, int x2, int y2)
 {
-    float xp, yp, xq, yq;
-    float A, B, C, F;
-    float xprod, beta, root, slope, denom, x, y;
-    SDL_Point xy[2];
-
-    // Translate center of ellipse to origin
-    xp = x1 - x0;
-    yp = y1 - y0;
-    xq = x2 - x0;
-    yq = y2 - y0;
-
-    // Calculate coefficients A,B,C,F for ellipse equation
-    A = yp*yp + yq*yq;
-    B = -2*(xp*yp + xq*yq);
-    if (B == 0)
-    {
-        return;  // an ellipse in standard position, or a circle
-    }
-    C = xp*xp + xq*xq;
-    xprod = xq*yp - xp*yq;
-    if (xprod == 0)
-    {
-        return;  // area of ellipse is zero
-    }
-    F = -xprod*xprod;
-    beta = (C - A)/B;
-    root = sqrt(beta*beta + 1.0);
-    slope = beta + root;
+    XYVAL xy[4];
 
-    // Each for-loop iteration draws an axis
-    for (int i = 0; i < 2; i++)
+    if (!EllipseAxes(x0, y0, x1, y1, x2, y2, xy))
     {
-        denom = A + (B + C*slope)*slope;
-        if (denom <= 0)
-        {
-            return;  // ultra-thin ellipse
-        }
-        x = sqrt(-F/denom);
-        y = slope*x;
-        xy[0].x = x0 + 0.5 + x;      
-        xy[0].y = y0 + 0.5 + y;
-        xy[1].x = x0 + 0.5 - x;
-        xy[1].y = y0 + 0.5 - y;
-        SDL_RenderDrawLines(g_renderer, xy, 2);
-        slope = beta - root;
-    } 
+        return;  // a circle, or area of ellipse is zero
+    }
+    dl->AddPolyline(color, &xy[0], 2);
+    dl->AddPolyline(color, &xy[2], 2);
 }
 
-// Draws the updated ellipse. Also draws the parallelogram in which
-// the ellipse is incribed, the bounding box for the ellipse, the
-// bounding polygon for the ellipse, the polygon inscribed in the
-// ellipse, and the major and minor axes of the ellipse.
-void UpdateEllipse(Bounce *bounce)
+// Adds the updated ellipse to display list dl. Also adds the
+// parallelogram in which the ellipse is incribed, the bounding box
+// for the ellipse, the bounding polygon for the ellipse, the polygon
+// inscribed in the ellipse, and the major and minor axes of the
+// ellipse. The parallelogram is interpolated between its last two
+// positions by fixed-point fraction alpha (see Bounce::Interpolate).
+void UpdateEllipse(Bounce *bounce, int alpha, DisplayList *dl)
 {
-    SDL_Rect rect;
-    SDL_Point xy[5];
+    XYVAL xy[5];
     int x0, y0, x1, y1, x2, y2;
     COLOR color[] = { ORANGE, GREEN, MAGENTA, YELLOW };
 
-    // Update coordinates for animated parallelogram
-    bounce->Update((XYVAL*)xy);  
+    // Get coordinates for animated parallelogram
+    bounce->Interpolate(alpha, xy);
     xy[4] = xy[0];       // close polyline
 
     // Get ellipse center point and ends of conjugate diameters
@@ -266,48 +163,250 @@ void UpdateEllipse(Bounce *bounce)
     y2 = (xy[2].y + xy[3].y)/2;
 
     // Fill bounding box around ellipse
-    SetColor(DARKGREEN);
-    BoundingBox(x0, y0, x1, y1, x2, y2);
+    BoundingBox(dl, DARKGREEN, x0, y0, x1, y1, x2, y2);
 
     // Highlight vertices of parallelogram
     for (int i = 0; i < 4; i++)
     {
-        rect.x = xy[i].x-2;
-        rect.y = xy[i].y-2;
-        rect.w = rect.h = 5;
-        SetColor(color[i]);
-        SDL_RenderFillRect(g_renderer, &rect);
+        dl->Add(PRIM_RECT, color[i], xy[i].x-2, xy[i].y-2,
+                xy[i].x+2, xy[i].y+2);
     }
 
     // Draw four sides of parallelogram
-    SetColor(BLUE);
-    SDL_RenderDrawLines(g_renderer, xy, 5);
+    dl->AddPolyline(BLUE, xy, 5);
 
     // Draw 8-sided bounding polygon around ellipse
-    SetColor(RED);
-    BoundingPgon(x0, y0, x1, y1, x2, y2);
+    BoundingPgon(dl, RED, x0, y0, x1, y1, x2, y2);
 
     // Draw 8-sided polygon inscribed in ellipse
-    SetColor(MAGENTA);
-    InscribedPgon(x0, y0, x1, y1, x2, y2);
+    InscribedPgon(dl, MAGENTA, x0, y0, x1, y1, x2, y2);
 
     // Draw major and minor axes of ellipse
-    SetColor(YELLOW);
-    DrawAxes(x0, y0, x1, y1, x2, y2);
+    DrawAxes(dl, YELLOW, x0, y0, x1, y1, x2, y2);
 
     // Draw ellipse inscribed in parallelogram
-    SetColor(WHITE);
-    Ellipse(x0, y0, x1, y1, x2, y2);
+    dl->Add(PRIM_ELLIPSE, WHITE, x0, y0, x1, y1, x2, y2);
+}
+
+//---------------------------------------------------------------------
+//
+// Pipelined mode
+//
+//---------------------------------------------------------------------
+
+// A frame passed from the raster thread to the main thread: a copy of
+// the framebuffer that is up to date in the rectangles in rects, which
+// are the parts of the screen that changed since the previous frame
+struct FRAME
+{
+    std::vector<COLOR> pixels;
+    std::vector<int> rects;
+};
+
+// State shared by the threads in pipelined mode. The simulation thread
+// updates the animation and publishes a display list for each step.
+// The raster thread draws the latest display list into the framebuffer
+// and publishes the parts that changed. The main thread handles events
+// and presents the latest frame. Each thread works at its own pace, so
+// a slow frame does not delay input, and the triple buffers always
+// hand over the newest display list and frame.
+struct PIPELINE
+{
+    Bounce *bounce;
+    SimClock *clock;
+    FrameStats *stats;
+    Scheduler *sched;
+    Recorder *recorder;               // records each display list drawn
+    const XYVAL *frame;               // polyline around window
+    TripleBuffer<DisplayList> lists;  // simulation -> raster
+    TripleBuffer<FRAME> frames;       // raster -> main
+    SDL_atomic_t redraw;              // steps left to run, or negative
+    SDL_atomic_t quit;                // nonzero to stop the threads
+};
+
+// Simulation thread -- Runs the steps of the animation that are due
+// by the simulation clock about twice per step, and publishes the
+// display list for a position interpolated between the last two steps
+//
+int SimulationThread(void *data)
+{
+    PIPELINE *pipe = (PIPELINE*)data;
+
+    while (!SDL_AtomicGet(&pipe->quit))
+    {
+        if (SDL_AtomicGet(&pipe->redraw))
+        {
+            DisplayList& dl = pipe->lists.Back();
+            int alpha = FIX_ONE;
+
+            if (SDL_AtomicGet(&pipe->redraw) < 0)
+            {
+                for (int n = pipe->clock->Tick(NowMs()); n > 0; n--)
+                    pipe->bounce->Step();
+                alpha = pipe->clock->Alpha();
+            }
+            else
+            {
+                SDL_AtomicAdd(&pipe->redraw, -1);
+                pipe->bounce->Step();
+            }
+            dl.Clear();
+            dl.AddPolyline(GRAY, pipe->frame, 5);
+            UpdateEllipse(pipe->bounce, alpha, &dl);
+            pipe->lists.Publish();
+        }
+        SDL_Delay((Uint32)(STEP_MS/2));
+    }
+    return 0;
+}
+
+// Raster thread -- Submits each new display list to the scheduler and
+// renders it in slices of about RENDER_MS milliseconds. After each
+// slice, the dirty tiles of the framebuffer are copied into a frame
+// and published. If the main thread skipped the previous frame, its
+// tiles are marked dirty again so that they go out with the next one.
+// Only the display lists that are drawn are recorded, so that a
+// recording replays the frames that were actually shown.
+//
+int RasterThread(void *data)
+{
+    PIPELINE *pipe = (PIPELINE*)data;
+    Scheduler *sched = pipe->sched;
+
+    while (!SDL_AtomicGet(&pipe->quit))
+    {
+        if (pipe->lists.Take())
+        {
+            sched->Submit(pipe->lists.Front());
+            pipe->recorder->Write(pipe->lists.Front());
+        }
+        if (!sched->Done())
+        {
+            double t = NowMs();
+            int pixels = sched->Render();
+            double ms = NowMs() - t;
+
+            sched->AdjustBudget(pixels, ms);
+        }
+
+        FRAME& out = pipe->frames.Back();
+        int width = g_surface->width;
+
+        if (g_surface->GetDirtyRects(out.rects) == 0)
+        {
+            SDL_Delay(1);  // nothing to do until the next display list
+            continue;
+        }
+        out.pixels.resize(width*g_surface->height);
+        for (size_t i = 0; i < out.rects.size(); i += 4)
+        {
+            const int *r = &out.rects[i];
+
+            for (int y = r[1]; y <= r[3]; y++)
+            {
+                memcpy(&out.pixels[y*width + r[0]],
+                       &g_surface->pixels[y*width + r[0]],
+                       (r[2] - r[0] + 1)*sizeof(COLOR));
+            }
+        }
+        if (pipe->frames.Publish())
+        {
+            const std::vector<int>& lost = pipe->frames.Back().rects;
+
+            for (size_t i = 0; i < lost.size(); i += 4)
+                g_surface->MarkDirty(lost[i], lost[i+1], lost[i+2], lost[i+3]);
+        }
+    }
+    return 0;
+}
+
+// Runs the demo with separate simulation and raster threads until the
+// user quits. The main thread only handles events and presents frames.
+//
+void RunPipelined(Bounce *bounce, SimClock *clock, FrameStats *stats,
+                  Scheduler *sched, Recorder *recorder,
+                  SDL_Texture *texture, const XYVAL frame[5])
+{
+    PIPELINE *pipe = new PIPELINE;
+    SDL_Thread *sim, *raster;
+    bool quit = false;
+
+    pipe->bounce = bounce;
+    pipe->clock = clock;
+    pipe->stats = stats;
+    pipe->sched = sched;
+    pipe->recorder = recorder;
+    pipe->frame = frame;
+    SDL_AtomicSet(&pipe->redraw, -1);
+    SDL_AtomicSet(&pipe->quit, 0);
+    sim = SDL_CreateThread(SimulationThread, "simulation", pipe);
+    raster = SDL_CreateThread(RasterThread, "raster", pipe);
+    while (!quit)
+    {
+        SDL_Event evt;
+
+        if (pipe->frames.Take())
+        {
+            const FRAME& in = pipe->frames.Front();
+
+            UploadRects(texture, &in.pixels[0], in.rects);
+            SDL_RenderCopy(g_renderer, texture, 0, 0);
+            SDL_RenderPresent(g_renderer);
+            if (SDL_AtomicGet(&pipe->redraw) < 0)
+                stats->Add(NowMs());
+        }
+        SDL_WaitEventTimeout(0, 2);
+        while (SDL_PollEvent(&evt))
+        {
+            if (evt.type == SDL_QUIT)
+            {
+                quit = true;
+            }
+            else if (evt.type == SDL_KEYDOWN)
+            {
+                switch (evt.key.keysym.sym)
+                {
+                case SDLK_ESCAPE:
+                    quit = true;
+                    break;
+                default:
+                    SDL_AtomicSet(&pipe->redraw, 1);
+                    break;
+                }
+            }
+        }
+    }
+    SDL_AtomicSet(&pipe->quit, 1);
+    SDL_WaitThread(sim, 0);
+    SDL_WaitThread(raster, 0);
+    delete pipe;
 }
 
 //---------------------------------------------------------------------
 //
-// Main program
+// Main program. The -p option runs the demo in pipelined mode. The
+// -record option saves the display list of each frame to a file,
+// which the bench program can replay.
 //
 //---------------------------------------------------------------------
 int main(int argc, char* argv[])
 {
     int retval = 0;
+    bool pipelined = false;
+    const char *recordPath = 0;
+
+    for (int i = 1; i < argc; i++)
+    {
+        if (strcmp(argv[i], "-p") == 0)
+            pipelined = true;
+        else if (strcmp(argv[i], "-record") == 0 && i + 1 < argc)
+            recordPath = argv[++i];
+        else
+        {
+            printf("Usage: demo1 [-p] [-record file]\n");
+            return 1;
+        }
+    }
 
     printf("Starting SDL2 app...\n");
     if (SDL_Init(SDL_INIT_VIDEO) == 0)
@@ -319,30 +418,80 @@ int main(int argc, char* argv[])
             bool quit = false;
             int redraw = -1;
             int width, height;
-            SDL_Rect frame;
+            XYVAL frame[5];
             Bounce *bounce = 0;
+            SimClock clock(STEP_MS);
+            FrameStats stats(STEP_MS);
+            SDL_Texture *texture = 0;
+            Scheduler *sched = 0;
+            Recorder recorder;
+            DisplayList dl;
 
             SDL_GetWindowSize(window, &width, &height);
             bounce = new Bounce(width, height);
-            frame.x = 2;
-            frame.y = 2;
-            frame.w = width - 4;
-            frame.h = height - 4;
+            g_surface = new Surface(width, height);
+            sched = new Scheduler(g_surface, BLACK);
+            texture = SDL_CreateTexture(g_renderer, SDL_PIXELFORMAT_BGR888,
+                                        SDL_TEXTUREACCESS_STREAMING,
+                                        width, height);
+            frame[0].x = frame[3].x = frame[4].x = 2;
+            frame[0].y = frame[1].y = frame[4].y = 2;
+            frame[1].x = frame[2].x = width - 3;
+            frame[2].y = frame[3].y = height - 3;
+            if (recordPath && !recorder.Open(recordPath, width, height))
+                printf("--ERROR-- Cannot create %s\n", recordPath);
+            if (pipelined)
+            {
+                RunPipelined(bounce, &clock, &stats, sched, &recorder,
+                             texture, frame);
+                quit = true;
+            }
             while (!quit)
             {
                 SDL_Event evt;
+                double frameStart = NowMs();
+                int wait;
 
                 if (redraw)
                 {
-                    --redraw;
-                    SetColor(BLACK);
-                    SDL_RenderClear(g_renderer);
-                    SetColor(GRAY);
-                    SDL_RenderDrawRect(g_renderer, &frame);
-                    UpdateEllipse(bounce);
+                    int alpha = FIX_ONE;
+
+                    if (redraw < 0)
+                    {
+                        // Free-running animation: run the simulation
+                        // steps that are due, and draw a position in
+                        // between the last two
+                        for (int n = clock.Tick(frameStart); n > 0; n--)
+                            bounce->Step();
+                        alpha = clock.Alpha();
+                        stats.Add(frameStart);
+                    }
+                    else
+                    {
+                        --redraw;
+                        bounce->Step();
+                    }
+                    dl.Clear();
+                    dl.AddPolyline(GRAY, frame, 5);
+                    UpdateEllipse(bounce, alpha, &dl);
+                    sched->Submit(dl);
+                    recorder.Write(dl);
+                }
+                if (!sched->Done())
+                {
+                    // Draw as much of the frame as fits in RENDER_MS,
+                    // and show it even if it is not yet complete
+                    double t = NowMs();
+                    int pixels = sched->Render();
+                    double ms = NowMs() - t;
+
+                    sched->AdjustBudget(pixels, ms);
+                    UpdateDirtyTiles(texture);
+                    SDL_RenderCopy(g_renderer, texture, 0, 0);
                     SDL_RenderPresent(g_renderer);
                 }
-                SDL_WaitEventTimeout(0, 17);
+                wait = (int)(frameStart + STEP_MS - NowMs());
+                SDL_WaitEventTimeout(0, (wait > 1) ? wait : 1);
                 while (SDL_PollEvent(&evt))
                 {
                     if (evt.type == SDL_QUIT)
@@ -363,6 +512,21 @@ int main(int argc, char* argv[])
                     }
                 }
             }
+            stats.Report(stdout, clock.Skipped());
+            if (recordPath)
+            {
+                if (recorder.Close())
+                    printf("Recorded %d frames to %s\n", recorder.Frames(),
+                           recordPath);
+                else
+                    printf("--ERROR-- Cannot write %s\n", recordPath);
+            }
+            if (texture)
+            {
+                SDL_DestroyTexture(texture);
+            }
+            delete sched;
+            delete g_surface;
         }
         else
         {
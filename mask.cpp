@@ -0,0 +1,84 @@
+//---------------------------------------------------------------------
+//
+// mask.cpp -- MaskSurface class member functions
+//
+//---------------------------------------------------------------------
+
+#include <algorithm>
+#include "mask.h"
+
+// Constructor
+MaskSurface::MaskSurface(int width, int height) :
+            width(width), height(height)
+{
+    stride = (width + WORD_BITS - 1) >> WORD_SHIFT;
+    bits = new WORD[stride*height];
+    Clear();
+}
+
+// Destructor
+MaskSurface::~MaskSurface()
+{
+    delete[] bits;
+}
+
+// Clears every pixel in the mask
+void MaskSurface::Clear()
+{
+    std::fill(bits, bits + stride*height, (WORD)0);
+}
+
+// Sets the horizontal span of pixels from (xl,y) to (xr,y), inclusive.
+// The first and last words of the span are ORed with a mask of the
+// bits that the span covers, and the words between them are set to
+// all ones.
+void MaskSurface::Span(int xl, int xr, int y)
+{
+    if ((unsigned)y >= (unsigned)height)
+        return;
+    if (xl < 0)
+        xl = 0;
+    if (xr >= width)
+        xr = width - 1;
+    if (xl > xr)
+        return;
+
+    WORD *p = &bits[y*stride];
+    int wl = xl >> WORD_SHIFT, wr = xr >> WORD_SHIFT;
+    WORD ml = ~(WORD)0 << (xl & BIT_MASK);
+    WORD mr = ~(WORD)0 >> (BIT_MASK - (xr & BIT_MASK));
+
+    if (wl == wr)
+    {
+        p[wl] |= ml & mr;
+        return;
+    }
+    p[wl] |= ml;
+    for (int w = wl + 1; w < wr; w++)
+        p[w] = ~(WORD)0;
+    p[wr] |= mr;
+}
+
+// Sets the pixels in the rectangle from (xmin,ymin) to (xmax,ymax),
+// inclusive
+void MaskSurface::FillRect(int xmin, int ymin, int xmax, int ymax)
+{
+    for (int y = ymin; y <= ymax; y++)
+        Span(xmin, xmax, y);
+}
+
+// Returns the number of pixels that are set
+long long MaskSurface::Count() const
+{
+    long long count = 0;
+
+    for (int i = 0; i < stride*height; i++)
+    {
+        WORD w = bits[i];
+
+        // Clear the lowest set bit until none are left
+        for (; w != 0; w &= w - 1)
+            count++;
+    }
+    return count;
+}
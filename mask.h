@@ -0,0 +1,54 @@
+//---------------------------------------------------------------------
+//
+// mask.h -- Include file for the MaskSurface class, a one-bit-per-
+//     pixel coverage mask that curves can be drawn into
+//
+//---------------------------------------------------------------------
+
+#ifndef MASK_H
+#define MASK_H
+
+// The MaskSurface class records which pixels have been drawn, but not
+// their colors, for uses such as hit masks, stencils, and printing.
+// Each pixel is one bit, so that the mask takes 1/32 the memory of a
+// Surface of the same size. The pixels are stored row by row, and
+// each row is an array of 64-bit words, in which pixel x is bit
+// (x & 63) of word (x >> 6). Plot sets one bit, and Span sets a run
+// of bits with a masked OR into each of the words at its ends and a
+// whole-word store into each word in between. Like Surface, the mask
+// quietly skips any pixels that fall outside it.
+//
+class MaskSurface
+{
+public:
+    enum { WORD_SHIFT = 6, WORD_BITS = 1 << WORD_SHIFT, BIT_MASK = 63 };
+    typedef unsigned long long WORD;
+
+    WORD *bits;          // stride words per row, row by row
+    int width, height;   // size in pixels
+    int stride;          // words per row
+
+    MaskSurface(int width, int height);
+    ~MaskSurface();
+    void Clear();
+    void Plot(int x, int y)
+    {
+        if ((unsigned)x < (unsigned)width && (unsigned)y < (unsigned)height)
+            bits[y*stride + (x >> WORD_SHIFT)] |= (WORD)1 << (x & BIT_MASK);
+    }
+    bool Get(int x, int y) const
+    {
+        return (unsigned)x < (unsigned)width &&
+               (unsigned)y < (unsigned)height &&
+               (bits[y*stride + (x >> WORD_SHIFT)] >> (x & BIT_MASK)) & 1;
+    }
+    void Span(int xl, int xr, int y);
+    void FillRect(int xmin, int ymin, int xmax, int ymax);
+    long long Count() const;
+
+private:
+    MaskSurface(const MaskSurface&);             // not copyable
+    MaskSurface& operator=(const MaskSurface&);
+};
+
+#endif  // MASK_H
@@ -0,0 +1,219 @@
+//---------------------------------------------------------------------
+//
+// record.cpp -- Recorder and Player class member functions
+//
+//---------------------------------------------------------------------
+
+#include "record.h"
+
+// Largest number of display list entries that a frame can hold. A
+// larger count in a recording means that the file is damaged.
+const int MAX_RECORD_PRIMS = 1 << 24;
+
+// Number of 32-bit values per display list entry, not counting the
+// points of a PRIM_POLY_SPLINE
+const int RECORD_PRIM_VALS = 8;
+
+// Largest number of points that a PRIM_POLY_SPLINE entry can hold
+const int MAX_RECORD_POINTS = 1 << 24;
+
+// Constructor
+Recorder::Recorder() : fp(0), frames(0), failed(false)
+{
+}
+
+// Destructor
+Recorder::~Recorder()
+{
+    Close();
+}
+
+// Creates the recording file and writes the header. Returns false if
+// the file cannot be created.
+bool Recorder::Open(const char *path, int width, int height)
+{
+    Close();
+    fp = fopen(path, "wb");
+    frames = 0;
+    failed = (fp == 0);
+    if (failed)
+        return false;
+    Put(RECORD_MAGIC);
+    Put(RECORD_VERSION);
+    Put(width);
+    Put(height);
+    return !failed;
+}
+
+// Writes a 32-bit value, least significant byte first
+void Recorder::Put(int val)
+{
+    unsigned char buf[4];
+
+    buf[0] = (unsigned char)val;
+    buf[1] = (unsigned char)(val >> 8);
+    buf[2] = (unsigned char)(val >> 16);
+    buf[3] = (unsigned char)(val >> 24);
+    if (!failed && fwrite(buf, 1, 4, fp) != 4)
+        failed = true;
+}
+
+// Appends the display list for the next frame to the recording
+void Recorder::Write(const DisplayList& dl)
+{
+    if (fp == 0 || failed)
+        return;
+    Put((int)dl.prims.size());
+    for (size_t i = 0; i < dl.prims.size(); i++)
+    {
+        const PRIM& prim = dl.prims[i];
+
+        Put(prim.type);
+        Put((int)prim.color);
+        for (int j = 0; j < 3; j++)
+        {
+            Put(prim.pt[j].x);
+            Put(prim.pt[j].y);
+        }
+        if (prim.type == PRIM_POLY_SPLINE)
+        {
+            Put((int)prim.poly.size());
+            for (size_t j = 0; j < prim.poly.size(); j++)
+            {
+                Put(prim.poly[j].x);
+                Put(prim.poly[j].y);
+            }
+        }
+    }
+    frames++;
+}
+
+// Closes the recording file. Returns false if any write failed.
+bool Recorder::Close()
+{
+    if (fp)
+    {
+        if (fclose(fp) != 0)
+            failed = true;
+        fp = 0;
+    }
+    return !failed;
+}
+
+// Constructor
+Player::Player() : width(0), height(0), fp(0), version(0), failed(false)
+{
+}
+
+// Destructor
+Player::~Player()
+{
+    Close();
+}
+
+// Opens a recording and reads its header. Returns false if the file
+// cannot be opened or is not a recording that this version can read.
+bool Player::Open(const char *path)
+{
+    int magic;
+
+    Close();
+    fp = fopen(path, "rb");
+    failed = (fp == 0);
+    if (failed)
+        return false;
+    if (!Get(&magic) || magic != RECORD_MAGIC ||
+        !Get(&version) || version < 1 || version > RECORD_VERSION ||
+        !Get(&width) || !Get(&height) || width <= 0 || height <= 0)
+    {
+        failed = true;
+        Close();
+        return false;
+    }
+    return true;
+}
+
+// Reads a 32-bit value, least significant byte first. Returns false
+// at the end of the file.
+bool Player::Get(int *val)
+{
+    unsigned char buf[4];
+
+    if (fread(buf, 1, 4, fp) != 4)
+        return false;
+    *val = (int)(buf[0] | (buf[1] << 8) | (buf[2] << 16) |
+                 ((unsigned)buf[3] << 24));
+    return true;
+}
+
+//---------------------------------------------------------------------
+// Read function -- Replaces the contents of display list dl with the
+// next frame in the recording. Returns false if there are no more
+// frames. A frame that is cut short or holds an entry of an unknown
+// type, or of a type that its version of the format does not have,
+// ends the playback, and sets the failed flag.
+//---------------------------------------------------------------------
+bool Player::Read(DisplayList *dl)
+{
+    int count, val[RECORD_PRIM_VALS];
+    int lastType = (version < 2) ? PRIM_PARABOLIC_SPLINE_FX :
+                                   PRIM_POLY_SPLINE;
+
+    dl->Clear();
+    if (fp == 0 || failed || !Get(&count))
+        return false;  // end of recording
+    if (count < 0 || count > MAX_RECORD_PRIMS)
+    {
+        failed = true;
+        return false;
+    }
+    for (int i = 0; i < count; i++)
+    {
+        for (int j = 0; j < RECORD_PRIM_VALS; j++)
+        {
+            if (!Get(&val[j]))
+            {
+                failed = true;
+                return false;
+            }
+        }
+        if (val[0] < PRIM_LINE || val[0] > lastType)
+        {
+            failed = true;
+            return false;
+        }
+        dl->Add(val[0], (COLOR)val[1], val[2], val[3], val[4], val[5],
+                val[6], val[7]);
+        if (val[0] == PRIM_POLY_SPLINE)
+        {
+            std::vector<XYVAL>& poly = dl->prims.back().poly;
+            int npts;
+
+            if (!Get(&npts) || npts < 0 || npts > MAX_RECORD_POINTS)
+            {
+                failed = true;
+                return false;
+            }
+            poly.resize(npts);
+            for (int j = 0; j < npts; j++)
+            {
+                if (!Get(&poly[j].x) || !Get(&poly[j].y))
+                {
+                    failed = true;
+                    return false;
+                }
+            }
+        }
+    }
+    return true;
+}
+
+// Closes the recording file
+void Player::Close()
+{
+    if (fp)
+    {
+        fclose(fp);
+        fp = 0;
+    }
+}
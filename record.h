@@ -0,0 +1,92 @@
+//---------------------------------------------------------------------
+//
+// record.h -- Include file for the Recorder and Player classes, which
+//     save the display lists of an animation to a file and read them
+//     back, so that the same frames can be drawn again
+//
+//---------------------------------------------------------------------
+
+#ifndef RECORD_H
+#define RECORD_H
+
+#include <stdio.h>
+#include "sched.h"
+
+// A recording is a binary file that holds the display list of each
+// frame of an animation, in the order in which the frames were drawn.
+// Every value in the file is a 32-bit integer, stored least
+// significant byte first, so that a recording made on one platform
+// can be played back on any other. The file starts with a header:
+//
+//     RECORD_MAGIC, RECORD_VERSION, width, height
+//
+// where width and height are the size of the window. The header is
+// followed by the frames. Each frame is the number of display list
+// entries, followed by eight values for each entry: type, color, and
+// the x and y coordinates of pt[0], pt[1], and pt[2]. A
+// PRIM_POLY_SPLINE entry is followed by the number of points in poly,
+// and the x and y coordinates of each point. Version 1 recordings,
+// which have no PRIM_POLY_SPLINE entries, can still be read.
+//
+const int RECORD_MAGIC = 0x43524443;  // "CDRC" in the file
+const int RECORD_VERSION = 2;
+
+// The Recorder class writes the display list of each frame to a
+// recording. If a write fails, the rest of the recording is skipped,
+// and Close returns false.
+//
+class Recorder
+{
+public:
+    Recorder();
+    ~Recorder();
+    bool Open(const char *path, int width, int height);
+    void Write(const DisplayList& dl);
+    bool Close();
+    int Frames() const
+    {
+        return frames;
+    }
+
+private:
+    FILE *fp;
+    int frames;          // number of frames written
+    bool failed;         // true if a write failed
+
+    void Put(int val);
+
+    Recorder(const Recorder&);             // not copyable
+    Recorder& operator=(const Recorder&);
+};
+
+// The Player class reads back the frames in a recording. Read returns
+// false at the end of the recording, or if the file is damaged, in
+// which case Failed returns true.
+//
+class Player
+{
+public:
+    int width, height;   // window size, from the header
+
+    Player();
+    ~Player();
+    bool Open(const char *path);
+    bool Read(DisplayList *dl);
+    void Close();
+    bool Failed() const
+    {
+        return failed;
+    }
+
+private:
+    FILE *fp;
+    int version;         // format version, from the header
+    bool failed;         // true if the file is not a valid recording
+
+    bool Get(int *val);
+
+    Player(const Player&);                 // not copyable
+    Player& operator=(const Player&);
+};
+
+#endif  // RECORD_H
@@ -0,0 +1,196 @@
+//---------------------------------------------------------------------
+//
+// scene.cpp -- Scene generator for stress tests and benchmarks
+//
+//---------------------------------------------------------------------
+
+#include "scene.h"
+
+// Colors given to the shapes in a scene
+static const COLOR s_palette[] =
+{
+    BLUE, GREEN, MAGENTA, ORANGE, RED, WHITE, YELLOW, GRAY
+};
+
+// Returns the next value, from 0 to 2^24 - 1, from the random number
+// generator with state *seed. A simple linear congruential generator
+// is used so that the same seed produces the same scene on every
+// platform.
+static int Rand(unsigned *seed)
+{
+    *seed = 1664525*(*seed) + 1013904223;
+    return *seed >> 8;
+}
+
+// Returns a random integer from lo to hi, inclusive
+static int RandRange(unsigned *seed, int lo, int hi)
+{
+    return (hi <= lo) ? lo : lo + Rand(seed) % (hi - lo + 1);
+}
+
+// Returns a random size, as specified by params
+static int RandSize(const SCENEPARAMS *params, unsigned *seed)
+{
+    int lo = (params->minSize > 0) ? params->minSize : 0;
+    int hi = (params->maxSize > lo) ? params->maxSize : lo;
+
+    if (params->sizeDist == SIZE_LOG && lo > 0)
+    {
+        // Choose a doubling of the minimum size, and then a size
+        // within that doubling
+        int n = 0;
+
+        while ((lo << n) < hi && n < 30)
+            n++;
+        if (n > 0)
+        {
+            int k = RandRange(seed, 0, n - 1);
+
+            lo <<= k;
+            hi = (2*lo - 1 < hi) ? 2*lo - 1 : hi;
+        }
+    }
+    return RandRange(seed, lo, hi);
+}
+
+// Sets (*dx,*dy) to a random vector whose larger component is +size
+// or -size
+static void RandVec(unsigned *seed, int size, int *dx, int *dy)
+{
+    int a = RandRange(seed, -size, size);
+    int b = (Rand(seed) & 1) ? size : -size;
+
+    if (Rand(seed) & 1)
+    {
+        *dx = a;
+        *dy = b;
+    }
+    else
+    {
+        *dx = b;
+        *dy = a;
+    }
+}
+
+// Initializes params to a mix of every kind of shape, with sizes
+// from 2 to 256 pixels, in an area the size of the demo window
+void DefaultSceneParams(SCENEPARAMS *params)
+{
+    static const int weight[SCENE_KINDS] = { 4, 2, 2, 2, 2, 1, 1 };
+
+    params->count = 10000;
+    params->seed = 1;
+    params->width = DEMO_WIDTH;
+    params->height = DEMO_HEIGHT;
+    params->minSize = 2;
+    params->maxSize = 256;
+    params->sizeDist = SIZE_LOG;
+    for (int i = 0; i < SCENE_KINDS; i++)
+        params->weight[i] = weight[i];
+}
+
+//---------------------------------------------------------------------
+// GenerateScene function -- Replaces the contents of display list dl
+// with params->count shapes, chosen at random as specified by params.
+// The center or start point of each shape lies in the area from
+// (0,0) to (params->width-1, params->height-1), but the rest of the
+// shape can extend beyond it. The same params always produce the same
+// display list. Besides ordinary curves and lines, the scene includes
+// the degenerate cases that are hardest for the drawing algorithms:
+// ellipses whose conjugate diameters are nearly or exactly collinear,
+// and splines whose control points lie on the line through their end
+// points, or coincide with them.
+//---------------------------------------------------------------------
+void GenerateScene(const SCENEPARAMS *params, DisplayList *dl)
+{
+    unsigned seed = params->seed;
+    int total = 0;
+
+    for (int k = 0; k < SCENE_KINDS; k++)
+        total += params->weight[k];
+    dl->Clear();
+    for (int i = 0; i < params->count; i++)
+    {
+        int kind = SCENE_ELLIPSE;
+        int pick = (total > 0) ? RandRange(&seed, 0, total - 1) : 0;
+        int x = RandRange(&seed, 0, params->width - 1);
+        int y = RandRange(&seed, 0, params->height - 1);
+        int size = RandSize(params, &seed);
+        COLOR color = s_palette[Rand(&seed) % 8];
+        int dx1, dy1, dx2, dy2, t, type;
+
+        for (int k = 0; k < SCENE_KINDS; k++)
+        {
+            if (pick < params->weight[k])
+            {
+                kind = k;
+                break;
+            }
+            pick -= params->weight[k];
+        }
+        RandVec(&seed, size, &dx1, &dy1);
+        RandVec(&seed, size, &dx2, &dy2);
+        switch (kind)
+        {
+        case SCENE_ELLIPSE:
+            dl->Add(PRIM_ELLIPSE, color, x, y, x + dx1, y + dy1,
+                    x + dx2, y + dy2);
+            break;
+        case SCENE_ELLIPTIC_SPLINE:
+            dl->Add(PRIM_ELLIPTIC_SPLINE, color, x, y, x + dx1, y + dy1,
+                    x + dx2, y + dy2);
+            break;
+        case SCENE_PARABOLIC_SPLINE:
+            dl->Add(PRIM_PARABOLIC_SPLINE, color, x, y, x + dx1, y + dy1,
+                    x + dx2, y + dy2);
+            break;
+        case SCENE_SPLINE_FX:
+            // Same shapes, but the points have random fractional parts
+            type = (Rand(&seed) & 1) ? PRIM_ELLIPTIC_SPLINE_FX :
+                                       PRIM_PARABOLIC_SPLINE_FX;
+            x = x*FIX_ONE + Rand(&seed) % FIX_ONE;
+            y = y*FIX_ONE + Rand(&seed) % FIX_ONE;
+            dx1 = dx1*FIX_ONE + Rand(&seed) % FIX_ONE;
+            dy1 = dy1*FIX_ONE + Rand(&seed) % FIX_ONE;
+            dx2 = dx2*FIX_ONE + Rand(&seed) % FIX_ONE;
+            dy2 = dy2*FIX_ONE + Rand(&seed) % FIX_ONE;
+            dl->Add(type, color, x, y, x + dx1, y + dy1, x + dx2, y + dy2);
+            break;
+        case SCENE_LINE:
+            dl->Add(PRIM_LINE, color, x, y, x + dx1, y + dy1);
+            break;
+        case SCENE_THIN_ELLIPSE:
+            // Second conjugate diameter is a fraction of the first,
+            // off by at most a pixel, or is zero (a flat ellipse)
+            if (Rand(&seed) % 8 == 0)
+                dx2 = dy2 = 0;
+            else
+            {
+                t = RandRange(&seed, 1, 8)*((Rand(&seed) & 1) ? 1 : -1);
+                dx2 = dx1*t/8 + RandRange(&seed, -1, 1);
+                dy2 = dy1*t/8 + RandRange(&seed, -1, 1);
+            }
+            dl->Add(PRIM_ELLIPSE, color, x, y, x + dx1, y + dy1,
+                    x + dx2, y + dy2);
+            break;
+        default:  // SCENE_COLLINEAR_SPLINE
+            // The end point is a multiple of 4 pixels from the start
+            // point, so that the control point lies exactly on the
+            // line through them, between or beyond them
+            type = (Rand(&seed) & 1) ? PRIM_ELLIPTIC_SPLINE :
+                                       PRIM_PARABOLIC_SPLINE;
+            if (Rand(&seed) % 8 == 0)
+                dx1 = dy1 = 0;  // all three points coincide
+            else
+            {
+                RandVec(&seed, (size + 3)/4, &dx1, &dy1);
+                dx1 *= 4;
+                dy1 *= 4;
+            }
+            t = RandRange(&seed, -2, 6);
+            dl->Add(type, color, x, y, x + dx1*t/4, y + dy1*t/4,
+                    x + dx1, y + dy1);
+            break;
+        }
+    }
+}
@@ -0,0 +1,53 @@
+//---------------------------------------------------------------------
+//
+// scene.h -- Include file for the scene generator, which fills a
+//     display list with a repeatable mix of curves for stress tests
+//
+//---------------------------------------------------------------------
+
+#ifndef SCENE_H
+#define SCENE_H
+
+#include "sched.h"
+
+// Kinds of shapes that GenerateScene produces
+enum
+{
+    SCENE_ELLIPSE,             // Ellipse with random conjugate diameters
+    SCENE_ELLIPTIC_SPLINE,     // EllipticSpline with random points
+    SCENE_PARABOLIC_SPLINE,    // ParabolicSpline with random points
+    SCENE_SPLINE_FX,           // elliptic or parabolic spline, fixed-point
+    SCENE_LINE,                // Line
+    SCENE_THIN_ELLIPSE,        // nearly collinear conjugate diameters
+    SCENE_COLLINEAR_SPLINE,    // control point on the line through the
+                               // end points; sometimes a single point
+    SCENE_KINDS
+};
+
+// Size distributions for GenerateScene
+enum
+{
+    SIZE_UNIFORM,        // sizes spread evenly from minSize to maxSize
+    SIZE_LOG             // each doubling of size equally likely, so
+                         // that small shapes greatly outnumber large
+};
+
+// Parameters for GenerateScene. The size of a shape is the largest
+// x or y offset of its points from its center or start point. The
+// weight of each kind of shape sets how often that kind is chosen,
+// relative to the other kinds.
+struct SCENEPARAMS
+{
+    int count;                 // number of shapes
+    unsigned seed;             // random number seed
+    int width, height;         // area in which shapes are centered
+    int minSize, maxSize;      // range of sizes, in pixels
+    int sizeDist;              // SIZE_UNIFORM or SIZE_LOG
+    int weight[SCENE_KINDS];   // relative frequency of each kind
+};
+
+// Implemented in scene.cpp
+extern void DefaultSceneParams(SCENEPARAMS *params);
+extern void GenerateScene(const SCENEPARAMS *params, DisplayList *dl);
+
+#endif  // SCENE_H
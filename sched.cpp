@@ -0,0 +1,757 @@
+//---------------------------------------------------------------------
+//
+// sched.cpp -- DisplayList and Scheduler class member functions
+//
+//---------------------------------------------------------------------
+
+#include <limits.h>
+#include <algorithm>
+#include "sched.h"
+
+// Limits on the number of pixels that Render draws per call
+const int MIN_BUDGET = 1000;
+const int MAX_BUDGET = 1 << 24;
+
+// Adds a primitive to the display list
+void DisplayList::Add(int type, COLOR color, int x0, int y0, int x1, int y1,
+                      int x2, int y2)
+{
+    PRIM prim = { type, color, { { x0, y0 }, { x1, y1 }, { x2, y2 } },
+                  std::vector<XYVAL>() };
+
+    prims.push_back(prim);
+}
+
+// Adds the npts-1 lines of the polyline with vertexes xy[0] through
+// xy[npts-1] to the display list
+void DisplayList::AddPolyline(COLOR color, const XYVAL xy[], int npts)
+{
+    for (int i = 1; i < npts; i++)
+        Add(PRIM_LINE, color, xy[i-1].x, xy[i-1].y, xy[i].x, xy[i].y);
+}
+
+// Adds the chain of splines with knots xy[0], xy[2], ... and control
+// points xy[1], xy[3], ... to the display list as a single entry, so
+// that PolySpline draws each shared knot only once. The type of the
+// splines is PRIM_ELLIPTIC_SPLINE through PRIM_PARABOLIC_SPLINE_FX.
+void DisplayList::AddPolySpline(int type, COLOR color, const XYVAL xy[],
+                                int npts)
+{
+    Add(PRIM_POLY_SPLINE, color, type, 0, 0, 0);
+    prims.back().poly.assign(xy, xy + npts);
+}
+
+// Returns the function that draws splines of the given display list
+// type, or 0 if the type is not a spline
+static SPLINEPROC SplineProc(int type)
+{
+    switch (type)
+    {
+    case PRIM_ELLIPTIC_SPLINE:
+        return EllipticSpline;
+    case PRIM_PARABOLIC_SPLINE:
+        return ParabolicSpline;
+    case PRIM_ELLIPTIC_SPLINE_FX:
+        return EllipticSplineFx;
+    case PRIM_PARABOLIC_SPLINE_FX:
+        return ParabolicSplineFx;
+    }
+    return 0;
+}
+
+// Draws display list entry prim with the functions in conic.cpp, in
+// whatever color the pixel and span functions use. A PRIM_RECT is
+// drawn as a series of spans by DrawSpan.
+void DrawPrim(const PRIM& prim)
+{
+    const XYVAL *pt = prim.pt;
+
+    switch (prim.type)
+    {
+    case PRIM_LINE:
+        Line(pt[0].x, pt[0].y, pt[1].x, pt[1].y);
+        break;
+    case PRIM_RECT:
+        for (int y = std::min(pt[0].y, pt[1].y);
+             y <= std::max(pt[0].y, pt[1].y); y++)
+        {
+            DrawSpan(std::min(pt[0].x, pt[1].x), std::max(pt[0].x, pt[1].x),
+                     y);
+        }
+        break;
+    case PRIM_ELLIPSE:
+        Ellipse(pt[0].x, pt[0].y, pt[1].x, pt[1].y, pt[2].x, pt[2].y);
+        break;
+    case PRIM_ELLIPTIC_SPLINE:
+        EllipticSpline(pt[0].x, pt[0].y, pt[1].x, pt[1].y, pt[2].x, pt[2].y);
+        break;
+    case PRIM_PARABOLIC_SPLINE:
+        ParabolicSpline(pt[0].x, pt[0].y, pt[1].x, pt[1].y, pt[2].x, pt[2].y);
+        break;
+    case PRIM_ELLIPTIC_SPLINE_FX:
+        EllipticSplineFx(pt[0].x, pt[0].y, pt[1].x, pt[1].y,
+                         pt[2].x, pt[2].y);
+        break;
+    case PRIM_PARABOLIC_SPLINE_FX:
+        ParabolicSplineFx(pt[0].x, pt[0].y, pt[1].x, pt[1].y,
+                          pt[2].x, pt[2].y);
+        break;
+    case PRIM_POLY_SPLINE:
+        if (SplineProc(pt[0].x) && !prim.poly.empty())
+            PolySpline(SplineProc(pt[0].x), &prim.poly[0], prim.poly.size());
+        break;
+    }
+}
+
+// Returns true if display list entries a and b are identical
+static bool SamePrim(const PRIM& a, const PRIM& b)
+{
+    if (a.type != b.type || a.color != b.color)
+        return false;
+    for (int i = 0; i < 3; i++)
+    {
+        if (a.pt[i].x != b.pt[i].x || a.pt[i].y != b.pt[i].y)
+            return false;
+    }
+    if (a.poly.size() != b.poly.size())
+        return false;
+    for (size_t i = 0; i < a.poly.size(); i++)
+    {
+        if (a.poly[i].x != b.poly[i].x || a.poly[i].y != b.poly[i].y)
+            return false;
+    }
+    return true;
+}
+
+// Segments collected by AddSegment
+static std::vector<SEGMENT> *s_segs;
+
+// Segment function that collects the segments of a curve in s_segs
+static void AddSegment(const SEGMENT *seg)
+{
+    s_segs->push_back(*seg);
+}
+
+// Converts fixed-point value v to an integer, rounding to nearest, in
+// the same way as the ...Fx functions in conic.cpp
+static inline int FixToInt(int v)
+{
+    return (v + FIX_ONE/2) >> FIX_SHIFT;
+}
+
+// Calculates the integer bounds b of the ellipse or spline of the
+// given display list type with points pt[0], pt[1], and pt[2]
+static void CurveBounds(int type, const XYVAL pt[3], CONICBOUNDS *b)
+{
+    switch (type)
+    {
+    case PRIM_ELLIPSE:
+        EllipseBounds(pt[0].x, pt[0].y, pt[1].x, pt[1].y, pt[2].x, pt[2].y,
+                      b);
+        break;
+    case PRIM_ELLIPTIC_SPLINE:
+    case PRIM_ELLIPTIC_SPLINE_FX:
+        EllipticSplineBounds(pt[0].x, pt[0].y, pt[1].x, pt[1].y,
+                             pt[2].x, pt[2].y, b);
+        break;
+    default:
+        ParabolicSplineBounds(pt[0].x, pt[0].y, pt[1].x, pt[1].y,
+                              pt[2].x, pt[2].y, b);
+        break;
+    }
+    if (type == PRIM_ELLIPTIC_SPLINE_FX || type == PRIM_PARABOLIC_SPLINE_FX)
+    {
+        // The bounds are in fixed-point units
+        b->xmin = FixToInt(b->xmin);
+        b->ymin = FixToInt(b->ymin);
+        b->xmax = FixToInt(b->xmax);
+        b->ymax = FixToInt(b->ymax);
+    }
+}
+
+// Calculates the box {xmin, ymin, xmax, ymax} of the pixels drawn for
+// display list entry prim. The box of a curve is its integer bounds
+// (see EllipseBounds), grown by the one-pixel margin that allows for
+// the pixels drawn next to the curve, and the box of a chain of
+// splines is the union of the bounds of its splines. A curve that
+// misses a turn can still stray outside this box, and Step watches
+// for such pixels.
+static void PrimBox(const PRIM& prim, int box[4])
+{
+    const XYVAL *pt = prim.pt;
+    CONICBOUNDS b;
+
+    switch (prim.type)
+    {
+    case PRIM_LINE:
+    case PRIM_RECT:
+        box[0] = std::min(pt[0].x, pt[1].x);
+        box[1] = std::min(pt[0].y, pt[1].y);
+        box[2] = std::max(pt[0].x, pt[1].x);
+        box[3] = std::max(pt[0].y, pt[1].y);
+        return;
+    case PRIM_POLY_SPLINE:
+        // An empty chain gets an empty box
+        b.xmin = b.ymin = INT_MAX;
+        b.xmax = b.ymax = INT_MIN;
+        for (size_t i = 2; i < prim.poly.size(); i += 2)
+        {
+            CONICBOUNDS piece;
+
+            CurveBounds(pt[0].x, &prim.poly[i-2], &piece);
+            b.xmin = std::min(b.xmin, piece.xmin);
+            b.ymin = std::min(b.ymin, piece.ymin);
+            b.xmax = std::max(b.xmax, piece.xmax);
+            b.ymax = std::max(b.ymax, piece.ymax);
+        }
+        break;
+    default:
+        CurveBounds(prim.type, pt, &b);
+        break;
+    }
+    box[0] = b.xmin - 1;
+    box[1] = b.ymin - 1;
+    box[2] = b.xmax + 1;
+    box[3] = b.ymax + 1;
+}
+
+//---------------------------------------------------------------------
+// Damage maps. Submit records the areas that are erased or drawn over
+// in a map with one flag per 32-by-32-pixel tile of the surface (see
+// Surface::TILE_SIZE), so that checking an entry against them costs
+// time in proportion to the number of tiles that the entry covers,
+// however many entries have changed. Pixels outside the surface are
+// never drawn, so the parts of a box outside the surface are ignored.
+//---------------------------------------------------------------------
+
+const int TILE_SHIFT = Surface::TILE_SHIFT;
+
+// Calculates the range of tiles {txmin, tymin, txmax, tymax} of the
+// surface that box covers. Returns false if it covers none of them.
+static bool TileRange(const Surface *surface, const int box[4], int t[4])
+{
+    if (box[0] > box[2] || box[1] > box[3] || box[2] < 0 || box[3] < 0 ||
+        box[0] >= surface->width || box[1] >= surface->height)
+    {
+        return false;
+    }
+    t[0] = std::max(box[0], 0) >> TILE_SHIFT;
+    t[1] = std::max(box[1], 0) >> TILE_SHIFT;
+    t[2] = std::min(box[2], surface->width - 1) >> TILE_SHIFT;
+    t[3] = std::min(box[3], surface->height - 1) >> TILE_SHIFT;
+    return true;
+}
+
+// Sets the flags in map for the tiles that box covers. Map has cols
+// tiles in each row.
+static void MarkTiles(const Surface *surface, std::vector<char>& map,
+                      int cols, const int box[4])
+{
+    int t[4];
+
+    if (!TileRange(surface, box, t))
+        return;
+    for (int ty = t[1]; ty <= t[3]; ty++)
+        std::fill(&map[ty*cols + t[0]], &map[ty*cols + t[2]] + 1, 1);
+}
+
+// Calculates the pixel bounds u of the tiles that box covers and whose
+// flags are set in map. Returns false if there are none.
+static bool MarkedTiles(const Surface *surface,
+                        const std::vector<char>& map, int cols,
+                        const int box[4], int u[4])
+{
+    int t[4];
+    bool found = false;
+
+    if (!TileRange(surface, box, t))
+        return false;
+    u[0] = u[1] = INT_MAX;
+    u[2] = u[3] = INT_MIN;
+    for (int ty = t[1]; ty <= t[3]; ty++)
+    {
+        for (int tx = t[0]; tx <= t[2]; tx++)
+        {
+            if (!map[ty*cols + tx])
+                continue;
+            u[0] = std::min(u[0], tx << TILE_SHIFT);
+            u[1] = std::min(u[1], ty << TILE_SHIFT);
+            u[2] = std::max(u[2], ((tx + 1) << TILE_SHIFT) - 1);
+            u[3] = std::max(u[3], ((ty + 1) << TILE_SHIFT) - 1);
+            found = true;
+        }
+    }
+    return found;
+}
+
+// Constructor
+Scheduler::Scheduler(Surface *surface, COLOR background) :
+            budget(100000), surface(surface), background(background),
+            cols((surface->width + Surface::TILE_SIZE - 1) >> TILE_SHIFT),
+            late(cols*((surface->height + Surface::TILE_SIZE - 1) >>
+                       TILE_SHIFT)),
+            lateTop(late.size(), -1),
+            anyLate(false), serial(0),
+            nextJob(0), active(false), nextSeg(0), row(0)
+{
+}
+
+// Returns a job to draw prim, which is display list entry index, or
+// to erase prim if index is -1. Box is the box of the pixels of prim
+// (see PrimBox), grown by any stray pixels found so far (see Stray).
+Scheduler::JOB Scheduler::MakeJob(int index, const PRIM& prim,
+                                  const int box[4])
+{
+    JOB job;
+
+    job.index = index;
+    job.prim = prim;
+    std::copy(box, box + 4, job.box);
+    job.repair = false;
+    return job;
+}
+
+// Adds job draw to queue. An entry is not marked as drawn until all
+// of its queued jobs are complete, so that if Submit is called again
+// before then, the entry is queued again.
+void Scheduler::QueueDraw(std::vector<JOB>& queue, const JOB& draw)
+{
+    queue.push_back(draw);
+    pending[draw.index]++;
+    if (state[draw.index] == DRAWN)
+        state[draw.index] = PART_DRAWN;
+}
+
+//---------------------------------------------------------------------
+// Submit function -- Replaces the display list with list. Entries are
+// compared with the previous list by position. The old versions of
+// the entries that changed are erased first, and the new versions are
+// drawn next. Then, in display list order, the unchanged entries are
+// drawn if they are not yet complete or if they overlap anything that
+// was erased or drawn ahead of them, or any stray pixels not yet
+// repaired (see Stray), so that the finished frame matches a frame
+// drawn from scratch. A complete entry that is drawn only to repair it
+// is clipped to the damaged tiles that it covers, so the pixels
+// written (and the tiles copied to the screen) are limited to the
+// tiles covered by the old and new bounds of what changed.
+//---------------------------------------------------------------------
+void Scheduler::Submit(const DisplayList& list)
+{
+    const std::vector<PRIM>& next = list.prims;
+    size_t count = std::max(prims.size(), next.size());
+    std::vector<char> changed(count);
+    std::vector<int> nextBoxes(4*next.size());
+    std::vector<JOB> queue;
+
+    // Damage maps (see MarkTiles) of everything erased or drawn ahead
+    // of the entries still to be checked, and of the entries drawn
+    // again to repair them or to finish them
+    std::vector<char> damaged(late.size()), again(late.size(), 0);
+
+    // Stray pixels not yet repaired may have painted over any entry
+    for (size_t k = 0; k < late.size(); k++)
+        damaged[k] = !late[k].empty();
+    ClearLate();
+
+    // An erase that was interrupted or not yet started must still be
+    // done. A draw that was interrupted starts over.
+    if (active && job.index < 0)
+        queue.push_back(job);
+    for (size_t i = nextJob; i < jobs.size(); i++)
+    {
+        if (jobs[i].index < 0)
+            queue.push_back(jobs[i]);
+    }
+
+    // Erase the old versions of the entries that changed
+    for (size_t i = 0; i < count; i++)
+    {
+        bool had = (i < prims.size());
+
+        changed[i] = !(had && i < next.size() && SamePrim(prims[i], next[i]));
+        if (changed[i] && had && state[i] != NOT_DRAWN)
+        {
+            queue.push_back(MakeJob(-1, prims[i], &boxes[4*i]));
+        }
+    }
+    for (size_t i = 0; i < queue.size(); i++)
+        MarkTiles(surface, damaged, cols, queue[i].box);
+
+    // Find the boxes of the entries that changed, and keep the others
+    for (size_t i = 0; i < next.size(); i++)
+    {
+        if (changed[i])
+            PrimBox(next[i], &nextBoxes[4*i]);
+        else
+            std::copy(&boxes[4*i], &boxes[4*i] + 4, &nextBoxes[4*i]);
+    }
+    prims = next;
+    boxes.swap(nextBoxes);
+    state.resize(next.size(), NOT_DRAWN);
+
+    // Every stray pixel found from here on comes after every draw so
+    // far, so the serial numbers can start again
+    serial = 0;
+    drawn.assign(next.size(), 0);
+    pending.assign(next.size(), 0);
+
+    // Draw the entries that changed
+    for (size_t i = 0; i < next.size(); i++)
+    {
+        if (changed[i])
+        {
+            state[i] = NOT_DRAWN;
+            QueueDraw(queue, MakeJob(i, next[i], &boxes[4*i]));
+        }
+    }
+
+    // Draw any entries that might have been painted over by the jobs
+    // above, or by entries below them that are drawn again here
+    for (size_t i = 0; i < next.size(); i++)
+    {
+        JOB draw = MakeJob(i, next[i], &boxes[4*i]);
+        int u[4];
+
+        if (changed[i])
+        {
+            if (MarkedTiles(surface, again, cols, draw.box, u))
+            {
+                QueueDraw(queue, draw);
+                MarkTiles(surface, again, cols, draw.box);
+            }
+            MarkTiles(surface, damaged, cols, draw.box);
+        }
+        else if (state[i] != DRAWN)
+        {
+            QueueDraw(queue, draw);
+            MarkTiles(surface, again, cols, draw.box);
+            MarkTiles(surface, damaged, cols, draw.box);
+        }
+        else if (MarkedTiles(surface, damaged, cols, draw.box, u))
+        {
+            draw.box[0] = std::max(draw.box[0], u[0]);
+            draw.box[1] = std::max(draw.box[1], u[1]);
+            draw.box[2] = std::min(draw.box[2], u[2]);
+            draw.box[3] = std::min(draw.box[3], u[3]);
+            draw.repair = true;
+            QueueDraw(queue, draw);
+            MarkTiles(surface, again, cols, draw.box);
+            MarkTiles(surface, damaged, cols, draw.box);
+        }
+    }
+    jobs.swap(queue);
+    nextJob = 0;
+    active = false;
+}
+
+// Starts the next job in the queue, and gives it the next serial
+// number (see Stray). The curve's segments are collected by drawing
+// it with a segment function in effect.
+void Scheduler::StartJob()
+{
+    SEGMENTPROC prev;
+
+    job = jobs[nextJob++];
+    active = true;
+    row = job.box[1];
+    segs.clear();
+    nextSeg = 0;
+    iter = ConicIter();
+    serial++;
+    if (job.index >= 0)
+    {
+        state[job.index] = PART_DRAWN;
+        if (!job.repair)
+            drawn[job.index] = serial;
+    }
+    if (anyLate)
+        CoverLate();
+
+    // A PRIM_RECT is filled a row at a time by Step
+    if (job.prim.type == PRIM_RECT)
+        return;
+    s_segs = &segs;
+    prev = SetSegmentProc(AddSegment);
+    DrawPrim(job.prim);
+    SetSegmentProc(prev);
+}
+
+// Draws up to about limit pixels of the job in progress, and returns
+// the number of pixels drawn. Clears active when the job is complete.
+int Scheduler::Step(int limit)
+{
+    const PRIM& prim = job.prim;
+    int count = 0;
+    bool complete = false;
+
+    surface->color = (job.index < 0) ? background : prim.color;
+    if (prim.type == PRIM_RECT)
+    {
+        // The box of a rectangle is the rectangle, clipped for a repair
+        int xmin = job.box[0], xmax = job.box[2], ymax = job.box[3];
+
+        while (row <= ymax && count < limit)
+        {
+            surface->Span(xmin, xmax, row++);
+            count += xmax - xmin + 1;
+        }
+        complete = (row > ymax);
+    }
+    else
+    {
+        while (count < limit)
+        {
+            int xl, xr, y;
+
+            if (iter.NextRun(&xl, &xr, &y))
+            {
+                // A repair draws only the part of the curve in its box
+                count += xr - xl + 1;
+                if (!job.repair)
+                {
+                    surface->Span(xl, xr, y);
+                    if (xl < job.box[0] || xr > job.box[2] ||
+                        y < job.box[1] || y > job.box[3])
+                    {
+                        Stray(xl, xr, y);
+                    }
+                }
+                else if (y >= job.box[1] && y <= job.box[3])
+                {
+                    surface->Span(std::max(xl, job.box[0]),
+                                  std::min(xr, job.box[2]), y);
+                }
+            }
+            else if (nextSeg < segs.size())
+                iter.Start(segs[nextSeg++]);
+            else
+            {
+                complete = true;
+                break;
+            }
+        }
+    }
+    if (complete)
+    {
+        active = false;
+        if (job.index >= 0 && --pending[job.index] == 0)
+            state[job.index] = DRAWN;
+    }
+    return count;
+}
+
+//---------------------------------------------------------------------
+// Stray pixels. A curve that misses a turn can draw pixels outside the
+// box that PrimBox found for it. Step watches for such pixels, and
+// records for each tile they fall in the lowest display list entry
+// that they may have painted over, and the serial number of the job
+// that drew them (see StartJob). A job that starts later and covers
+// the stray pixels of an entry above its own is recorded in the same
+// way, since it paints over them. Once the other jobs are done,
+// QueueLate repairs each entry that was last drawn in full before a
+// stray pixel, or a job, painted over it. On a frame drawn from
+// scratch, the entries above a curve are drawn after it, so its stray
+// pixels cost no repairs.
+//---------------------------------------------------------------------
+
+// Records run xl..xr on row y, which the job in progress has drawn
+// outside its box. The box of the job, and of its display list entry,
+// are grown to include the run. A draw can only have painted over the
+// entries above it, but an erase can have painted over any entry.
+void Scheduler::Stray(int xl, int xr, int y)
+{
+    int run[4] = { xl, y, xr, y };
+
+    job.box[0] = std::min(job.box[0], xl);
+    job.box[1] = std::min(job.box[1], y);
+    job.box[2] = std::max(job.box[2], xr);
+    job.box[3] = std::max(job.box[3], y);
+    if (job.index >= 0)
+        std::copy(job.box, job.box + 4, &boxes[4*job.index]);
+    MarkLate(run, job.index + 1, serial);
+    if (job.index >= 0)
+    {
+        int t[4];
+
+        if (TileRange(surface, run, t))
+        {
+            for (int tx = t[0]; tx <= t[2]; tx++)
+            {
+                int k = t[1]*cols + tx;
+
+                lateTop[k] = std::max(lateTop[k], job.index);
+            }
+        }
+    }
+}
+
+// Records that the job in progress, which has just started, paints
+// over the stray pixels of the entries above it in the tiles it covers
+void Scheduler::CoverLate()
+{
+    int t[4];
+
+    if (!TileRange(surface, job.box, t))
+        return;
+    for (int ty = t[1]; ty <= t[3]; ty++)
+    {
+        for (int tx = t[0]; tx <= t[2]; tx++)
+        {
+            int k = ty*cols + tx;
+
+            if (lateTop[k] > job.index)
+                AddLate(k, job.index + 1, serial);
+        }
+    }
+}
+
+// Records that tile k was painted over, by the job with serial number
+// stamp, on top of display list entry from and the entries above it.
+// A record that the last one for the tile already covers is dropped.
+void Scheduler::AddLate(int k, int from, int stamp)
+{
+    std::vector<LATE>& list = late[k];
+
+    if (list.empty() || list.back().serial != stamp ||
+        list.back().from > from)
+    {
+        LATE rec = { from, stamp };
+
+        list.push_back(rec);
+    }
+    anyLate = true;
+}
+
+// Calls AddLate for each tile that box covers
+void Scheduler::MarkLate(const int box[4], int from, int stamp)
+{
+    int t[4];
+
+    if (!TileRange(surface, box, t))
+        return;
+    for (int ty = t[1]; ty <= t[3]; ty++)
+    {
+        for (int tx = t[0]; tx <= t[2]; tx++)
+            AddLate(ty*cols + tx, from, stamp);
+    }
+}
+
+// Calculates the pixel bounds u of the tiles that box covers and in
+// which a stray pixel may have painted over display list entry i after
+// it was drawn. Returns false if there are none.
+bool Scheduler::LateTiles(int i, const int box[4], int u[4]) const
+{
+    int t[4];
+    bool found = false;
+
+    if (!TileRange(surface, box, t))
+        return false;
+    u[0] = u[1] = INT_MAX;
+    u[2] = u[3] = INT_MIN;
+    for (int ty = t[1]; ty <= t[3]; ty++)
+    {
+        for (int tx = t[0]; tx <= t[2]; tx++)
+        {
+            const std::vector<LATE>& list = late[ty*cols + tx];
+            size_t j = 0;
+
+            while (j < list.size() &&
+                   (list[j].from > i || list[j].serial <= drawn[i]))
+            {
+                j++;
+            }
+            if (j == list.size())
+                continue;
+            u[0] = std::min(u[0], tx << TILE_SHIFT);
+            u[1] = std::min(u[1], ty << TILE_SHIFT);
+            u[2] = std::max(u[2], ((tx + 1) << TILE_SHIFT) - 1);
+            u[3] = std::max(u[3], ((ty + 1) << TILE_SHIFT) - 1);
+            found = true;
+        }
+    }
+    return found;
+}
+
+// Forgets the stray pixels recorded by MarkLate
+void Scheduler::ClearLate()
+{
+    for (size_t k = 0; k < late.size(); k++)
+        late[k].clear();
+    std::fill(lateTop.begin(), lateTop.end(), -1);
+    anyLate = false;
+}
+
+// Queues repairs, in display list order, of the entries that stray
+// pixels may have painted over. Called when all other jobs are done,
+// so the box of every entry includes all of its pixels. As in Submit,
+// each repair paints over the entries above it in the tiles it covers,
+// and these are repaired too. Returns false if there is nothing to
+// repair.
+bool Scheduler::QueueLate()
+{
+    std::vector<JOB> queue;
+
+    if (!anyLate)
+        return false;
+    for (size_t i = 0; i < prims.size(); i++)
+    {
+        JOB draw = MakeJob(i, prims[i], &boxes[4*i]);
+        int u[4];
+
+        if (LateTiles(i, draw.box, u))
+        {
+            draw.box[0] = std::max(draw.box[0], u[0]);
+            draw.box[1] = std::max(draw.box[1], u[1]);
+            draw.box[2] = std::min(draw.box[2], u[2]);
+            draw.box[3] = std::min(draw.box[3], u[3]);
+            draw.repair = true;
+            QueueDraw(queue, draw);
+            MarkLate(draw.box, i + 1, INT_MAX);
+        }
+    }
+    ClearLate();
+    jobs.swap(queue);
+    nextJob = 0;
+    return !jobs.empty();
+}
+
+//---------------------------------------------------------------------
+// Render function -- Works through the queued jobs until budget pixels
+// have been drawn or the frame is complete. Returns the number of
+// pixels drawn, which can exceed the budget by the length of a span.
+//---------------------------------------------------------------------
+int Scheduler::Render()
+{
+    int count = 0;
+
+    while (count < budget)
+    {
+        if (!active)
+        {
+            if (nextJob == jobs.size() && !QueueLate())
+                break;  // frame is complete
+            StartJob();
+        }
+        count += Step(budget - count);
+    }
+    return count;
+}
+
+//---------------------------------------------------------------------
+// AdjustBudget function -- Updates the budget after a call to Render
+// that drew pixels pixels in ms milliseconds, so that later calls take
+// about RENDER_MS milliseconds. A call that finished the frame early
+// says nothing about how many more pixels would fit, so the budget is
+// raised only by a call that used all of it.
+//---------------------------------------------------------------------
+void Scheduler::AdjustBudget(int pixels, double ms)
+{
+    double target;
+
+    if (ms <= 0 || (pixels < budget && ms < RENDER_MS))
+        return;
+    target = pixels*RENDER_MS/ms;
+    target = (budget + target)/2;  // damp changes from frame to frame
+    budget = (int)std::min(std::max(target, (double)MIN_BUDGET),
+                           (double)MAX_BUDGET);
+}
@@ -0,0 +1,149 @@
+//---------------------------------------------------------------------
+//
+// sched.h -- Include file for the DisplayList and Scheduler classes,
+//     which draw a frame into a Surface a few pixels at a time
+//
+//---------------------------------------------------------------------
+
+#ifndef SCHED_H
+#define SCHED_H
+
+#include <stddef.h>
+#include <vector>
+#include "surface.h"
+
+// Types of primitives in a display list. Points pt[0], pt[1], and
+// pt[2] are the arguments of the function that draws the primitive,
+// except for a PRIM_POLY_SPLINE, whose points are in poly.
+enum
+{
+    PRIM_LINE,                 // Line from pt[0] to pt[1]
+    PRIM_RECT,                 // filled rectangle, corners pt[0], pt[1]
+    PRIM_ELLIPSE,              // Ellipse, center pt[0]
+    PRIM_ELLIPTIC_SPLINE,      // EllipticSpline, control point pt[1]
+    PRIM_PARABOLIC_SPLINE,     // ParabolicSpline, control point pt[1]
+    PRIM_ELLIPTIC_SPLINE_FX,   // EllipticSplineFx, fixed-point
+    PRIM_PARABOLIC_SPLINE_FX,  // ParabolicSplineFx, fixed-point
+    PRIM_POLY_SPLINE           // PolySpline through poly, with splines
+                               // of the type in pt[0].x
+};
+
+// A display list entry: a primitive to draw in a single color
+struct PRIM
+{
+    int type;
+    COLOR color;
+    XYVAL pt[3];
+    std::vector<XYVAL> poly;   // knots and control points of a
+                               // PRIM_POLY_SPLINE
+};
+
+// The DisplayList class collects the primitives that make up one
+// frame, in the order in which they are to be drawn
+//
+class DisplayList
+{
+public:
+    std::vector<PRIM> prims;
+
+    void Clear()
+    {
+        prims.clear();
+    }
+    void Add(int type, COLOR color, int x0, int y0, int x1, int y1,
+             int x2 = 0, int y2 = 0);
+    void AddPolyline(COLOR color, const XYVAL xy[], int npts);
+    void AddPolySpline(int type, COLOR color, const XYVAL xy[], int npts);
+};
+
+// Implemented in sched.cpp
+extern void DrawPrim(const PRIM& prim);
+
+// The Scheduler class draws a display list into a surface with a
+// budget of so many pixels per call, so that the time spent drawing a
+// frame has an upper bound however large the scene is. Each curve is
+// drawn by a ConicIter, which can stop in the middle of the curve and
+// pick up again in the next call. Submit replaces the display list:
+// an entry that changed is first erased (by drawing its old version
+// in the background color), and is drawn ahead of the entries that
+// are still waiting to be drawn. Unchanged entries that overlap an
+// erased entry are drawn again to repair them. The box of an entry
+// comes from its integer bounds; a curve that misses a turn and draws
+// outside its box has the tiles of those pixels repaired once the
+// other jobs are done. The surface can be shown after each call to
+// Render, so that a frame too large for the budget appears over
+// several calls instead of holding up the demo.
+//
+class Scheduler
+{
+public:
+    int budget;          // maximum number of pixels drawn by Render
+
+    Scheduler(Surface *surface, COLOR background);
+    ~Scheduler()
+    {
+    }
+    void Submit(const DisplayList& list);
+    int Render();
+    void AdjustBudget(int pixels, double ms);
+    bool Done() const
+    {
+        return !active && nextJob == jobs.size() && !anyLate;
+    }
+
+private:
+    // Drawing states of display list entries
+    enum { NOT_DRAWN, PART_DRAWN, DRAWN };
+
+    // A display list entry to draw, or an old entry to erase
+    struct JOB
+    {
+        int index;       // display list index, or -1 to erase
+        PRIM prim;
+        int box[4];      // bounds of the pixels of prim, or of a repair
+        bool repair;     // true if pixels outside box are skipped
+    };
+
+    // A record that a tile was painted over after the entries in it
+    // were drawn (see Stray)
+    struct LATE
+    {
+        int from;        // lowest display list entry painted over
+        int serial;      // serial number of the job that painted
+    };
+    Surface *surface;
+    COLOR background;
+    int cols;                     // number of tiles in each row
+    std::vector<std::vector<LATE> > late;  // LATE records of each tile
+    std::vector<int> lateTop;     // highest entry with stray pixels in
+                                  // each tile, or -1
+    bool anyLate;                 // true if any stray pixels recorded
+    int serial;                   // serial number of job in progress
+    std::vector<PRIM> prims;      // current display list
+    std::vector<int> boxes;       // bounds of the pixels of each entry
+    std::vector<int> state;       // drawing state of each entry
+    std::vector<int> pending;     // number of queued jobs for each entry
+    std::vector<int> drawn;       // job that last drew each entry in full
+    std::vector<JOB> jobs;        // jobs waiting to be started
+    size_t nextJob;               // index of next job in jobs
+    bool active;                  // true if job is in progress
+    JOB job;                      // job in progress
+    std::vector<SEGMENT> segs;    // segments of curve in progress
+    size_t nextSeg;               // index of next segment in segs
+    ConicIter iter;               // pixels of current segment
+    int row;                      // next row of a PRIM_RECT
+
+    static JOB MakeJob(int index, const PRIM& prim, const int box[4]);
+    void QueueDraw(std::vector<JOB>& queue, const JOB& draw);
+    void StartJob();
+    int Step(int limit);
+    void Stray(int xl, int xr, int y);
+    void AddLate(int k, int from, int stamp);
+    void MarkLate(const int box[4], int from, int stamp);
+    void CoverLate();
+    bool LateTiles(int i, const int box[4], int u[4]) const;
+    void ClearLate();
+    bool QueueLate();
+};
+
+#endif  // SCHED_H
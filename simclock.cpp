@@ -0,0 +1,98 @@
+//---------------------------------------------------------------------
+//
+// simclock.cpp -- SimClock and FrameStats class member functions
+//
+//---------------------------------------------------------------------
+
+#include <math.h>
+#include "conic.h"
+#include "simclock.h"
+
+// Constructor
+SimClock::SimClock(double stepMs) :
+            stepMs(stepMs), last(0), lag(0), started(false), skipped(0)
+{
+}
+
+//---------------------------------------------------------------------
+// Tick function -- Advances the clock to time nowMs, in milliseconds,
+// and returns the number of simulation steps to run. The first call
+// only starts the clock, and returns zero.
+//---------------------------------------------------------------------
+int SimClock::Tick(double nowMs)
+{
+    int steps;
+
+    if (!started)
+    {
+        started = true;
+        last = nowMs;
+        return 0;
+    }
+    lag += nowMs - last;
+    last = nowMs;
+    steps = (int)(lag/stepMs);
+    if (steps > MAX_STEPS)
+    {
+        skipped += steps - MAX_STEPS;
+        steps = MAX_STEPS;
+        lag = fmod(lag, stepMs);
+    }
+    else
+        lag -= steps*stepMs;
+    return steps;
+}
+
+// Returns the time left over by the last Tick call, as a fixed-point
+// fraction of a step, from 0 to FIX_ONE
+int SimClock::Alpha() const
+{
+    int alpha = (int)(lag*FIX_ONE/stepMs);
+
+    return (alpha > FIX_ONE) ? FIX_ONE : alpha;
+}
+
+// Constructor
+FrameStats::FrameStats(double frameMs) :
+            frameMs(frameMs), last(0), frames(0), dropped(0),
+            sum(0), sumSq(0), worst(0)
+{
+}
+
+// Records a frame shown at time nowMs, in milliseconds
+void FrameStats::Add(double nowMs)
+{
+    if (frames++ > 0)
+    {
+        double ms = nowMs - last;
+        int missed = (int)(ms/frameMs + 0.5) - 1;
+
+        sum += ms;
+        sumSq += ms*ms;
+        if (ms > worst)
+            worst = ms;
+        if (missed > 0)
+            dropped += missed;
+    }
+    last = nowMs;
+}
+
+// Writes the statistics to fp. The skipped argument is the number of
+// simulation steps skipped, from SimClock::Skipped.
+void FrameStats::Report(FILE *fp, int skipped) const
+{
+    int n = frames - 1;  // number of frame times
+    double mean, jitter;
+
+    if (n < 1)
+    {
+        fprintf(fp, "No frame times measured\n");
+        return;
+    }
+    mean = sum/n;
+    jitter = sqrt(fabs(sumSq/n - mean*mean));
+    fprintf(fp, "Frames: %d, mean %.2f ms, jitter %.2f ms, worst %.2f ms\n",
+            frames, mean, jitter, worst);
+    fprintf(fp, "Dropped frames: %d, simulation steps skipped: %d\n",
+            dropped, skipped);
+}
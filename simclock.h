@@ -0,0 +1,74 @@
+//---------------------------------------------------------------------
+//
+// simclock.h -- Include file for the SimClock and FrameStats classes,
+//     which pace an animation by the clock instead of by the frame
+//
+//---------------------------------------------------------------------
+
+#ifndef SIMCLOCK_H
+#define SIMCLOCK_H
+
+#include <stdio.h>
+
+// The SimClock class runs a simulation with a fixed time step, so that
+// the speed of an animation does not depend on how fast its frames
+// are drawn. The caller reads a monotonic, high-resolution timer once
+// per frame and passes the time to Tick, which returns the number of
+// simulation steps to run before the frame is drawn. The time left
+// over is less than one step; Alpha returns it as a fixed-point
+// fraction of a step, from 0 to FIX_ONE, to interpolate between the
+// states before and after the last step. After a long stall, no more
+// than MAX_STEPS steps are run, and the rest of the backlog is
+// skipped, so that the animation does not race to catch up.
+//
+class SimClock
+{
+public:
+    enum { MAX_STEPS = 5 };
+
+    SimClock(double stepMs);
+    ~SimClock()
+    {
+    }
+    int Tick(double nowMs);
+    int Alpha() const;
+    int Skipped() const
+    {
+        return skipped;
+    }
+
+private:
+    double stepMs;       // length of a step, in milliseconds
+    double last;         // time of previous Tick call
+    double lag;          // time not yet simulated
+    bool started;        // true after the first Tick call
+    int skipped;         // number of steps skipped after stalls
+};
+
+// The FrameStats class collects the times at which frames are shown,
+// and reports the mean time between frames, the jitter (the standard
+// deviation of the time between frames), the longest time between
+// frames, and the number of frames dropped. A frame is counted as
+// dropped each time that a nominal frame interval passes without a
+// frame being shown.
+//
+class FrameStats
+{
+public:
+    FrameStats(double frameMs);
+    ~FrameStats()
+    {
+    }
+    void Add(double nowMs);
+    void Report(FILE *fp, int skipped) const;
+
+private:
+    double frameMs;      // nominal time between frames
+    double last;         // time of previous frame
+    int frames;          // number of frames
+    int dropped;         // number of frames dropped
+    double sum, sumSq;   // sum and sum of squares of frame times
+    double worst;        // longest frame time
+};
+
+#endif  // SIMCLOCK_H
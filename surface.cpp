@@ -0,0 +1,109 @@
+//---------------------------------------------------------------------
+//
+// surface.cpp -- Surface class member functions
+//
+//---------------------------------------------------------------------
+
+#include <algorithm>
+#include "surface.h"
+
+// Constructor
+Surface::Surface(int width, int height) :
+            width(width), height(height), color(WHITE)
+{
+    tileCols = (width + TILE_SIZE - 1) >> TILE_SHIFT;
+    tileRows = (height + TILE_SIZE - 1) >> TILE_SHIFT;
+    dirty.resize(tileCols*tileRows);
+    pixels = new COLOR[width*height];
+    Clear(BLACK);
+}
+
+// Destructor
+Surface::~Surface()
+{
+    delete[] pixels;
+}
+
+// Sets every pixel in the surface to color rgb
+void Surface::Clear(COLOR rgb)
+{
+    for (int i = 0; i < width*height; i++)
+        pixels[i] = rgb;
+    std::fill(dirty.begin(), dirty.end(), 1);
+}
+
+// Fills the horizontal span of pixels from (xl,y) to (xr,y), inclusive
+void Surface::Span(int xl, int xr, int y)
+{
+    if ((unsigned)y >= (unsigned)height)
+        return;
+    if (xl < 0)
+        xl = 0;
+    if (xr >= width)
+        xr = width - 1;
+    if (xl > xr)
+        return;
+
+    COLOR *p = &pixels[y*width];
+    for (int x = xl; x <= xr; x++)
+        p[x] = color;
+
+    char *d = &dirty[(y >> TILE_SHIFT)*tileCols];
+    for (int tx = xl >> TILE_SHIFT; tx <= xr >> TILE_SHIFT; tx++)
+        d[tx] = 1;
+}
+
+// Fills the rectangle from (xmin,ymin) to (xmax,ymax), inclusive
+void Surface::FillRect(int xmin, int ymin, int xmax, int ymax)
+{
+    for (int y = ymin; y <= ymax; y++)
+        Span(xmin, xmax, y);
+}
+
+// Marks the tiles overlapped by the rectangle from (xmin,ymin) to
+// (xmax,ymax) as dirty, without changing any pixels
+void Surface::MarkDirty(int xmin, int ymin, int xmax, int ymax)
+{
+    xmin = std::max(xmin, 0) >> TILE_SHIFT;
+    ymin = std::max(ymin, 0) >> TILE_SHIFT;
+    xmax = std::min(xmax, width - 1) >> TILE_SHIFT;
+    ymax = std::min(ymax, height - 1) >> TILE_SHIFT;
+    for (int ty = ymin; ty <= ymax; ty++)
+    {
+        for (int tx = xmin; tx <= xmax; tx++)
+            dirty[ty*tileCols + tx] = 1;
+    }
+}
+
+//---------------------------------------------------------------------
+// GetDirtyRects function -- Finds the tiles that have been written to
+// since the previous call, and clears their dirty marks. Each run of
+// adjacent dirty tiles in a row of tiles is written to rects as a
+// rectangle {xmin, ymin, xmax, ymax}, clipped to the surface, so that
+// rects holds four values per rectangle. Returns the number of
+// rectangles.
+//---------------------------------------------------------------------
+int Surface::GetDirtyRects(std::vector<int>& rects)
+{
+    rects.clear();
+    for (int ty = 0; ty < tileRows; ty++)
+    {
+        char *d = &dirty[ty*tileCols];
+
+        for (int tx = 0; tx < tileCols; tx++)
+        {
+            if (!d[tx])
+                continue;
+
+            int first = tx;
+
+            while (tx < tileCols && d[tx])
+                d[tx++] = 0;
+            rects.push_back(first << TILE_SHIFT);
+            rects.push_back(ty << TILE_SHIFT);
+            rects.push_back(std::min(tx << TILE_SHIFT, width) - 1);
+            rects.push_back(std::min((ty + 1) << TILE_SHIFT, height) - 1);
+        }
+    }
+    return rects.size()/4;
+}
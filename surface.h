@@ -0,0 +1,58 @@
+//---------------------------------------------------------------------
+//
+// surface.h -- Include file for the Surface class, a software
+//     framebuffer that the demo programs draw into
+//
+//---------------------------------------------------------------------
+
+#ifndef SURFACE_H
+#define SURFACE_H
+
+#include <vector>
+#include "demo.h"
+
+// The Surface class is a software framebuffer that holds one 32-bit
+// COLOR value per pixel. The pixels are stored row by row, starting
+// at the top-left corner, so that a demo program can copy the whole
+// array to the screen in a single call. Plot, Span, and FillRect draw
+// in the current color, and quietly skip any pixels that fall outside
+// the surface, so curves can be drawn straight into the framebuffer.
+// The surface is divided into square tiles of TILE_SIZE pixels, and
+// each function that writes pixels marks the tiles it touches as
+// dirty. GetDirtyRects reports the dirty tiles, so that a demo copies
+// to the screen only the parts of the surface that have changed.
+//
+class Surface
+{
+public:
+    enum { TILE_SHIFT = 5, TILE_SIZE = 1 << TILE_SHIFT };
+
+    COLOR *pixels;       // width*height pixels, row by row
+    int width, height;   // size in pixels
+    COLOR color;         // color used by Plot, Span, and FillRect
+
+    Surface(int width, int height);
+    ~Surface();
+    void Clear(COLOR rgb);
+    void Plot(int x, int y)
+    {
+        if ((unsigned)x < (unsigned)width && (unsigned)y < (unsigned)height)
+        {
+            pixels[y*width + x] = color;
+            dirty[(y >> TILE_SHIFT)*tileCols + (x >> TILE_SHIFT)] = 1;
+        }
+    }
+    void Span(int xl, int xr, int y);
+    void FillRect(int xmin, int ymin, int xmax, int ymax);
+    void MarkDirty(int xmin, int ymin, int xmax, int ymax);
+    int GetDirtyRects(std::vector<int>& rects);
+
+private:
+    int tileCols, tileRows;      // number of columns and rows of tiles
+    std::vector<char> dirty;     // nonzero for each tile written to
+
+    Surface(const Surface&);             // not copyable
+    Surface& operator=(const Surface&);
+};
+
+#endif  // SURFACE_H
@@ -0,0 +1,202 @@
+//---------------------------------------------------------------------
+//
+// tiled.cpp -- TiledSurface class member functions
+//
+//---------------------------------------------------------------------
+
+#include <string.h>
+#include <algorithm>
+#include "tiled.h"
+
+// The SIMD version of Detile for Morton order is compiled wherever
+// SSE2 is available, as it is on every x86-64 processor
+#if defined(__SSE2__) || defined(_M_X64)
+#define TILED_SSE2
+#include <emmintrin.h>
+#endif
+
+// Returns n with the bits spread apart, so that bit k moves to bit 2k
+static int Spread(int n)
+{
+    int m = 0;
+
+    for (int k = 0; k < TiledSurface::MAX_TILE_SHIFT; k++)
+        m |= ((n >> k) & 1) << 2*k;
+    return m;
+}
+
+// Constructor. The tile size is limited to 2^MAX_TILE_SHIFT pixels.
+TiledSurface::TiledSurface(int width, int height, int tileShift,
+                           bool morton) :
+            width(width), height(height), color(WHITE),
+            tileShift(std::min(std::max(tileShift, 0), (int)MAX_TILE_SHIFT)),
+            morton(morton)
+{
+    tileSize = 1 << this->tileShift;
+    tileCols = (width + tileSize - 1) >> this->tileShift;
+    tileRows = (height + tileSize - 1) >> this->tileShift;
+    for (int i = 0; i < tileSize; i++)
+    {
+        xoff[i] = morton ? Spread(i) : i;
+        yoff[i] = morton ? Spread(i) << 1 : i << this->tileShift;
+    }
+    pixels = new COLOR[(tileCols*tileRows) << (2*this->tileShift)];
+    Clear(BLACK);
+}
+
+// Destructor
+TiledSurface::~TiledSurface()
+{
+    delete[] pixels;
+}
+
+// Sets every pixel in the surface to color rgb
+void TiledSurface::Clear(COLOR rgb)
+{
+    int n = (tileCols*tileRows) << (2*tileShift);
+
+    for (int i = 0; i < n; i++)
+        pixels[i] = rgb;
+}
+
+// Fills the horizontal span of pixels from (xl,y) to (xr,y), inclusive.
+// The part of the span in each tile is one run of pixels if the tile
+// is stored row by row; in Morton order, it is a series of pairs.
+void TiledSurface::Span(int xl, int xr, int y)
+{
+    if ((unsigned)y >= (unsigned)height)
+        return;
+    if (xl < 0)
+        xl = 0;
+    if (xr >= width)
+        xr = width - 1;
+    if (xl > xr)
+        return;
+
+    int mask = tileSize - 1;
+    int row = yoff[y & mask];
+
+    for (int tx = xl >> tileShift; tx <= xr >> tileShift; tx++)
+    {
+        COLOR *p = &pixels[Tile(tx, y >> tileShift) + row];
+        int x0 = std::max(xl, tx << tileShift) & mask;
+        int x1 = std::min(xr, ((tx + 1) << tileShift) - 1) & mask;
+
+        if (!morton)
+        {
+            std::fill(p + x0, p + x1 + 1, color);
+            continue;
+        }
+        for (int x = x0; x <= x1; x++)
+            p[xoff[x]] = color;
+    }
+}
+
+// Fills the rectangle from (xmin,ymin) to (xmax,ymax), inclusive
+void TiledSurface::FillRect(int xmin, int ymin, int xmax, int ymax)
+{
+    for (int y = ymin; y <= ymax; y++)
+        Span(xmin, xmax, y);
+}
+
+// Copies the whole of tile (tx,ty) to dst, which receives the tile's
+// top-left pixel, with rows pitch pixels apart. Rows of a tile stored
+// row by row are copied whole. A tile in Morton order is copied one
+// 4-by-4 block of pixels at a time: the block is 16 contiguous pixels,
+// in which each group of four is a 2-by-2 block, so two 64-bit
+// unpacks of a pair of groups give two rows of the block.
+void TiledSurface::DetileTile(int tx, int ty, COLOR *dst, int pitch) const
+{
+    const COLOR *src = &pixels[Tile(tx, ty)];
+
+    if (!morton)
+    {
+        for (int y = 0; y < tileSize; y++, src += tileSize, dst += pitch)
+            memcpy(dst, src, tileSize*sizeof(COLOR));
+        return;
+    }
+#ifdef TILED_SSE2
+    if (tileSize >= 4)
+    {
+        for (int y = 0; y < tileSize; y += 4)
+        {
+            for (int x = 0; x < tileSize; x += 4)
+            {
+                const __m128i *s = (const __m128i *)&src[yoff[y] + xoff[x]];
+                __m128i v0 = _mm_loadu_si128(s);
+                __m128i v1 = _mm_loadu_si128(s + 1);
+                __m128i v2 = _mm_loadu_si128(s + 2);
+                __m128i v3 = _mm_loadu_si128(s + 3);
+                COLOR *d = &dst[y*pitch + x];
+
+                _mm_storeu_si128((__m128i *)d, _mm_unpacklo_epi64(v0, v1));
+                _mm_storeu_si128((__m128i *)(d + pitch),
+                                 _mm_unpackhi_epi64(v0, v1));
+                _mm_storeu_si128((__m128i *)(d + 2*pitch),
+                                 _mm_unpacklo_epi64(v2, v3));
+                _mm_storeu_si128((__m128i *)(d + 3*pitch),
+                                 _mm_unpackhi_epi64(v2, v3));
+            }
+        }
+        return;
+    }
+#endif
+    for (int y = 0; y < tileSize; y++, dst += pitch)
+    {
+        for (int x = 0; x < tileSize; x++)
+            dst[x] = src[yoff[y] + xoff[x]];
+    }
+}
+
+//---------------------------------------------------------------------
+// Detile function -- Copies the pixels in the rectangle from
+// (xmin,ymin) to (xmax,ymax), inclusive, to a buffer in which they
+// are stored row by row, as in a Surface. Pixel (xmin,ymin) is written
+// to dst[0], and each row is pitch pixels after the one above it.
+// Tiles that lie wholly inside the rectangle are copied by
+// DetileTile; the pixels of the other tiles are copied one at a time.
+//---------------------------------------------------------------------
+void TiledSurface::Detile(int xmin, int ymin, int xmax, int ymax,
+                          COLOR *dst, int pitch) const
+{
+    int mask = tileSize - 1;
+
+    if (xmin < 0)
+    {
+        dst -= xmin;
+        xmin = 0;
+    }
+    if (ymin < 0)
+    {
+        dst -= ymin*pitch;
+        ymin = 0;
+    }
+    xmax = std::min(xmax, width - 1);
+    ymax = std::min(ymax, height - 1);
+    for (int ty = ymin >> tileShift; ty <= ymax >> tileShift; ty++)
+    {
+        int y0 = std::max(ymin, ty << tileShift);
+        int y1 = std::min(ymax, ((ty + 1) << tileShift) - 1);
+
+        for (int tx = xmin >> tileShift; tx <= xmax >> tileShift; tx++)
+        {
+            int x0 = std::max(xmin, tx << tileShift);
+            int x1 = std::min(xmax, ((tx + 1) << tileShift) - 1);
+            COLOR *d = &dst[(y0 - ymin)*pitch + x0 - xmin];
+
+            if (x1 - x0 == mask && y1 - y0 == mask)
+            {
+                DetileTile(tx, ty, d, pitch);
+                continue;
+            }
+
+            const COLOR *src = &pixels[Tile(tx, ty)];
+
+            for (int y = y0; y <= y1; y++, d += pitch)
+            {
+                for (int x = x0; x <= x1; x++)
+                    d[x - x0] = src[yoff[y & mask] + xoff[x & mask]];
+            }
+        }
+    }
+}
@@ -0,0 +1,74 @@
+//---------------------------------------------------------------------
+//
+// tiled.h -- Include file for the TiledSurface class, a software
+//     framebuffer whose pixels are stored tile by tile
+//
+//---------------------------------------------------------------------
+
+#ifndef TILED_H
+#define TILED_H
+
+#include "demo.h"
+
+// The TiledSurface class is a software framebuffer that holds one
+// 32-bit COLOR value per pixel, like a Surface, but stores the pixels
+// in square tiles, one tile after another, rather than row by row. A
+// curve that steps from one row to the next then stays within the
+// same tile, and usually within the same cache line, instead of
+// moving a whole row of the surface ahead in memory. The tiles are
+// 2^tileShift pixels on a side, and are stored row by row. Within a
+// tile, the pixels are stored either row by row or, if morton is
+// true, in Morton (Z) order, in which the bits of x and y are
+// interleaved, so that every 2-by-2, 4-by-4, 8-by-8, ... block of
+// pixels is contiguous. Plot, Span, and FillRect draw in the current
+// color, and skip any pixels that fall outside the surface. To
+// present the surface, Detile copies a rectangle of it into an
+// ordinary row-by-row buffer.
+//
+class TiledSurface
+{
+public:
+    enum { MAX_TILE_SHIFT = 6, MAX_TILE_SIZE = 1 << MAX_TILE_SHIFT };
+
+    COLOR *pixels;       // tileCols*tileRows tiles, tile by tile
+    int width, height;   // size in pixels
+    COLOR color;         // color used by Plot, Span, and FillRect
+    int tileShift;       // log2 of the width and height of a tile
+    bool morton;         // true if pixels within a tile are in Z order
+    int tileCols, tileRows;  // number of columns and rows of tiles
+
+    TiledSurface(int width, int height, int tileShift, bool morton);
+    ~TiledSurface();
+    void Clear(COLOR rgb);
+    void Plot(int x, int y)
+    {
+        if ((unsigned)x < (unsigned)width && (unsigned)y < (unsigned)height)
+        {
+            int mask = tileSize - 1;
+
+            pixels[Tile(x >> tileShift, y >> tileShift) +
+                   yoff[y & mask] + xoff[x & mask]] = color;
+        }
+    }
+    void Span(int xl, int xr, int y);
+    void FillRect(int xmin, int ymin, int xmax, int ymax);
+    void Detile(int xmin, int ymin, int xmax, int ymax,
+                COLOR *dst, int pitch) const;
+
+private:
+    int tileSize;                // width and height of a tile
+    int xoff[MAX_TILE_SIZE];     // offset within a tile of each column
+    int yoff[MAX_TILE_SIZE];     // offset within a tile of each row
+
+    // Returns the offset of the first pixel of tile (tx,ty)
+    int Tile(int tx, int ty) const
+    {
+        return (ty*tileCols + tx) << (2*tileShift);
+    }
+    void DetileTile(int tx, int ty, COLOR *dst, int pitch) const;
+
+    TiledSurface(const TiledSurface&);           // not copyable
+    TiledSurface& operator=(const TiledSurface&);
+};
+
+#endif  // TILED_H
@@ -0,0 +1,74 @@
+//---------------------------------------------------------------------
+//
+// tribuf.h -- Include file for the TripleBuffer class template, which
+//     passes values from one thread to another without locking
+//
+//---------------------------------------------------------------------
+
+#ifndef TRIBUF_H
+#define TRIBUF_H
+
+#include <atomic>
+
+// The TripleBuffer class template passes a series of values of type T
+// from a producer thread to a consumer thread. The producer fills in
+// the value returned by Back, and then calls Publish to hand it over.
+// The consumer calls Take to get the most recently published value,
+// which it reads through Front. The three values swap roles without
+// being copied, and neither thread ever waits for the other. If the
+// producer publishes twice before the consumer takes a value, the
+// older value is dropped, so the consumer always sees the latest
+// one; Publish returns true in that case, and the dropped value is
+// returned by Back, in case the producer needs to carry anything in
+// it over to the next value. Only one thread can produce values, and
+// only one thread can consume them.
+//
+template<class T>
+class TripleBuffer
+{
+public:
+    TripleBuffer() : back(0), middle(1), front(2)
+    {
+    }
+    ~TripleBuffer()
+    {
+    }
+    T& Back()
+    {
+        return buf[back];
+    }
+    T& Front()
+    {
+        return buf[front];
+    }
+    bool Publish()
+    {
+        int old = middle.exchange(back | FRESH, std::memory_order_acq_rel);
+
+        back = old & INDEX;
+        return (old & FRESH) != 0;
+    }
+    bool Take()
+    {
+        if (!(middle.load(std::memory_order_relaxed) & FRESH))
+            return false;  // nothing new since the last call
+
+        int old = middle.exchange(front, std::memory_order_acq_rel);
+
+        front = old & INDEX;
+        return true;
+    }
+
+private:
+    enum { INDEX = 3, FRESH = 4 };
+    T buf[3];
+    int back;                  // index of value that producer fills in
+    std::atomic<int> middle;   // index of value in between, plus FRESH
+                               // if it has been published but not taken
+    int front;                 // index of value that consumer reads
+
+    TripleBuffer(const TripleBuffer&);             // not copyable
+    TripleBuffer& operator=(const TripleBuffer&);
+};
+
+#endif  // TRIBUF_H
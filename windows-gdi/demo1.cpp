@@ -77,17 +77,10 @@ void DrawPixel(int x, int y)
 // (x2,y2) of two conjugate diameters of the ellipse.
 void BoundingBox(HDC hdc, int x0, int y0, int x1, int y1, int x2, int y2)
 {
-    float xp, yp, xq, yq;
-    int xbox, ybox;
-
-    // Translate center of ellipse to origin
-    xp = x1 - x0;
-    yp = y1 - y0;
-    xq = x2 - x0;
-    yq = y2 - y0;
-    xbox = sqrt(xp*xp + xq*xq) + 0.5;
-    ybox = sqrt(yp*yp + yq*yq) + 0.5;
-    Rectangle(hdc, x0-xbox-1, y0-ybox-1, x0+xbox+2, y0+ybox+2);
+    int box[4];
+
+    EllipseBox(x0, y0, x1, y1, x2, y2, box);
+    Rectangle(hdc, box[0]-1, box[1]-1, box[2]+2, box[3]+2);
 }
 
 // Draw the enclosing polygon for an ellipse given the center
@@ -99,56 +92,13 @@ void BoundingBox(HDC hdc, int x0, int y0, int x1, int y1, int x2, int y2)
 // exactly one point, at which the side is tangent to the ellipse.
 void BoundingPgon(HDC hdc, int x0, int y0, int x1, int y1, int x2, int y2)
 {
-    float xp, yp, xq, yq;
-    float tmp1, tmp2;
-    float X, Y, Z, W, U, V;
-    POINT xy[9];
-
-    // Translate center of ellipse to origin
-    xp = x1 - x0;
-    yp = y1 - y0;
-    xq = x2 - x0;
-    yq = y2 - y0;
-
-    // Compute vertexes of bounding polygon
-    X = sqrt(xp*xp + xq*xq);
-    Y = sqrt(yp*yp + yq*yq);
-    tmp1 = xp + yp;
-    tmp2 = xq + yq;
-    Z = sqrt(tmp1*tmp1+tmp2*tmp2);
-    tmp1 = xp - yp;
-    tmp2 = xq - yq;
-    W = sqrt(tmp1*tmp1+tmp2*tmp2);
-
-    xy[0].x = x0 + 0.5 + X;
-    xy[0].y = y0 + 0.5 - X + Z;
-
-    xy[1].x = x0 + 0.5 - Y + Z;
-    xy[1].y = y0 + 0.5 + Y;
-
-    xy[2].x = x0 + 0.5 + Y - W;
-    xy[2].y = y0 + 0.5 + Y;
-
-    xy[3].x = x0 + 0.5 - X;
-    xy[3].y = y0 + 0.5 - X + W;
-
-    xy[4].x = x0 + 0.5 - X;
-    xy[4].y = y0 + 0.5 + X - Z;
+    XYVAL xy[9];
 
-    xy[5].x = x0 + 0.5 + Y - Z;
-    xy[5].y = y0 + 0.5 - Y;
-
-    xy[6].x = x0 + 0.5 - Y + W;
-    xy[6].y = y0 + 0.5 - Y;
-
-    xy[7].x = x0 + 0.5 + X;
-    xy[7].y = y0 + 0.5 + X - W;
-
-    xy[8].x = xy[0].x;  // close polyline
-    xy[8].y = xy[0].y;
+    EllipsePgon(x0, y0, x1, y1, x2, y2, xy);
+    xy[8] = xy[0];  // close polyline
 
     // Draw eight sides of bounding polygon
-    Polyline(hdc, xy, 9);
+    Polyline(hdc, (POINT*)xy, 9);
 }
 
 // Draw an 8-sided polygon inscribed in an ellipse specified
@@ -161,63 +111,16 @@ void BoundingPgon(HDC hdc, int x0, int y0, int x1, int y1, int x2, int y2)
 // function) touches (and is tangent to) the ellipse.
 void InscribedPgon(HDC hdc, int x0, int y0, int x1, int y1, int x2, int y2)
 {
-    float xp, yp, xq, yq;
-    float tmp1, tmp2;
-    float X, Y, Z, W, U, V;
-    POINT xy[9];
-
-    // Translate center of ellipse to origin
-    xp = x1 - x0;
-    yp = y1 - y0;
-    xq = x2 - x0;
-    yq = y2 - y0;
-
-    // Compute vertexes of framing polygon
-    X = sqrt(xp*xp + xq*xq);
-    Y = sqrt(yp*yp + yq*yq);
-    tmp1 = xp + yp;
-    tmp2 = xq + yq;
-    Z = sqrt(tmp1*tmp1+tmp2*tmp2);
-    tmp1 = xp - yp;
-    tmp2 = xq - yq;
-    W = sqrt(tmp1*tmp1+tmp2*tmp2);
-    if (X == 0 || Y == 0 || Z == 0 || W == 0)
+    XYVAL xy[9];
+
+    if (!EllipseInscribedPgon(x0, y0, x1, y1, x2, y2, xy))
     {
         return;  // degenerate ellipse
     }
-    U = xp*(xp + yp) + xq*(xq + yq);
-    V = xp*(xp - yp) + xq*(xq - yq);
-    tmp1 = xp*yp + xq*yq;
-
-    xy[0].x = x0 + 0.5 + X;
-    xy[0].y = y0 + 0.5 + tmp1/X;
-
-    xy[1].x = x0 + 0.5 + U/Z;    
-    xy[1].y = y0 + 0.5 - U/Z + Z;
-
-    xy[2].x = x0 + 0.5 + tmp1/Y;
-    xy[2].y = y0 + 0.5 + Y;
-
-    xy[3].x = x0 + 0.5 - V/W;    
-    xy[3].y = y0 + 0.5 - V/W + W;
-
-    xy[4].x = x0 + 0.5 - X;      
-    xy[4].y = y0 + 0.5 - tmp1/X; 
-
-    xy[5].x = x0 + 0.5 - U/Z;    
-    xy[5].y = y0 + 0.5 + U/Z - Z;
-
-    xy[6].x = x0 + 0.5 - tmp1/Y; 
-    xy[6].y = y0 + 0.5 - Y;      
-
-    xy[7].x = x0 + 0.5 + V/W;    
-    xy[7].y = y0 + 0.5 + V/W - W;
-
-    xy[8].x = xy[0].x;  // close polyline
-    xy[8].y = xy[0].y;
+    xy[8] = xy[0];  // close polyline
 
     // Connect eight vertexes of inscribed polygon
-    Polyline(hdc, xy, 9);
+    Polyline(hdc, (POINT*)xy, 9);
 }
 
 // Draw the major and minor axes for an ellipse given the center
@@ -225,52 +128,14 @@ void InscribedPgon(HDC hdc, int x0, int y0, int x1, int y1, int x2, int y2)
 // (x2,y2) of two conjugate diameters of the ellipse.
 void DrawAxes(HDC hdc, int x0, int y0, int x1, int y1, int x2, int y2)
 {
-    float xp, yp, xq, yq;
-    float A, B, C, F;
-    float xprod, beta, root, slope, denom, x, y;
-    POINT xy[2];
-
-    // Translate center of ellipse to origin
-    xp = x1 - x0;
-    yp = y1 - y0;
-    xq = x2 - x0;
-    yq = y2 - y0;
-
-    // Calculate coefficients A,B,C,F for ellipse equation
-    A = yp*yp + yq*yq;
-    B = -2*(xp*yp + xq*yq);
-    if (B == 0)
-    {
-        return;  // an ellipse in standard position, or a circle
-    }
-    C = xp*xp + xq*xq;
-    xprod = xq*yp - xp*yq;
-    if (xprod == 0)
-    {
-        return;  // area of ellipse is zero
-    }
-    F = -xprod*xprod;
-    beta = (C - A)/B;
-    root = sqrt(beta*beta + 1.0);
-    slope = beta + root;
+    XYVAL xy[4];
 
-    // Each for-loop iteration draws an axis
-    for (int i = 0; i < 2; i++)
+    if (!EllipseAxes(x0, y0, x1, y1, x2, y2, xy))
     {
-        denom = A + (B + C*slope)*slope;
-        if (denom <= 0)
-        {
-            return;  // ultra-thin ellipse
-        }
-        x = sqrt(-F/denom);
-        y = slope*x;
-        xy[0].x = x0 + 0.5 + x;      
-        xy[0].y = y0 + 0.5 + y;
-        xy[1].x = x0 + 0.5 - x;
-        xy[1].y = y0 + 0.5 - y;
-        Polyline(hdc, xy, 2);
-        slope = beta - root;
-    } 
+        return;  // a circle, or area of ellipse is zero
+    }
+    Polyline(hdc, (POINT*)&xy[0], 2);
+    Polyline(hdc, (POINT*)&xy[2], 2);
 }
 
 // Draw updated ellipse in window. Also draw the parallelogram in
@@ -99,11 +99,25 @@ void xyToBary(float xin, float yin, BARYCENT *uvwout,
 
 // Converts barycentric coordinates uvwIn = (u,v,w) to x-y coordinates
 // xyOut given the three vertexes -- xy[0], xy[1], and xy[2] -- of the
-// reference triangle.
+// reference triangle. Like baryToFix, this function rounds to nearest,
+// so that a knot drawn at xyOut lies on the spline through the knot.
 void baryToXy(POINT *xyOut, const BARYCENT *uvwIn, POINT xy[])
 {
-    xyOut->x = uvwIn->u*xy[0].x + uvwIn->v*xy[1].x + uvwIn->w*xy[2].x;
-    xyOut->y = uvwIn->u*xy[0].y + uvwIn->v*xy[1].y + uvwIn->w*xy[2].y;
+    xyOut->x = floor(uvwIn->u*xy[0].x + uvwIn->v*xy[1].x
+                     + uvwIn->w*xy[2].x + 0.5);
+    xyOut->y = floor(uvwIn->u*xy[0].y + uvwIn->v*xy[1].y
+                     + uvwIn->w*xy[2].y + 0.5);
+}
+
+// Converts barycentric coordinates uvwIn = (u,v,w) to fixed-point x-y
+// coordinates fxyOut, with FIX_SHIFT bits of fraction, given the three
+// vertexes -- xy[0], xy[1], and xy[2] -- of the reference triangle.
+void baryToFix(XYVAL *fxyOut, const BARYCENT *uvwIn, POINT xy[])
+{
+    fxyOut->x = floor(FIX_ONE*(uvwIn->u*xy[0].x + uvwIn->v*xy[1].x
+                               + uvwIn->w*xy[2].x) + 0.5);
+    fxyOut->y = floor(FIX_ONE*(uvwIn->u*xy[0].y + uvwIn->v*xy[1].y
+                               + uvwIn->w*xy[2].y) + 0.5);
 }
 
 // Contains conic spline control points for a "splat" glyph (an
@@ -195,6 +209,7 @@ void Splat::Update(HDC hdc, Bounce *bounce)
     HBRUSH hBrush;
     RECT rect;
     POINT xy[49], xyPgram[5];
+    XYVAL fxy[49];
     int i;
 
     // Get vertex coordinates for current parallelogram
@@ -213,6 +228,7 @@ void Splat::Update(HDC hdc, Bounce *bounce)
     for (i = 0; i < 49; i++)
     {
         baryToXy(&xy[i], &uvwSplat[i], xyPgram);
+        baryToFix(&fxy[i], &uvwSplat[i], xyPgram);
         SetRect(&rect, xy[i].x-2, xy[i].y-2, xy[i].x+3, xy[i].y+3);
         FillRect(hdc, &rect, hBrush);
     }
@@ -224,13 +240,13 @@ void Splat::Update(HDC hdc, Bounce *bounce)
     Polyline(hdc, xy, 49);
     DeleteObject(hPen);
 
-    // Draw conic splines consisting of PI/2-radian elliptical arcs
+    // Draw conic splines consisting of PI/2-radian elliptical arcs.
+    // The spline knots and control points are specified with subpixel
+    // precision so that the splines move smoothly with the animation.
+    // PolySpline draws each knot shared by two splines only once.
     g_hdc = hdc;  // set global handle used by DrawPixel function
     g_color = WHITE;
-    for (int i = 2; i < 49; i += 2)
-    {
-        ParabolicSpline(xy[i-2].x, xy[i-2].y, xy[i-1].x, xy[i-1].y, xy[i].x, xy[i].y); 
-    }
+    PolySpline(ParabolicSplineFx, fxy, 49);
     g_hdc = 0;
 }
 
@@ -10,30 +10,51 @@
 #include <stdio.h>
 #include <math.h> 
 #include <assert.h>
+#include <string.h>
 #include "conic.h"
 #include "demo.h"
+#include "record.h"
+#include "sched.h"
+#include "simclock.h"
 
-// Global renderer and color values used by the DrawPixel function
+// Global renderer, and the software framebuffer into which the
+// scheduler draws each frame
 SDL_Renderer *g_renderer = 0;
+Surface *g_surface = 0;
 
 // DrawPixel function is used by Line and Conic functions to set the
 // pixel at drawing coordinates (x,y) to the currently selected color
 //
 void DrawPixel(int x, int y)
 {
-    SDL_RenderDrawPoint(g_renderer, x, y);
+    g_surface->Plot(x, y);
 }
 
-// SetColor function is used by the functions in this module to
-// specify the color to use for subsequent drawing operations
+// Returns the time from a monotonic, high-resolution timer, in
+// milliseconds
 //
-inline void SetColor(COLOR rgb)
+double NowMs()
 {
-    Uint8 r = rgb & 255;
-    Uint8 g = (rgb >> 8) & 255;
-    Uint8 b = (rgb >> 16) & 255;
+    return 1000.0*SDL_GetPerformanceCounter()/SDL_GetPerformanceFrequency();
+}
+
+// Copies the tiles of the framebuffer that have changed since the
+// previous call to texture, rather than the whole framebuffer
+//
+void UpdateDirtyTiles(SDL_Texture *texture)
+{
+    static std::vector<int> rects;
+    int count = g_surface->GetDirtyRects(rects);
 
-    SDL_SetRenderDrawColor(g_renderer, r, g, b, SDL_ALPHA_OPAQUE);
+    for (int i = 0; i < count; i++)
+    {
+        const int *r = &rects[4*i];
+        SDL_Rect rect = { r[0], r[1], r[2] - r[0] + 1, r[3] - r[1] + 1 };
+
+        SDL_UpdateTexture(texture, &rect,
+                          &g_surface->pixels[r[1]*g_surface->width + r[0]],
+                          g_surface->width*sizeof(COLOR));
+    }
 }
 
 // Barycentric coordinates
@@ -63,11 +84,25 @@ void xyToBary(float xin, float yin, BARYCENT *uvwout,
 
 // Converts barycentric coordinates uvwIn = (u,v,w) to x-y coordinates
 // xyOut given the three vertexes -- xy[0], xy[1], and xy[2] -- of the
-// reference triangle.
-void baryToXy(SDL_Point *xyOut, const BARYCENT *uvwIn, SDL_Point xy[])
+// reference triangle. Like baryToFix, this function rounds to nearest,
+// so that a knot drawn at xyOut lies on the spline through the knot.
+void baryToXy(XYVAL *xyOut, const BARYCENT *uvwIn, XYVAL xy[])
 {
-    xyOut->x = uvwIn->u*xy[0].x + uvwIn->v*xy[1].x + uvwIn->w*xy[2].x;
-    xyOut->y = uvwIn->u*xy[0].y + uvwIn->v*xy[1].y + uvwIn->w*xy[2].y;
+    xyOut->x = floor(uvwIn->u*xy[0].x + uvwIn->v*xy[1].x
+                     + uvwIn->w*xy[2].x + 0.5);
+    xyOut->y = floor(uvwIn->u*xy[0].y + uvwIn->v*xy[1].y
+                     + uvwIn->w*xy[2].y + 0.5);
+}
+
+// Converts barycentric coordinates uvwIn = (u,v,w) to fixed-point x-y
+// coordinates fxyOut, with FIX_SHIFT bits of fraction, given the three
+// vertexes -- xy[0], xy[1], and xy[2] -- of the reference triangle.
+void baryToFix(XYVAL *fxyOut, const BARYCENT *uvwIn, XYVAL xy[])
+{
+    fxyOut->x = floor(FIX_ONE*(uvwIn->u*xy[0].x + uvwIn->v*xy[1].x
+                               + uvwIn->w*xy[2].x) + 0.5);
+    fxyOut->y = floor(FIX_ONE*(uvwIn->u*xy[0].y + uvwIn->v*xy[1].y
+                               + uvwIn->w*xy[2].y) + 0.5);
 }
 
 // Contains conic spline control points for a "splat" glyph (an
@@ -85,7 +120,7 @@ public:
     ~Splat()
     {
     }
-    void Update(Bounce *bounce);
+    void Update(Bounce *bounce, int alpha, DisplayList *dl);
 };
 
 // Initializes conic spline control points, and stores these
@@ -151,53 +186,61 @@ Splat::Splat()
     }
 }
 
-// Update drawing of "splat" glyph on screen based on current
-// position of parallelogram vertexes
-void Splat::Update(Bounce *bounce)
+// Adds the "splat" glyph to display list dl based on current
+// position of parallelogram vertexes, which are interpolated between
+// their last two positions by fixed-point fraction alpha
+void Splat::Update(Bounce *bounce, int alpha, DisplayList *dl)
 {
-    SDL_Rect rect;
-    SDL_Point xy[49], xyPgram[5];
+    XYVAL xy[49], xyPgram[5];
+    XYVAL fxy[49];
     int i;
 
     // Get vertex coordinates for current parallelogram
-    bounce->Update((XYVAL*)xyPgram);
+    bounce->Interpolate(alpha, xyPgram);
     xyPgram[4] = xyPgram[0];  // close polyline
 
     // Draw four sides of parallelogram
-    SetColor(DARKGREEN);
-    SDL_RenderDrawLines(g_renderer, xyPgram, 5);
+    dl->AddPolyline(DARKGREEN, xyPgram, 5);
 
     // Highlight spline knots and control points for splat glyph
-    SetColor(BLUE);
     for (i = 0; i < 49; i++)
     {
         baryToXy(&xy[i], &uvwSplat[i], xyPgram);
-        rect.x = xy[i].x-2;
-        rect.y = xy[i].y-2;
-        rect.w = rect.h = 5;
-        SDL_RenderFillRect(g_renderer, &rect);
+        baryToFix(&fxy[i], &uvwSplat[i], xyPgram);
+        dl->Add(PRIM_RECT, BLUE, xy[i].x-2, xy[i].y-2, xy[i].x+2, xy[i].y+2);
     }
 
     // Draw spline skeleton for splat glyph
-    SetColor(DARKBLUE);
-    SDL_RenderDrawLines(g_renderer, xy, 49);
+    dl->AddPolyline(DARKBLUE, xy, 49);
 
-    // Draw conic splines consisting of PI/2-radian elliptical arcs
-    SetColor(WHITE);
-    for (int i = 2; i < 49; i += 2)
-    {
-        ParabolicSpline(xy[i-2].x, xy[i-2].y, xy[i-1].x, xy[i-1].y, xy[i].x, xy[i].y); 
-    }
+    // Draw conic splines consisting of PI/2-radian elliptical arcs.
+    // The spline knots and control points are specified with subpixel
+    // precision so that the splines move smoothly with the animation.
+    // PolySpline draws each knot shared by two splines only once.
+    dl->AddPolySpline(PRIM_PARABOLIC_SPLINE_FX, WHITE, fxy, 49);
 }
 
 //---------------------------------------------------------------------
 //
-// Main program
+// Main program. The -record option saves the display list of each
+// frame to a file, which the bench program can replay.
 //
 //---------------------------------------------------------------------
 int main(int argc, char* argv[])
 {
     int retval = 0;
+    const char *recordPath = 0;
+
+    for (int i = 1; i < argc; i++)
+    {
+        if (strcmp(argv[i], "-record") == 0 && i + 1 < argc)
+            recordPath = argv[++i];
+        else
+        {
+            printf("Usage: demo2 [-record file]\n");
+            return 1;
+        }
+    }
 
     printf("Starting SDL2 app...\n");
     if (SDL_Init(SDL_INIT_VIDEO) == 0)
@@ -209,31 +252,75 @@ int main(int argc, char* argv[])
             bool quit = false;
             int redraw = -1;
             int width, height;
-            SDL_Rect frame;
+            XYVAL frame[5];
             Bounce *bounce = 0;
+            SimClock clock(STEP_MS);
+            FrameStats stats(STEP_MS);
+            SDL_Texture *texture = 0;
+            Scheduler *sched = 0;
+            Recorder recorder;
+            DisplayList dl;
             Splat splat;
 
             SDL_GetWindowSize(window, &width, &height);
             bounce = new Bounce(width, height);
-            frame.x = 2;
-            frame.y = 2;
-            frame.w = width - 4;
-            frame.h = height - 4;
+            g_surface = new Surface(width, height);
+            sched = new Scheduler(g_surface, BLACK);
+            texture = SDL_CreateTexture(g_renderer, SDL_PIXELFORMAT_BGR888,
+                                        SDL_TEXTUREACCESS_STREAMING,
+                                        width, height);
+            frame[0].x = frame[3].x = frame[4].x = 2;
+            frame[0].y = frame[1].y = frame[4].y = 2;
+            frame[1].x = frame[2].x = width - 3;
+            frame[2].y = frame[3].y = height - 3;
+            if (recordPath && !recorder.Open(recordPath, width, height))
+                printf("--ERROR-- Cannot create %s\n", recordPath);
             while (!quit)
             {
                 SDL_Event evt;
+                double frameStart = NowMs();
+                int wait;
 
                 if (redraw)
                 {
-                    --redraw;
-                    SetColor(BLACK);
-                    SDL_RenderClear(g_renderer);
-                    SetColor(GRAY);
-                    SDL_RenderDrawRect(g_renderer, &frame);
-                    splat.Update(bounce);
+                    int alpha = FIX_ONE;
+
+                    if (redraw < 0)
+                    {
+                        // Free-running animation: run the simulation
+                        // steps that are due, and draw a position in
+                        // between the last two
+                        for (int n = clock.Tick(frameStart); n > 0; n--)
+                            bounce->Step();
+                        alpha = clock.Alpha();
+                        stats.Add(frameStart);
+                    }
+                    else
+                    {
+                        --redraw;
+                        bounce->Step();
+                    }
+                    dl.Clear();
+                    dl.AddPolyline(GRAY, frame, 5);
+                    splat.Update(bounce, alpha, &dl);
+                    sched->Submit(dl);
+                    recorder.Write(dl);
+                }
+                if (!sched->Done())
+                {
+                    // Draw as much of the frame as fits in RENDER_MS,
+                    // and show it even if it is not yet complete
+                    double t = NowMs();
+                    int pixels = sched->Render();
+                    double ms = NowMs() - t;
+
+                    sched->AdjustBudget(pixels, ms);
+                    UpdateDirtyTiles(texture);
+                    SDL_RenderCopy(g_renderer, texture, 0, 0);
                     SDL_RenderPresent(g_renderer);
                 }
-                SDL_WaitEventTimeout(0, 17);
+                wait = (int)(frameStart + STEP_MS - NowMs());
+                SDL_WaitEventTimeout(0, (wait > 1) ? wait : 1);
                 while (SDL_PollEvent(&evt))
                 {
                     if (evt.type == SDL_QUIT)
@@ -254,6 +341,21 @@ int main(int argc, char* argv[])
                     }
                 }
             }
+            stats.Report(stdout, clock.Skipped());
+            if (recordPath)
+            {
+                if (recorder.Close())
+                    printf("Recorded %d frames to %s\n", recorder.Frames(),
+                           recordPath);
+                else
+                    printf("--ERROR-- Cannot write %s\n", recordPath);
+            }
+            if (texture)
+            {
+                SDL_DestroyTexture(texture);
+            }
+            delete sched;
+            delete g_surface;
         }
         else
         {